@@ -185,6 +185,10 @@ ARTM_API = [
         'ArtmSaveBatch',
         [('filename', str), ('batch', messages.Batch)],
     ),
+    CallSpec(
+        'ArtmSaveFlatBatch',
+        [('filename', str), ('batch', messages.Batch)],
+    ),
     CallSpec(
         'ArtmCopyRequestedObject',
         [('array', numpy.ndarray)],
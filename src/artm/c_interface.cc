@@ -17,6 +17,7 @@
 #include "artm/core/common.h"
 #include "artm/core/check_messages.h"
 #include "artm/core/exceptions.h"
+#include "artm/core/flat_batch.h"
 #include "artm/core/helpers.h"
 #include "artm/core/master_component.h"
 #include "artm/core/template_manager.h"
@@ -222,6 +223,17 @@ int64_t ArtmSaveBatch(const char* disk_path, int64_t length, const char* batch)
   } CATCH_EXCEPTIONS;
 }
 
+int64_t ArtmSaveFlatBatch(const char* filename, int64_t length, const char* batch) {
+  try {
+    EnableLogging();
+    artm::Batch batch_object;
+    ParseFromArray(batch, length, &batch_object);
+    artm::core::FixAndValidateMessage(&batch_object);
+    artm::core::FlatBatch::Save(batch_object, std::string(filename));
+    return ARTM_SUCCESS;
+  } CATCH_EXCEPTIONS;
+}
+
 int64_t ArtmDuplicateMasterComponent(int master_id, int64_t length, const char* duplicate_master_args) {
   try {
     EnableLogging();
@@ -274,19 +286,8 @@ int64_t ArtmAwaitOperation(int operation_id, int64_t length, const char* await_o
     AsyncProcessBatchesManager& manager = AsyncProcessBatchesManager::singleton();
     std::shared_ptr<artm::core::BatchManager> batch_manager = manager.Get(operation_id);
 
-    const int timeout = args.timeout_milliseconds();
-    auto time_start = boost::posix_time::microsec_clock::local_time();
-    for (;;) {
-      if (batch_manager->IsEverythingProcessed())
-        return ARTM_SUCCESS;
-
-      boost::this_thread::sleep(boost::posix_time::milliseconds(::artm::core::kIdleLoopFrequency));
-      auto time_end = boost::posix_time::microsec_clock::local_time();
-      if (timeout >= 0) {
-        if ((time_end - time_start).total_milliseconds() >= timeout)
-          break;
-      }
-    }
+    if (batch_manager->WaitUntilEverythingProcessed(args.timeout_milliseconds()))
+      return ARTM_SUCCESS;
 
     set_last_error("The operation is still in progress. Call ArtmAwaitOperation() later.");
     return ARTM_STILL_WORKING;
@@ -328,7 +329,7 @@ int64_t ArtmRequestLoadBatch(const char* filename) {
   try {
     EnableLogging();
     auto batch = std::make_shared< ::artm::Batch>();
-    ::artm::core::Helpers::LoadMessage(filename, batch.get());
+    ::artm::core::Helpers::LoadBatch(filename, batch.get());
     SerializeToString(*batch, last_message());
     return static_cast<int64_t>(last_message()->size());
   } CATCH_EXCEPTIONS;
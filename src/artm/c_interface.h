@@ -90,6 +90,7 @@ extern "C" {
   DLL_PUBLIC int64_t ArtmAwaitOperation(int operation_id, int64_t length, const char* await_operation_args);
 
   DLL_PUBLIC int64_t ArtmSaveBatch(const char* disk_path, int64_t length, const char* batch);
+  DLL_PUBLIC int64_t ArtmSaveFlatBatch(const char* filename, int64_t length, const char* batch);
   DLL_PUBLIC const char* ArtmGetLastErrorMessage();
   DLL_PUBLIC const char* ArtmGetVersion();
   DLL_PUBLIC int64_t ArtmConfigureLogging(int64_t length, const char* configure_logging_args);
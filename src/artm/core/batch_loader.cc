@@ -0,0 +1,417 @@
+// Copyright 2016, Additive Regularization of Topic Models.
+
+#include "artm/core/batch_loader.h"
+
+#include <map>
+#include <string>
+
+#include "boost/exception/diagnostic_information.hpp"
+#include "boost/filesystem.hpp"
+
+#include "glog/logging.h"
+
+#include "artm/core/flat_batch.h"
+#include "artm/core/helpers.h"
+#include "artm/core/instance.h"
+
+namespace artm {
+namespace core {
+
+static bool FillTokensInBatch(const PhiMatrix& phi_matrix, Batch* batch) {
+  if (batch->token_size() > 0)
+    return true;
+
+  // Verify that max token_id is compatible with topic model.
+  const int token_size = phi_matrix.token_size();
+  for (auto& item : batch->item()) {
+    for (int token_id : item.token_id()) {
+      if (token_id < 0 || token_id >= token_size) {
+        LOG(ERROR) << "Batch " << batch->id() << " is incompatible with model " << phi_matrix.model_name()
+                    << " (batch.token_size() = 0 && item.token_id >= phi_matrix.token_size())";
+        return false;
+      }
+    }
+  }
+
+  batch->mutable_token()->Reserve(token_size);
+  batch->mutable_class_id()->Reserve(token_size);
+  for (int token_index = 0; token_index < token_size; ++token_index) {
+    const Token& token = phi_matrix.token(token_index);
+    batch->add_token(token.keyword);
+    batch->add_class_id(token.class_id);
+  }
+
+  return true;
+}
+
+static std::shared_ptr< ::artm::utility::CsrMatrix<float>> InitializeNdw(const Batch& batch) {
+  std::vector<float> n_dw_val;
+  std::vector<int> n_dw_row_ptr;
+  std::vector<int> n_dw_col_ind;
+
+  for (int item_index = 0; item_index < batch.item_size(); ++item_index) {
+    n_dw_row_ptr.push_back(static_cast<int>(n_dw_val.size()));
+    const Item& item = batch.item(item_index);
+    n_dw_val.insert(n_dw_val.end(), item.token_weight().begin(), item.token_weight().end());
+    n_dw_col_ind.insert(n_dw_col_ind.end(), item.token_id().begin(), item.token_id().end());
+  }
+
+  n_dw_row_ptr.push_back(static_cast<int>(n_dw_val.size()));
+  return std::make_shared< ::artm::utility::CsrMatrix<float>>(
+    batch.token_size(), &n_dw_val, &n_dw_row_ptr, &n_dw_col_ind);
+}
+
+// Copies n_dw and multiplies token weights by class weights of args
+static std::shared_ptr< ::artm::utility::CsrMatrix<float>>
+ApplyClassWeights(const PreparedBatch& prepared, const ProcessBatchesArgs& args) {
+  std::map<ClassId, float> class_id_to_weight;
+  for (int i = 0; i < args.class_id_size(); ++i)
+    class_id_to_weight.insert(std::make_pair(args.class_id(i), args.class_weight(i)));
+
+  std::vector<float> token_class_weight(prepared.token_size(), 0.0f);
+  for (int token_index = 0; token_index < prepared.token_size(); ++token_index) {
+    auto iter = class_id_to_weight.find(prepared.token(token_index).class_id);
+    if (iter != class_id_to_weight.end())
+      token_class_weight[token_index] = iter->second;
+  }
+
+  auto sparse_ndw = std::make_shared< ::artm::utility::CsrMatrix<float>>(prepared.n_dw());
+  for (int i = 0; i < sparse_ndw->nnz(); ++i)
+    sparse_ndw->val()[i] *= token_class_weight[sparse_ndw->col_ind()[i]];
+  return sparse_ndw;
+}
+
+std::shared_ptr<PreparedBatch> PreparedBatch::Prepare(const ProcessorInput& part,
+                                                      std::shared_ptr<const PhiMatrix> p_wt,
+                                                      Instance* instance) {
+  if (p_wt == nullptr || part.args().class_id_size() != part.args().class_weight_size())
+    return nullptr;
+
+  std::shared_ptr<PreparedBatch> prepared(new PreparedBatch());
+  prepared->p_wt_ = p_wt;
+  TokenIndexCache::BatchStamp stamp;
+  if (part.has_batch_filename()) {
+    // Batches stored in the instance are read-only, so they are shared instead of being copied
+    std::shared_ptr<const Batch> batch = instance->batches()->get(part.batch_filename());
+    if (batch == nullptr) {
+      stamp = TokenIndexCache::GetBatchStamp(part.batch_filename());
+      try {
+        if (FlatBatch::IsFlatBatch(part.batch_filename())) {
+          // n_dw refers to the memory-mapped CSR arrays, and tokens are looked up directly in the string table
+          prepared->flat_batch_ = std::make_shared<FlatBatch>(part.batch_filename());
+        } else {
+          auto loaded_batch = std::make_shared<Batch>();
+          ::artm::core::Helpers::LoadMessage(part.batch_filename(), loaded_batch.get());
+          batch = loaded_batch;
+        }
+      } catch (std::exception& ex) {
+        LOG(ERROR) << ex.what() << ", the batch will be skipped.";
+        return nullptr;
+      }
+    }
+
+    prepared->batch_holder_ = batch;
+    prepared->batch_ = batch.get();
+  } else {  // part.has_batch_filename()
+    prepared->batch_ = &part.batch();
+  }
+
+  if (prepared->flat_batch_ != nullptr) {
+    const FlatBatch& flat_batch = *prepared->flat_batch_;
+    prepared->batch_id_ = flat_batch.id();
+    prepared->n_dw_ = std::make_shared< ::artm::utility::CsrMatrix<float>>(
+      flat_batch.num_items(), flat_batch.num_tokens(), flat_batch.nnz(),
+      flat_batch.token_weight(), flat_batch.row_ptr(), flat_batch.token_id(), prepared->flat_batch_);
+  } else {
+    if (prepared->batch_->token_size() == 0) {
+      auto batch = std::make_shared<Batch>(*prepared->batch_);
+      if (!FillTokensInBatch(*p_wt, batch.get()))
+        return nullptr;
+
+      prepared->batch_holder_ = batch;
+      prepared->batch_ = batch.get();
+    }
+
+    prepared->batch_id_ = prepared->batch_->id();
+    prepared->n_dw_ = InitializeNdw(*prepared->batch_);
+  }
+
+  // Arrays of a flat batch stay in the mapped file, unless they have to be multiplied by class weights
+  if (part.args().class_id_size() != 0)
+    prepared->sparse_ndw_ = ApplyClassWeights(*prepared, part.args());
+  else
+    prepared->sparse_ndw_ = prepared->n_dw_;
+
+  // Batches passed in memory with processor input are typically used only once, so they are not cached
+  const int64_t token_set_version = p_wt->token_set_version();
+  const bool use_cache = (token_set_version != 0) && part.has_batch_filename();
+  if (use_cache)
+    prepared->token_id_ = instance->token_index_cache()->get(part.batch_filename(), token_set_version, stamp);
+
+  if (prepared->token_id_ == nullptr) {
+    auto token_id = std::make_shared<std::vector<int>>(prepared->token_size(), -1);
+    for (int token_index = 0; token_index < prepared->token_size(); ++token_index)
+      (*token_id)[token_index] = p_wt->token_index(prepared->token(token_index));
+
+    prepared->token_id_ = token_id;
+    if (use_cache)
+      instance->token_index_cache()->set(part.batch_filename(), token_set_version, stamp, token_id);
+  }
+
+  return prepared;
+}
+
+int PreparedBatch::item_id(int item_index) const {
+  if (flat_batch_ != nullptr)
+    return flat_batch_->item_id()[item_index];
+  return batch_->item(item_index).id();
+}
+
+std::string PreparedBatch::item_title(int item_index) const {
+  if (flat_batch_ != nullptr)
+    return flat_batch_->item_title(item_index);
+  return batch_->item(item_index).title();
+}
+
+Token PreparedBatch::token(int token_index) const {
+  if (flat_batch_ != nullptr)
+    return flat_batch_->token(token_index);
+  return Token(batch_->class_id(token_index), batch_->token(token_index));
+}
+
+const Batch& PreparedBatch::batch() const {
+  if (batch_ == nullptr) {
+    auto batch = std::make_shared<Batch>();
+    flat_batch_->ToBatch(batch.get());
+    batch_holder_ = batch;
+    batch_ = batch.get();
+  }
+
+  return *batch_;
+}
+
+TokenIndexCache::BatchStamp TokenIndexCache::GetBatchStamp(const std::string& filename) {
+  BatchStamp stamp;
+  boost::system::error_code error;
+  const boost::uintmax_t file_size = boost::filesystem::file_size(filename, error);
+  if (error)
+    return BatchStamp();
+  const std::time_t last_write_time = boost::filesystem::last_write_time(filename, error);
+  if (error)
+    return BatchStamp();
+
+  stamp.file_size = static_cast<int64_t>(file_size);
+  stamp.last_write_time = static_cast<int64_t>(last_write_time);
+  return stamp;
+}
+
+TokenIndexCache::TokenIndexCache(int64_t max_byte_size)
+    : lock_(), max_byte_size_(max_byte_size), byte_size_(0), entries_(), lru_() {}
+
+std::shared_ptr<const std::vector<int>> TokenIndexCache::get(const std::string& batch_name,
+                                                             int64_t token_set_version,
+                                                             const BatchStamp& stamp) {
+  boost::lock_guard<boost::mutex> guard(lock_);
+  auto iter = entries_.find(batch_name);
+  if (iter == entries_.end())
+    return nullptr;
+
+  // The token set of p_wt has changed, or a different batch was saved under the same name
+  if (iter->second.token_set_version != token_set_version || !(iter->second.stamp == stamp)) {
+    EraseLocked(iter);
+    return nullptr;
+  }
+
+  lru_.splice(lru_.begin(), lru_, iter->second.lru_position);
+  return iter->second.token_id;
+}
+
+void TokenIndexCache::set(const std::string& batch_name, int64_t token_set_version, const BatchStamp& stamp,
+                          std::shared_ptr<const std::vector<int>> token_id) {
+  const int64_t byte_size = sizeof(int) * static_cast<int64_t>(token_id->size()) + batch_name.size();
+
+  boost::lock_guard<boost::mutex> guard(lock_);
+  auto iter = entries_.find(batch_name);
+  if (iter != entries_.end())
+    EraseLocked(iter);
+  if (byte_size > max_byte_size_)
+    return;
+
+  lru_.push_front(batch_name);
+  Entry entry = { token_set_version, stamp, token_id, byte_size, lru_.begin() };
+  entries_.insert(std::make_pair(batch_name, entry));
+  byte_size_ += byte_size;
+  EvictLocked();
+}
+
+void TokenIndexCache::erase(const std::string& batch_name) {
+  boost::lock_guard<boost::mutex> guard(lock_);
+  auto iter = entries_.find(batch_name);
+  if (iter != entries_.end())
+    EraseLocked(iter);
+}
+
+void TokenIndexCache::set_max_byte_size(int64_t max_byte_size) {
+  boost::lock_guard<boost::mutex> guard(lock_);
+  max_byte_size_ = max_byte_size;
+  EvictLocked();
+}
+
+int64_t TokenIndexCache::ByteSize() const {
+  boost::lock_guard<boost::mutex> guard(lock_);
+  return byte_size_;
+}
+
+int TokenIndexCache::size() const {
+  boost::lock_guard<boost::mutex> guard(lock_);
+  return static_cast<int>(entries_.size());
+}
+
+void TokenIndexCache::EraseLocked(std::unordered_map<std::string, Entry>::iterator iter) {
+  byte_size_ -= iter->second.byte_size;
+  lru_.erase(iter->second.lru_position);
+  entries_.erase(iter);
+}
+
+void TokenIndexCache::EvictLocked() {
+  while (!lru_.empty() && byte_size_ > max_byte_size_)
+    EraseLocked(entries_.find(lru_.back()));
+}
+
+bool PreparedBatchSlot::BeginLoad(BatchLoader* loader) {
+  boost::lock_guard<boost::mutex> guard(lock_);
+  if (state_ != Pending)
+    return false;
+
+  state_ = Loading;
+  loader_ = loader;
+  return true;
+}
+
+void PreparedBatchSlot::SetReady(std::shared_ptr<PreparedBatch> result) {
+  {
+    boost::lock_guard<boost::mutex> guard(lock_);
+    result_ = result;
+    state_ = Ready;
+  }
+  ready_.notify_all();
+}
+
+std::shared_ptr<PreparedBatch> PreparedBatchSlot::Take() {
+  std::shared_ptr<PreparedBatch> result;
+  BatchLoader* loader = nullptr;
+  {
+    boost::unique_lock<boost::mutex> lock(lock_);
+    while (state_ == Loading)
+      ready_.wait(lock);
+
+    if (state_ == Ready) {
+      result.swap(result_);
+      loader = loader_;
+    }
+
+    state_ = Taken;
+  }
+
+  // Release outside of the slot lock, because the loader acquires locks in the opposite order.
+  if (loader != nullptr)
+    loader->Release();
+  return result;
+}
+
+BatchLoader::BatchLoader(Instance* instance)
+    : instance_(instance),
+      queue_(),
+      lock_(),
+      has_room_(),
+      max_prefetched_(0),
+      num_prefetched_(0),
+      is_stopping(false),
+      thread_() {
+  // Keep this at the last action in constructor.
+  // http://stackoverflow.com/questions/15751618/initialize-boost-thread-in-object-constructor
+  boost::thread t(&BatchLoader::ThreadFunction, this);
+  thread_.swap(t);
+}
+
+BatchLoader::~BatchLoader() {
+  is_stopping = true;
+  queue_.notify_all();
+  { boost::lock_guard<boost::mutex> guard(lock_); }
+  has_room_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void BatchLoader::set_max_prefetched(int max_prefetched) {
+  {
+    boost::lock_guard<boost::mutex> guard(lock_);
+    max_prefetched_ = max_prefetched;
+  }
+  has_room_.notify_all();
+}
+
+void BatchLoader::Schedule(std::shared_ptr<ProcessorInput> part) {
+  {
+    boost::lock_guard<boost::mutex> guard(lock_);
+    if (max_prefetched_ <= 0)
+      return;
+  }
+
+  part->set_prepared_batch_slot(std::make_shared<PreparedBatchSlot>());
+  queue_.push(part);
+}
+
+void BatchLoader::Release() {
+  {
+    boost::lock_guard<boost::mutex> guard(lock_);
+    num_prefetched_--;
+  }
+  has_room_.notify_one();
+}
+
+void BatchLoader::ThreadFunction() {
+  try {
+    Helpers::SetThreadName(-1, "BatchLoader thread");
+    LOG(INFO) << "BatchLoader thread started";
+
+    for (;;) {
+      if (is_stopping) {
+        LOG(INFO) << "BatchLoader thread stopped";
+        break;
+      }
+
+      std::shared_ptr<ProcessorInput> part;
+      if (!queue_.wait_and_pop(&part, &is_stopping))
+        continue;
+
+      {
+        // Do not run too far ahead of processors
+        boost::unique_lock<boost::mutex> lock(lock_);
+        while (max_prefetched_ > 0 && num_prefetched_ >= max_prefetched_ && !is_stopping)
+          has_room_.wait(lock);
+
+        if (is_stopping || max_prefetched_ <= 0)
+          continue;  // the processor will prepare this batch by itself
+
+        num_prefetched_++;
+      }
+
+      PreparedBatchSlot* slot = part->prepared_batch_slot().get();
+      if (!slot->BeginLoad(this)) {
+        // The processor has already started this batch
+        Release();
+        continue;
+      }
+
+      slot->SetReady(PreparedBatch::Prepare(*part, instance_->GetPhiMatrix(part->model_name()), instance_));
+    }
+  }
+  catch (...) {
+    LOG(FATAL) << boost::current_exception_diagnostic_information();
+  }
+}
+
+}  // namespace core
+}  // namespace artm
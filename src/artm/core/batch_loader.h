@@ -0,0 +1,195 @@
+// Copyright 2016, Additive Regularization of Topic Models.
+
+#ifndef SRC_ARTM_CORE_BATCH_LOADER_H_
+#define SRC_ARTM_CORE_BATCH_LOADER_H_
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "boost/thread.hpp"
+#include "boost/thread/condition_variable.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/utility.hpp"
+
+#include "artm/core/common.h"
+#include "artm/core/phi_matrix.h"
+#include "artm/core/processor_input.h"
+#include "artm/core/thread_safe_holder.h"
+#include "artm/core/token.h"
+#include "artm/utility/blas.h"
+
+namespace artm {
+namespace core {
+
+class Instance;
+class BatchLoader;
+class FlatBatch;
+
+// TokenIndexCache keeps token_id vectors (see PreparedBatch::token_id()) across collection passes,
+// so that tokens of a batch are not looked up in p_wt again until the token set of p_wt changes.
+// Entries are keyed by batch name (the file name, or the id of a batch imported into the instance).
+// An entry is only returned for p_wt with the same PhiMatrix::token_set_version(), and for the same BatchStamp,
+// which is read once per load from the file system; so a batch file rewritten under the same name is detected,
+// and a cache hit does no string work. Imported batches have an empty stamp; the owner must call erase()
+// when such batch is replaced (e.g. on ImportBatches).
+// Entries with an outdated token set version are dropped on lookup, and least recently used entries are evicted
+// once the total size of token_id vectors exceeds max_byte_size (zero disables the cache).
+class TokenIndexCache : boost::noncopyable {
+ public:
+  // Identifies the content of a batch file by its size and last write time
+  struct BatchStamp {
+    BatchStamp() : file_size(0), last_write_time(0) {}
+    bool operator==(const BatchStamp& rhs) const {
+      return file_size == rhs.file_size && last_write_time == rhs.last_write_time;
+    }
+
+    int64_t file_size;
+    int64_t last_write_time;
+  };
+
+  // Returns the stamp of the file, or an empty stamp if the file can not be accessed
+  static BatchStamp GetBatchStamp(const std::string& filename);
+
+  explicit TokenIndexCache(int64_t max_byte_size);
+
+  std::shared_ptr<const std::vector<int>> get(const std::string& batch_name, int64_t token_set_version,
+                                              const BatchStamp& stamp);
+  void set(const std::string& batch_name, int64_t token_set_version, const BatchStamp& stamp,
+           std::shared_ptr<const std::vector<int>> token_id);
+  void erase(const std::string& batch_name);
+
+  void set_max_byte_size(int64_t max_byte_size);
+  int64_t ByteSize() const;
+  int size() const;
+
+ private:
+  struct Entry {
+    int64_t token_set_version;
+    BatchStamp stamp;
+    std::shared_ptr<const std::vector<int>> token_id;
+    int64_t byte_size;
+    std::list<std::string>::iterator lru_position;
+  };
+
+  // Must be called under lock_
+  void EraseLocked(std::unordered_map<std::string, Entry>::iterator iter);
+  void EvictLocked();
+
+  mutable boost::mutex lock_;
+  int64_t max_byte_size_;
+  int64_t byte_size_;
+  std::unordered_map<std::string, Entry> entries_;
+  std::list<std::string> lru_;  // batch names, most recently used first
+};
+
+// PreparedBatch contains everything the processor needs to start the E-step:
+// the batch itself, its sparse n_dw matrix, and the mapping from batch tokens into rows of p_wt.
+// The data is only valid for the p_wt snapshot it was prepared against (see p_wt()).
+// Flat batches (see FlatBatch) are not decoded: ids, items and tokens are read straight from the mapped file,
+// and the protobuf batch is only decoded on the first call to batch() (e.g. by regularizers or non-fused scores).
+// PreparedBatch is not thread-safe; it is used by one processor at a time.
+class PreparedBatch : boost::noncopyable {
+ public:
+  // Loads the batch described by processor input (from instance->batches(), from disk or from part.batch()).
+  // Returns nullptr (and logs an error) if the batch can not be loaded or is incompatible with p_wt.
+  // The result may refer to part.batch(), so part must outlive the result.
+  static std::shared_ptr<PreparedBatch> Prepare(const ProcessorInput& part,
+                                                std::shared_ptr<const PhiMatrix> p_wt,
+                                                Instance* instance);
+
+  const std::string& batch_id() const { return batch_id_; }
+  int item_size() const { return n_dw_->m(); }
+  int item_id(int item_index) const;
+  std::string item_title(int item_index) const;
+  int token_size() const { return n_dw_->n(); }
+  Token token(int token_index) const;
+
+  const Batch& batch() const;
+  const std::shared_ptr<const PhiMatrix>& p_wt() const { return p_wt_; }
+
+  // n_dw holds token weights of items as they are stored in the batch,
+  // and sparse_ndw holds the same weights multiplied by class weights of ProcessBatchesArgs.
+  const ::artm::utility::CsrMatrix<float>& n_dw() const { return *n_dw_; }
+  const ::artm::utility::CsrMatrix<float>& sparse_ndw() const { return *sparse_ndw_; }
+  const std::vector<int>& token_id() const { return *token_id_; }
+
+ private:
+  PreparedBatch() : batch_(nullptr), batch_holder_(), flat_batch_(), batch_id_(), p_wt_(),
+                    n_dw_(), sparse_ndw_(), token_id_() {}
+
+  mutable const Batch* batch_;
+  mutable std::shared_ptr<const Batch> batch_holder_;
+  std::shared_ptr<const FlatBatch> flat_batch_;
+  std::string batch_id_;
+  std::shared_ptr<const PhiMatrix> p_wt_;
+  std::shared_ptr< ::artm::utility::CsrMatrix<float>> n_dw_;
+  std::shared_ptr< ::artm::utility::CsrMatrix<float>> sparse_ndw_;
+  std::shared_ptr<const std::vector<int>> token_id_;
+};
+
+// PreparedBatchSlot is the rendezvous point between the batch loader and the processor for one ProcessorInput.
+// Whoever comes first decides: if the processor takes the slot before the loader has started,
+// the loader skips it and the processor prepares the batch itself.
+class PreparedBatchSlot : boost::noncopyable {
+ public:
+  PreparedBatchSlot() : lock_(), ready_(), state_(Pending), loader_(nullptr), result_() {}
+
+  // Called by the loader; returns false if the processor has already taken this slot.
+  bool BeginLoad(BatchLoader* loader);
+  void SetReady(std::shared_ptr<PreparedBatch> result);
+
+  // Called by the processor. Waits if the batch is being loaded right now;
+  // returns nullptr if the loader has not reached this slot (or failed to prepare the batch).
+  std::shared_ptr<PreparedBatch> Take();
+
+ private:
+  enum State { Pending, Loading, Ready, Taken };
+
+  boost::mutex lock_;
+  boost::condition_variable ready_;
+  State state_;
+  BatchLoader* loader_;
+  std::shared_ptr<PreparedBatch> result_;
+};
+
+// BatchLoader runs a dedicated thread that loads and decodes batches ahead of processors.
+// Tasks are scheduled in the same order as they are pushed into processor queue,
+// and at most max_prefetched batches are kept prepared but not yet taken by a processor.
+class BatchLoader : boost::noncopyable {
+ public:
+  explicit BatchLoader(Instance* instance);
+  ~BatchLoader();
+
+  // Non-positive value disables the prefetch.
+  void set_max_prefetched(int max_prefetched);
+
+  // Must be called before part is pushed into processor queue.
+  void Schedule(std::shared_ptr<ProcessorInput> part);
+
+  // Called by PreparedBatchSlot when the processor takes a batch prepared by this loader.
+  void Release();
+
+ private:
+  Instance* instance_;
+  ThreadSafeQueue<std::shared_ptr<ProcessorInput>> queue_;
+
+  boost::mutex lock_;
+  boost::condition_variable has_room_;
+  int max_prefetched_;
+  int num_prefetched_;
+
+  mutable std::atomic<bool> is_stopping;
+  boost::thread thread_;
+
+  void ThreadFunction();
+};
+
+}  // namespace core
+}  // namespace artm
+
+#endif  // SRC_ARTM_CORE_BATCH_LOADER_H_
@@ -7,7 +7,7 @@
 namespace artm {
 namespace core {
 
-BatchManager::BatchManager() : lock_(), in_progress_() {}
+BatchManager::BatchManager() : lock_(), everything_processed_(), in_progress_() {}
 
 void BatchManager::Add(const boost::uuids::uuid& task_id) {
   boost::lock_guard<boost::mutex> guard(lock_);
@@ -19,9 +19,28 @@ bool BatchManager::IsEverythingProcessed() const {
   return in_progress_.empty();
 }
 
+bool BatchManager::WaitUntilEverythingProcessed(int timeout_milliseconds) const {
+  boost::unique_lock<boost::mutex> lock(lock_);
+  if (timeout_milliseconds < 0) {
+    while (!in_progress_.empty())
+      everything_processed_.wait(lock);
+    return true;
+  }
+
+  auto deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeout_milliseconds);
+  while (!in_progress_.empty()) {
+    if (!everything_processed_.timed_wait(lock, deadline))
+      break;
+  }
+
+  return in_progress_.empty();
+}
+
 void BatchManager::Callback(const boost::uuids::uuid& task_id) {
   boost::lock_guard<boost::mutex> guard(lock_);
   in_progress_.erase(task_id);
+  if (in_progress_.empty())
+    everything_processed_.notify_all();
 }
 
 }  // namespace core
@@ -7,6 +7,7 @@
 #include <string>
 
 #include "boost/thread.hpp"
+#include "boost/thread/condition_variable.hpp"
 #include "boost/thread/mutex.hpp"
 #include "boost/utility.hpp"
 #include "boost/uuid/uuid.hpp"
@@ -30,11 +31,16 @@ class BatchManager : boost::noncopyable {
   // Checks if all added tasks were processed
   bool IsEverythingProcessed() const;
 
+  // Blocks until all added tasks are processed, or until timeout expires.
+  // Negative timeout means to wait infinitely. Returns IsEverythingProcessed().
+  bool WaitUntilEverythingProcessed(int timeout_milliseconds = -1) const;
+
   // Marks task as completed
   void Callback(const boost::uuids::uuid& task_id);
 
  private:
   mutable boost::mutex lock_;
+  mutable boost::condition_variable everything_processed_;
   std::set<boost::uuids::uuid> in_progress_;
 };
 
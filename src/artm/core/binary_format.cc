@@ -0,0 +1,67 @@
+// Copyright 2016, Additive Regularization of Topic Models.
+
+#include "artm/core/binary_format.h"
+
+#include <string.h>
+
+#include "boost/lexical_cast.hpp"
+
+#include "artm/core/exceptions.h"
+
+namespace artm {
+namespace core {
+
+bool BinaryFormat::HasMagic(const std::string& file_name, const char* magic) {
+  std::ifstream fin(file_name.c_str(), std::ifstream::binary);
+  char file_magic[kMagicSize];
+  if (!fin.is_open() || !fin.read(file_magic, sizeof(file_magic)))
+    return false;
+  return memcmp(file_magic, magic, sizeof(file_magic)) == 0;
+}
+
+void BinaryFormat::WriteHeader(const char* magic, int version, std::ofstream* fout) {
+  fout->write(magic, kMagicSize);
+  WriteInt(kByteOrderMark, fout);
+  WriteInt(version, fout);
+}
+
+void BinaryFormat::CheckHeader(const char* data, int64_t size, const char* magic, int version,
+                               const std::string& error) {
+  if (size < kHeaderSize || memcmp(data, magic, kMagicSize) != 0)
+    BOOST_THROW_EXCEPTION(DiskReadException(error + " (invalid header)"));
+
+  int header[2];
+  memcpy(header, data + kMagicSize, sizeof(header));
+  if (header[0] != kByteOrderMark)
+    BOOST_THROW_EXCEPTION(DiskReadException(error + " (the file was saved with different byte order)"));
+  if (header[1] != version)
+    BOOST_THROW_EXCEPTION(DiskReadException(
+      error + " (unsupported version " + boost::lexical_cast<std::string>(header[1]) + ")"));
+}
+
+void BinaryFormat::WriteInt(int value, std::ofstream* fout) {
+  fout->write(reinterpret_cast<const char*>(&value), sizeof(int));
+}
+
+void BinaryFormat::WriteString(const std::string& value, std::ofstream* fout) {
+  WriteInt(static_cast<int>(value.size()), fout);
+  fout->write(value.data(), value.size());
+}
+
+bool BinaryFormat::ReadString(const char** cursor, const char* end, std::string* value) {
+  int length;
+  if (end - *cursor < static_cast<int>(sizeof(int)))
+    return false;
+  memcpy(&length, *cursor, sizeof(int));
+  *cursor += sizeof(int);
+
+  if (length < 0 || end - *cursor < length)
+    return false;
+  if (value != nullptr)
+    value->assign(*cursor, length);
+  *cursor += length;
+  return true;
+}
+
+}  // namespace core
+}  // namespace artm
@@ -0,0 +1,51 @@
+// Copyright 2016, Additive Regularization of Topic Models.
+
+#ifndef SRC_ARTM_CORE_BINARY_FORMAT_H_
+#define SRC_ARTM_CORE_BINARY_FORMAT_H_
+
+#include <stdint.h>
+
+#include <fstream>  // NOLINT
+#include <string>
+
+namespace artm {
+namespace core {
+
+// 'class BinaryFormat' contains static helpers shared by the binary files that are read via memory mapping
+// (see FlatBatch and MappedPhiMatrix). Such files start with an 8-byte magic, the byte order mark
+// and the version (int32 each), and store strings as int32 length followed by the characters.
+class BinaryFormat {
+ public:
+  static const int kMagicSize = 8;
+  static const int kByteOrderMark = 0x01020304;
+  static const int kHeaderSize = kMagicSize + 2 * sizeof(int);  // magic, byte order mark and version
+
+  // Returns true if the file starts with the given magic.
+  static bool HasMagic(const std::string& file_name, const char* magic);
+
+  // Writes the magic, the byte order mark and the version.
+  static void WriteHeader(const char* magic, int version, std::ofstream* fout);
+
+  // Throws DiskReadException (with error as a prefix of the message) if data does not start with
+  // the given magic, or if the file was saved with different byte order or with different version.
+  static void CheckHeader(const char* data, int64_t size, const char* magic, int version,
+                          const std::string& error);
+
+  static void WriteInt(int value, std::ofstream* fout);
+  static void WriteString(const std::string& value, std::ofstream* fout);
+
+  template<typename T>
+  static void WriteArray(const T* data, int size, std::ofstream* fout) {
+    if (size > 0)
+      fout->write(reinterpret_cast<const char*>(data), sizeof(T) * size);
+  }
+
+  // Reads the next string from the string table; returns false if the table is truncated.
+  // value may be nullptr to skip the string.
+  static bool ReadString(const char** cursor, const char* end, std::string* value);
+};
+
+}  // namespace core
+}  // namespace artm
+
+#endif  // SRC_ARTM_CORE_BINARY_FORMAT_H_
@@ -2,11 +2,20 @@
 
 #include "artm/core/cache_manager.h"
 
+#include <string.h>
+
+#include <cmath>
+#include <fstream>  // NOLINT
+
+#include "boost/exception/diagnostic_information.hpp"
 #include "boost/filesystem.hpp"
 #include "boost/lexical_cast.hpp"
 #include "boost/uuid/uuid_io.hpp"
 #include "boost/uuid/uuid_generators.hpp"
 
+#include "glog/logging.h"
+
+#include "artm/core/exceptions.h"
 #include "artm/core/helpers.h"
 #include "artm/core/protobuf_helpers.h"
 
@@ -15,36 +24,365 @@ namespace fs = boost::filesystem;
 namespace artm {
 namespace core {
 
-ThetaCacheEntry::ThetaCacheEntry()
-    : theta_matrix_(std::make_shared<ThetaMatrix>()), filename_() {}
+namespace {
+
+// Spill segments are rolled over when they reach this size,
+// so that the disk space is released once all entries of an old segment are replaced or removed.
+const int64_t kSpillSegmentSize = 64 * 1024 * 1024;
+
+const int kSparseFlag = 1;
+const int kFloat16Flag = 2;
+
+uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint32_t sign = (bits >> 16) & 0x8000;
+  const int raw_exponent = (bits >> 23) & 0xff;
+  const int exponent = raw_exponent - 127 + 15;
+  uint32_t mantissa = bits & 0x7fffff;
+
+  if (raw_exponent == 0xff)  // inf or nan
+    return static_cast<uint16_t>(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+  if (exponent >= 0x1f)  // overflow
+    return static_cast<uint16_t>(sign | 0x7c00);
+  if (exponent <= 0) {  // subnormal half or zero
+    if (exponent < -10)
+      return static_cast<uint16_t>(sign);
+    mantissa |= 0x800000;
+    const int shift = 14 - exponent;
+    uint32_t half = mantissa >> shift;
+    if ((mantissa >> (shift - 1)) & 1)
+      half++;
+    return static_cast<uint16_t>(sign | half);
+  }
+
+  // Rounding carry correctly propagates from mantissa into exponent
+  uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+  if (mantissa & 0x1000)
+    half++;
+  return static_cast<uint16_t>(half);
+}
+
+float HalfToFloat(uint16_t half) {
+  const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+  const uint32_t exponent = (half >> 10) & 0x1f;
+  const uint32_t mantissa = half & 0x3ff;
+
+  uint32_t bits;
+  if (exponent == 0x1f) {
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  } else if (mantissa == 0) {
+    bits = sign;
+  } else {
+    const float value = std::ldexp(static_cast<float>(mantissa), -24);
+    return sign != 0 ? -value : value;
+  }
+
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+template<typename T>
+void AppendArray(const std::vector<T>& values, std::string* blob) {
+  const int size = static_cast<int>(values.size());
+  blob->append(reinterpret_cast<const char*>(&size), sizeof(size));
+  if (size > 0)
+    blob->append(reinterpret_cast<const char*>(values.data()), sizeof(T) * size);
+}
 
-ThetaCacheEntry::~ThetaCacheEntry() {
-  if (!filename_.empty()) {
+void AppendString(const std::string& value, std::string* blob) {
+  AppendArray(std::vector<char>(value.begin(), value.end()), blob);
+}
+
+class BlobReader {
+ public:
+  explicit BlobReader(const std::string& blob) : cursor_(blob.data()), end_(blob.data() + blob.size()) {}
+
+  template<typename T>
+  void ReadArray(std::vector<T>* values) {
+    int size;
+    Read(&size, sizeof(size));
+    if (size < 0 || (end_ - cursor_) / static_cast<int64_t>(sizeof(T)) < size)
+      BOOST_THROW_EXCEPTION(CorruptedMessageException("Theta cache entry is truncated"));
+    values->resize(size);
+    if (size > 0)
+      Read(values->data(), sizeof(T) * size);
+  }
+
+  void ReadString(std::string* value) {
+    std::vector<char> chars;
+    ReadArray(&chars);
+    value->assign(chars.begin(), chars.end());
+  }
+
+  void Read(void* data, int64_t size) {
+    if (end_ - cursor_ < size)
+      BOOST_THROW_EXCEPTION(CorruptedMessageException("Theta cache entry is truncated"));
+    memcpy(data, cursor_, size);
+    cursor_ += size;
+  }
+
+  bool eof() const { return cursor_ == end_; }
+
+ private:
+  const char* cursor_;
+  const char* end_;
+};
+
+}  // namespace
+
+// ThetaCacheSpillSegment is an append-only file with serialized theta cache entries.
+// The file is removed once the last entry stored in it is released.
+class ThetaCacheSpillSegment : boost::noncopyable {
+ public:
+  explicit ThetaCacheSpillSegment(const std::string& filename) : filename_(filename), fout_(), size_(0) {
+    fout_.open(filename_.c_str(), std::ofstream::binary);
+    if (!fout_.is_open())
+      BOOST_THROW_EXCEPTION(DiskWriteException("Unable to create file " + filename_));
+  }
+
+  ~ThetaCacheSpillSegment() {
+    fout_.close();
     try { fs::remove(fs::path(filename_)); }
     catch (...) {}
   }
+
+  // Called only by the writer thread. Returns the offset of the blob in the file.
+  int64_t Append(const std::string& blob) {
+    const int64_t offset = size_;
+    fout_.write(blob.data(), blob.size());
+    fout_.flush();
+    if (!fout_)
+      BOOST_THROW_EXCEPTION(DiskWriteException("Unable to write theta cache into " + filename_));
+    size_ += blob.size();
+    return offset;
+  }
+
+  // May be called concurrently with Append() for the blobs that are already written.
+  void Read(int64_t offset, int64_t length, std::string* blob) const {
+    std::ifstream fin(filename_.c_str(), std::ifstream::binary);
+    blob->resize(length);
+    if (!fin.is_open() || !fin.seekg(offset) || (length > 0 && !fin.read(&(*blob)[0], length)))
+      BOOST_THROW_EXCEPTION(DiskReadException("Unable to read theta cache from " + filename_));
+  }
+
+  int64_t size() const { return size_; }
+
+ private:
+  std::string filename_;
+  std::ofstream fout_;
+  int64_t size_;
+};
+
+ThetaCacheEntry::ThetaCacheEntry(const ThetaMatrix& theta_matrix, bool use_float16)
+    : topic_name_(theta_matrix.topic_name().begin(), theta_matrix.topic_name().end()),
+      item_id_(theta_matrix.item_id().begin(), theta_matrix.item_id().end()),
+      item_titles_(), item_title_ptr_(), row_ptr_(), topic_indices_(),
+      values_(), values_float16_(), sparse_(theta_matrix.topic_indices_size() > 0), use_float16_(use_float16) {
+  const int items_count = theta_matrix.item_weights_size();
+  if (theta_matrix.item_id_size() != items_count ||
+      (sparse_ && theta_matrix.topic_indices_size() != items_count))
+    BOOST_THROW_EXCEPTION(InternalError("ThetaCacheEntry: inconsistent theta matrix"));
+
+  if (theta_matrix.item_title_size() == items_count) {
+    item_title_ptr_.reserve(items_count + 1);
+    item_title_ptr_.push_back(0);
+    for (const std::string& title : theta_matrix.item_title()) {
+      item_titles_.append(title);
+      item_title_ptr_.push_back(static_cast<int>(item_titles_.size()));
+    }
+  }
+
+  row_ptr_.reserve(items_count + 1);
+  row_ptr_.push_back(0);
+  for (int item_index = 0; item_index < items_count; ++item_index) {
+    const FloatArray& weights = theta_matrix.item_weights(item_index);
+    if (use_float16_) {
+      for (float value : weights.value())
+        values_float16_.push_back(FloatToHalf(value));
+    } else {
+      values_.insert(values_.end(), weights.value().begin(), weights.value().end());
+    }
+
+    if (sparse_) {
+      const IntArray& indices = theta_matrix.topic_indices(item_index);
+      if (indices.value_size() != weights.value_size())
+        BOOST_THROW_EXCEPTION(InternalError("ThetaCacheEntry: inconsistent theta matrix"));
+      topic_indices_.insert(topic_indices_.end(), indices.value().begin(), indices.value().end());
+    }
+
+    row_ptr_.push_back(row_ptr_.back() + weights.value_size());
+  }
+
+  // Release the extra capacity accumulated by push_back
+  values_.shrink_to_fit();
+  values_float16_.shrink_to_fit();
+  topic_indices_.shrink_to_fit();
+}
+
+ThetaCacheEntry::ThetaCacheEntry(const std::string& blob)
+    : topic_name_(), item_id_(), item_titles_(), item_title_ptr_(), row_ptr_(), topic_indices_(),
+      values_(), values_float16_(), sparse_(false), use_float16_(false) {
+  BlobReader reader(blob);
+  int flags, topics_count;
+  reader.Read(&flags, sizeof(flags));
+  sparse_ = (flags & kSparseFlag) != 0;
+  use_float16_ = (flags & kFloat16Flag) != 0;
+  reader.Read(&topics_count, sizeof(topics_count));
+  if (topics_count < 0)
+    BOOST_THROW_EXCEPTION(CorruptedMessageException("Theta cache entry is corrupted"));
+  topic_name_.resize(topics_count);
+  for (std::string& topic_name : topic_name_)
+    reader.ReadString(&topic_name);
+
+  reader.ReadArray(&item_id_);
+  reader.ReadString(&item_titles_);
+  reader.ReadArray(&item_title_ptr_);
+  reader.ReadArray(&row_ptr_);
+  reader.ReadArray(&topic_indices_);
+  reader.ReadArray(&values_);
+  reader.ReadArray(&values_float16_);
+
+  const int64_t items_count = item_id_.size();
+  const int64_t values_count = use_float16_ ? values_float16_.size() : values_.size();
+  if (!reader.eof() ||
+      static_cast<int64_t>(row_ptr_.size()) != items_count + 1 || row_ptr_.back() != values_count ||
+      (!item_title_ptr_.empty() && static_cast<int64_t>(item_title_ptr_.size()) != items_count + 1) ||
+      (sparse_ ? static_cast<int64_t>(topic_indices_.size()) != values_count : !topic_indices_.empty()))
+    BOOST_THROW_EXCEPTION(CorruptedMessageException("Theta cache entry is corrupted"));
+}
+
+void ThetaCacheEntry::Serialize(std::string* blob) const {
+  blob->clear();
+  blob->reserve(byte_size());
+  const int flags = (sparse_ ? kSparseFlag : 0) | (use_float16_ ? kFloat16Flag : 0);
+  blob->append(reinterpret_cast<const char*>(&flags), sizeof(flags));
+  const int topics_count = static_cast<int>(topic_name_.size());
+  blob->append(reinterpret_cast<const char*>(&topics_count), sizeof(topics_count));
+  for (const std::string& topic_name : topic_name_)
+    AppendString(topic_name, blob);
+
+  AppendArray(item_id_, blob);
+  AppendString(item_titles_, blob);
+  AppendArray(item_title_ptr_, blob);
+  AppendArray(row_ptr_, blob);
+  AppendArray(topic_indices_, blob);
+  AppendArray(values_, blob);
+  AppendArray(values_float16_, blob);
+}
+
+std::shared_ptr<ThetaMatrix> ThetaCacheEntry::ToThetaMatrix() const {
+  auto theta_matrix = std::make_shared<ThetaMatrix>();
+  for (const std::string& topic_name : topic_name_)
+    theta_matrix->add_topic_name(topic_name);
+
+  const int items_count = static_cast<int>(item_id_.size());
+  theta_matrix->mutable_item_id()->Reserve(items_count);
+  theta_matrix->mutable_item_weights()->Reserve(items_count);
+  for (int item_index = 0; item_index < items_count; ++item_index) {
+    theta_matrix->add_item_id(item_id_[item_index]);
+    if (!item_title_ptr_.empty()) {
+      const int begin = item_title_ptr_[item_index];
+      theta_matrix->add_item_title(item_titles_.substr(begin, item_title_ptr_[item_index + 1] - begin));
+    }
+
+    const int begin = row_ptr_[item_index];
+    const int size = row_ptr_[item_index + 1] - begin;
+    FloatArray* weights = theta_matrix->add_item_weights();
+    weights->mutable_value()->Resize(size, 0.0f);
+    float* weights_data = weights->mutable_value()->mutable_data();
+    if (use_float16_) {
+      for (int i = 0; i < size; ++i)
+        weights_data[i] = HalfToFloat(values_float16_[begin + i]);
+    } else if (size > 0) {
+      memcpy(weights_data, &values_[begin], sizeof(float) * size);
+    }
+
+    if (sparse_) {
+      IntArray* indices = theta_matrix->add_topic_indices();
+      indices->mutable_value()->Resize(size, 0);
+      if (size > 0)
+        memcpy(indices->mutable_value()->mutable_data(), &topic_indices_[begin], sizeof(int) * size);
+    }
+  }
+
+  return theta_matrix;
+}
+
+bool ThetaCacheEntry::CopyItemWeights(int index, int size, float* values) const {
+  const int begin = row_ptr_[index];
+  if (sparse_ || row_ptr_[index + 1] - begin != size)
+    return false;
+
+  if (use_float16_) {
+    for (int i = 0; i < size; ++i)
+      values[i] = HalfToFloat(values_float16_[begin + i]);
+  } else if (size > 0) {
+    memcpy(values, &values_[begin], sizeof(float) * size);
+  }
+
+  return true;
+}
+
+int64_t ThetaCacheEntry::byte_size() const {
+  int64_t result = sizeof(int) * (item_id_.size() + item_title_ptr_.size() + row_ptr_.size() + topic_indices_.size());
+  result += sizeof(float) * values_.size() + sizeof(uint16_t) * values_float16_.size();
+  result += item_titles_.size();
+  for (const std::string& topic_name : topic_name_)
+    result += topic_name.size();
+  return result;
 }
 
-CacheManager::CacheManager(const std::string& disk_path)
-    : disk_path_(disk_path), cache_() {}
+CacheManager::CacheManager(const std::string& disk_path, int64_t memory_limit, bool use_float16)
+    : disk_path_(disk_path), lock_(), memory_limit_(memory_limit), use_float16_(use_float16),
+      cache_(), lru_(), memory_bytes_(0), spilling_bytes_(0), is_spill_failed_(false),
+      spill_queue_(), current_segment_(), is_stopping_(false), thread_() {}
 
 CacheManager::~CacheManager() {
-  cache_.clear();
+  is_stopping_ = true;
+  spill_queue_.notify_all();
+  if (thread_.joinable())
+    thread_.join();
+
+  Clear();
+  current_segment_.reset();
+}
+
+void CacheManager::set_memory_limit(int64_t memory_limit) {
+  std::vector<std::shared_ptr<Node>> to_spill;
+  {
+    boost::lock_guard<boost::mutex> guard(lock_);
+    memory_limit_ = memory_limit;
+    EvictLocked(&to_spill);
+  }
+
+  for (auto& node : to_spill)
+    spill_queue_.push(node);
+}
+
+void CacheManager::set_use_float16(bool use_float16) {
+  boost::lock_guard<boost::mutex> guard(lock_);
+  use_float16_ = use_float16;
 }
 
 void CacheManager::Clear() {
+  boost::lock_guard<boost::mutex> guard(lock_);
   cache_.clear();
+  lru_.clear();
+  memory_bytes_ = 0;
+  spilling_bytes_ = 0;
+  spilled_.notify_all();
 }
 
 void CacheManager::RequestMasterComponentInfo(MasterComponentInfo* master_info) const {
-  for (auto& key : cache_.keys()) {
-    std::shared_ptr<ThetaCacheEntry> entry = cache_.get(key);
-    if (entry == nullptr)
-      continue;
-
+  boost::lock_guard<boost::mutex> guard(lock_);
+  for (auto& node : cache_) {
     MasterComponentInfo::CacheEntryInfo* info = master_info->add_cache_entry();
-    info->set_key(boost::lexical_cast<std::string>(key));
-    info->set_byte_size(entry->theta_matrix()->ByteSize());
+    info->set_key(node.first);
+    info->set_byte_size(node.second->entry != nullptr ? node.second->byte_size : node.second->length);
   }
 }
 
@@ -157,7 +495,13 @@ static bool PopulateThetaMatrixFromCacheEntry(const ThetaMatrix& cache,
 
 void CacheManager::RequestThetaMatrix(const GetThetaMatrixArgs& get_theta_args,
                                       ::artm::ThetaMatrix* theta_matrix) const {
-  auto keys = cache_.keys();
+  std::vector<std::string> keys;
+  {
+    boost::lock_guard<boost::mutex> guard(lock_);
+    for (auto& node : cache_)
+      keys.push_back(node.first);
+  }
+
   for (auto &key : keys) {
     std::shared_ptr<ThetaMatrix> cached_theta = FindCacheEntry(key);
     if (cached_theta != nullptr)
@@ -166,41 +510,214 @@ void CacheManager::RequestThetaMatrix(const GetThetaMatrixArgs& get_theta_args,
 }
 
 std::shared_ptr<ThetaMatrix> CacheManager::FindCacheEntry(const std::string& batch_id) const {
-  std::shared_ptr<ThetaCacheEntry> retval = cache_.get(batch_id);
-  if (retval == nullptr)
-    return nullptr;
-  if (retval->filename().empty())
-    return retval->theta_matrix();
+  std::shared_ptr<const ThetaCacheEntry> entry = FindCompactCacheEntry(batch_id);
+  return entry != nullptr ? entry->ToThetaMatrix() : nullptr;
+}
 
-  try {
-    std::shared_ptr<ThetaMatrix> copy(std::make_shared<ThetaMatrix>());
-    Helpers::LoadMessage(retval->filename(), copy.get());
-    return copy;
-  } catch(...) {
-    LOG(ERROR) << "Unable to reload cache for " << retval->filename();
+std::shared_ptr<const ThetaCacheEntry> CacheManager::FindCompactCacheEntry(const std::string& batch_id) const {
+  std::shared_ptr<const ThetaCacheEntry> entry;
+  std::shared_ptr<ThetaCacheSpillSegment> segment;
+  int64_t offset = 0, length = 0;
+  {
+    boost::lock_guard<boost::mutex> guard(lock_);
+    auto iter = cache_.find(batch_id);
+    if (iter == cache_.end())
+      return nullptr;
+
+    Node& node = *iter->second;
+    entry = node.entry;
+    if (entry == nullptr) {
+      segment = node.segment;
+      offset = node.offset;
+      length = node.length;
+    } else if (!node.is_spilling) {
+      lru_.splice(lru_.begin(), lru_, node.lru_position);
+    }
   }
 
-  return nullptr;
+  // Spilled entries are read from disk without being brought back into memory
+  if (entry == nullptr) {
+    try {
+      std::string blob;
+      segment->Read(offset, length, &blob);
+      entry = std::make_shared<ThetaCacheEntry>(blob);
+    } catch (...) {
+      LOG(ERROR) << "Unable to reload cache for batch " << batch_id << ": "
+                 << boost::current_exception_diagnostic_information();
+      return nullptr;
+    }
+  }
+
+  return entry;
 }
 
 void CacheManager::UpdateCacheEntry(const std::string& batch_id, const ThetaMatrix& theta_matrix) const {
-  std::shared_ptr<ThetaCacheEntry> new_entry(std::make_shared<ThetaCacheEntry>());
-  if (disk_path_.empty()) {
-    new_entry->theta_matrix()->CopyFrom(theta_matrix);
+  bool use_float16;
+  {
+    boost::lock_guard<boost::mutex> guard(lock_);
+    use_float16 = use_float16_;
+  }
+
+  auto node = std::make_shared<Node>();
+  node->batch_id = batch_id;
+  node->entry = std::make_shared<ThetaCacheEntry>(theta_matrix, use_float16);
+  node->byte_size = node->entry->byte_size();
+  node->is_spilling = false;
+  node->offset = 0;
+  node->length = 0;
+
+  std::vector<std::shared_ptr<Node>> to_spill;
+  {
+    boost::lock_guard<boost::mutex> guard(lock_);
+    auto iter = cache_.find(batch_id);
+    if (iter != cache_.end())
+      EraseLocked(iter->second);
+
+    cache_[batch_id] = node;
+    lru_.push_front(node);
+    node->lru_position = lru_.begin();
+    memory_bytes_ += node->byte_size;
+    EvictLocked(&to_spill);
+  }
+
+  for (auto& spill_node : to_spill)
+    spill_queue_.push(spill_node);
+}
+
+void CacheManager::WaitForSpill() const {
+  boost::unique_lock<boost::mutex> guard(lock_);
+  while (spilling_bytes_ > 0)
+    spilled_.wait(guard);
+}
+
+void CacheManager::EvictLocked(std::vector<std::shared_ptr<Node>>* to_spill) const {
+  if (memory_limit_ <= 0 && disk_path_.empty())
+    return;  // no limit
+  if (is_spill_failed_)
+    return;  // the disk is not usable, so all entries are kept in memory
+
+  const int64_t memory_limit = std::max<int64_t>(memory_limit_, 0);
+  while (!lru_.empty() && memory_bytes_ - spilling_bytes_ > memory_limit) {
+    std::shared_ptr<Node> node = lru_.back();
+    lru_.pop_back();
+    node->is_spilling = true;
+    spilling_bytes_ += node->byte_size;
+    to_spill->push_back(node);
+  }
+
+  if (!to_spill->empty() && !thread_.joinable()) {
+    // The writer thread is only started when the first entry gets spilled
+    boost::thread t(&CacheManager::SpillThreadFunction, this);
+    thread_.swap(t);
+  }
+}
+
+void CacheManager::EraseLocked(const std::shared_ptr<Node>& node) const {
+  cache_.erase(node->batch_id);
+  if (node->entry == nullptr)
+    return;
+
+  memory_bytes_ -= node->byte_size;
+  if (node->is_spilling) {
+    // The writer thread will discard this node, because it is no longer in cache_
+    spilling_bytes_ -= node->byte_size;
+    spilled_.notify_all();
   } else {
-    boost::uuids::uuid uuid = boost::uuids::random_generator()();
-    fs::path file(boost::lexical_cast<std::string>(uuid) + ".cache");
-    try {
-      Helpers::SaveMessage(file.string(), disk_path_, theta_matrix);
-      new_entry->mutable_filename()->assign((fs::path(disk_path_) / file).string());
-    } catch (...) {
-      LOG(ERROR) << "Unable to save cache entry to " << disk_path_;
-      cache_.set(batch_id, nullptr);
+    lru_.erase(node->lru_position);
+  }
+}
+
+void CacheManager::KeepInMemoryLocked(const std::shared_ptr<Node>& node) const {
+  node->is_spilling = false;
+  spilling_bytes_ -= node->byte_size;
+  spilled_.notify_all();
+  lru_.push_front(node);
+  node->lru_position = lru_.begin();
+}
+
+void CacheManager::SpillThreadFunction() const {
+  try {
+    Helpers::SetThreadName(-1, "CacheManager spill thread");
+    LOG(INFO) << "CacheManager spill thread started";
+
+    for (;;) {
+      if (is_stopping_) {
+        LOG(INFO) << "CacheManager spill thread stopped";
+        break;
+      }
+
+      std::shared_ptr<Node> node;
+      if (!spill_queue_.wait_and_pop(&node, &is_stopping_))
+        continue;
+
+      Spill(node);
+    }
+  }
+  catch (...) {
+    LOG(FATAL) << boost::current_exception_diagnostic_information();
+  }
+}
+
+void CacheManager::Spill(const std::shared_ptr<Node>& node) const {
+  std::shared_ptr<const ThetaCacheEntry> entry;
+  {
+    boost::lock_guard<boost::mutex> guard(lock_);
+    auto iter = cache_.find(node->batch_id);
+    if (iter == cache_.end() || iter->second != node)
+      return;  // the entry was replaced or removed while waiting in the queue
+    if (is_spill_failed_) {
+      KeepInMemoryLocked(node);  // marked for spilling before an earlier write has failed
       return;
     }
+    entry = node->entry;
+  }
+
+  std::string blob;
+  entry->Serialize(&blob);
+
+  std::shared_ptr<ThetaCacheSpillSegment> segment;
+  int64_t offset = 0;
+  try {
+    if (current_segment_ == nullptr || current_segment_->size() >= kSpillSegmentSize) {
+      fs::path dir = disk_path_.empty() ? fs::temp_directory_path() : fs::path(disk_path_);
+      if (!fs::exists(dir))
+        fs::create_directories(dir);
+
+      boost::uuids::uuid uuid = boost::uuids::random_generator()();
+      fs::path file(boost::lexical_cast<std::string>(uuid) + ".cache");
+      current_segment_ = std::make_shared<ThetaCacheSpillSegment>((dir / file).string());
+    }
+
+    segment = current_segment_;
+    offset = segment->Append(blob);
+  } catch (...) {
+    LOG(ERROR) << "Unable to spill cache entry of batch " << node->batch_id << ", spilling is disabled "
+               << "and all entries are kept in memory: " << boost::current_exception_diagnostic_information();
+    current_segment_.reset();
+    segment.reset();
+  }
+
+  boost::lock_guard<boost::mutex> guard(lock_);
+  if (segment == nullptr)
+    is_spill_failed_ = true;
+
+  auto iter = cache_.find(node->batch_id);
+  if (iter == cache_.end() || iter->second != node)
+    return;
+
+  if (segment == nullptr) {
+    KeepInMemoryLocked(node);
+    return;
   }
 
-  cache_.set(batch_id, new_entry);
+  node->is_spilling = false;
+  spilling_bytes_ -= node->byte_size;
+  spilled_.notify_all();
+  node->segment = segment;
+  node->offset = offset;
+  node->length = static_cast<int64_t>(blob.size());
+  node->entry.reset();
+  memory_bytes_ -= node->byte_size;
 }
 
 }  // namespace core
@@ -4,10 +4,16 @@
 #define SRC_ARTM_CORE_CACHE_MANAGER_H_
 
 #include <algorithm>
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "boost/thread.hpp"
+#include "boost/thread/mutex.hpp"
 #include "boost/utility.hpp"
 
 #include "artm/core/common.h"
@@ -16,41 +22,113 @@
 namespace artm {
 namespace core {
 
+// ThetaCacheEntry stores the theta matrix of one batch in a compact columnar form:
+// all weights are kept in one contiguous block (float32, or float16 when requested),
+// and item ids, titles and topic names are kept in separate tables.
+// Entries are immutable once created, so they can be shared between threads without locking.
 class ThetaCacheEntry : boost::noncopyable {
  public:
-  ThetaCacheEntry();
-  ~ThetaCacheEntry();
+  ThetaCacheEntry(const ThetaMatrix& theta_matrix, bool use_float16);
 
-  std::shared_ptr<ThetaMatrix> theta_matrix() { return theta_matrix_; }
-  const std::string& filename() const { return filename_; }
-  std::string* mutable_filename() { return &filename_; }
+  // Restores the entry from a blob produced by Serialize(). Throws CorruptedMessageException on failure.
+  explicit ThetaCacheEntry(const std::string& blob);
+
+  std::shared_ptr<ThetaMatrix> ToThetaMatrix() const;
+  void Serialize(std::string* blob) const;
+
+  int64_t byte_size() const;
+  int item_size() const { return static_cast<int>(item_id_.size()); }
+  int item_id(int index) const { return item_id_[index]; }
+
+  // Copies weights of the item at given position directly into values.
+  // Returns false (and leaves values untouched) if the entry is sparse or the item has a different number of weights.
+  bool CopyItemWeights(int index, int size, float* values) const;
 
  private:
-  std::shared_ptr<ThetaMatrix> theta_matrix_;
-  std::string filename_;
+  std::vector<std::string> topic_name_;
+  std::vector<int> item_id_;
+  std::string item_titles_;
+  std::vector<int> item_title_ptr_;  // empty when the entry has no titles
+  std::vector<int> row_ptr_;
+  std::vector<int> topic_indices_;  // empty for dense entries
+  std::vector<float> values_;
+  std::vector<uint16_t> values_float16_;
+  bool sparse_;
+  bool use_float16_;
 };
 
+class ThetaCacheSpillSegment;
+
 // CacheManager class is responsible for caching ThetaMatrix in between calls to different APIs.
 // This class is used when the user calls FitOffline / FitOnline / Transfor to store the resulting theta matrix.
 // (at least when theta_matrix_type is set to ThetaMatrixType_Cache).
 // Later user may retrieve the data from CacheManager via calls to ArtmRequestThetaMatrix.
 // The cache is organized as a set of entries, each entry associated with a single batch.
 // The key in the cache corresponds to 'batch.id' field.
+//
+// Entries are kept in memory until their total size exceeds memory_limit (zero means no limit);
+// then the least recently used entries are spilled into append-only files in disk_path
+// (or in the system temp folder when disk_path is empty). Spilling runs on a separate writer thread,
+// so the processors are never blocked on disk writes. When disk_path is set and memory_limit is zero,
+// all entries are spilled as soon as they are added. After a failed write spilling is disabled,
+// and all entries are kept in memory regardless of memory_limit.
 class CacheManager : boost::noncopyable {
  public:
-  explicit CacheManager(const std::string& disk_path);
+  explicit CacheManager(const std::string& disk_path, int64_t memory_limit = 0, bool use_float16 = false);
   virtual ~CacheManager();
 
+  void set_memory_limit(int64_t memory_limit);
+  void set_use_float16(bool use_float16);
+
   void RequestMasterComponentInfo(MasterComponentInfo* master_info) const;
   void Clear();
   void RequestThetaMatrix(const GetThetaMatrixArgs& get_theta_args,
                           ::artm::ThetaMatrix* theta_matrix) const;
   std::shared_ptr<ThetaMatrix> FindCacheEntry(const std::string& batch_id) const;
+  std::shared_ptr<const ThetaCacheEntry> FindCompactCacheEntry(const std::string& batch_id) const;
   void UpdateCacheEntry(const std::string& batch_id, const ThetaMatrix& theta_matrix) const;
 
+  // Blocks until all entries marked for spilling are written to disk
+  // (or returned to memory, when the write has failed).
+  void WaitForSpill() const;
+
  private:
+  struct Node {
+    std::string batch_id;
+    std::shared_ptr<const ThetaCacheEntry> entry;  // nullptr once the entry is spilled
+    int64_t byte_size;
+    bool is_spilling;
+    std::list<std::shared_ptr<Node>>::iterator lru_position;  // valid only when in lru_
+
+    std::shared_ptr<ThetaCacheSpillSegment> segment;
+    int64_t offset;
+    int64_t length;
+  };
+
   std::string disk_path_;
-  mutable ThreadSafeCollectionHolder<std::string, ThetaCacheEntry> cache_;
+
+  mutable boost::mutex lock_;
+  int64_t memory_limit_;
+  bool use_float16_;
+  mutable std::map<std::string, std::shared_ptr<Node>> cache_;
+  mutable std::list<std::shared_ptr<Node>> lru_;  // entries that can be spilled, most recently used first
+  mutable int64_t memory_bytes_;  // all entries that are kept in memory, including those being spilled
+  mutable int64_t spilling_bytes_;
+  mutable boost::condition_variable spilled_;  // notified when spilling_bytes_ decreases
+  mutable bool is_spill_failed_;
+
+  mutable ThreadSafeQueue<std::shared_ptr<Node>> spill_queue_;
+  mutable std::shared_ptr<ThetaCacheSpillSegment> current_segment_;  // used only by the writer thread
+  mutable std::atomic<bool> is_stopping_;
+  mutable boost::thread thread_;
+
+  // Marks least recently used entries for spilling (and starts the writer thread if needed).
+  // Must be called under lock_.
+  void EvictLocked(std::vector<std::shared_ptr<Node>>* to_spill) const;
+  void EraseLocked(const std::shared_ptr<Node>& node) const;
+  void KeepInMemoryLocked(const std::shared_ptr<Node>& node) const;  // puts back a node marked for spilling
+  void SpillThreadFunction() const;
+  void Spill(const std::shared_ptr<Node>& node) const;
 };
 
 }  // namespace core
@@ -801,6 +801,14 @@ inline std::string DescribeMessage(const ::artm::ProcessBatchesArgs& message) {
   ss << ", reuse_theta=" << (message.reuse_theta() ? "yes" : "no");
   ss << ", opt_for_avx=" << (message.opt_for_avx() ? "yes" : "no");
   ss << ", predict_class_id=" << (message.predict_class_id());
+  ss << ", nwt_accumulation_mode=" << message.nwt_accumulation_mode();
+  ss << ", deterministic_nwt_reduction=" << (message.deterministic_nwt_reduction() ? "yes" : "no");
+  ss << ", document_chunk_size=" << message.document_chunk_size();
+  ss << ", theta_convergence_tolerance=" << message.theta_convergence_tolerance();
+  ss << ", num_active_topics=" << message.num_active_topics();
+  ss << ", sparse_nwt_target=" << (message.sparse_nwt_target() ? "yes" : "no");
+  ss << ", phi_matrix_locking=" << message.phi_matrix_locking();
+  ss << ", sparse_phi_max_density=" << message.sparse_phi_max_density();
   return ss.str();
 }
 
@@ -811,6 +819,7 @@ inline std::string DescribeMessage(const ::artm::NormalizeModelArgs& message) {
   ss << ": pwt_target_name=" << message.pwt_target_name();
   ss << ", nwt_source_name=" << message.nwt_source_name();
   ss << ", rwt_source_name=" << message.rwt_source_name();
+  ss << ", phi_matrix_storage=" << message.phi_matrix_storage();
   return ss.str();
 }
 
@@ -857,6 +866,20 @@ inline std::string DescribeMessage(const ::artm::MasterModelConfig& message) {
   ss << ", cache_theta=" << (message.cache_theta() ? "yes" : "no");
   ss << ", opt_for_avx=" << (message.opt_for_avx() ? "yes" : "no");
   ss << ", disk_cache_path" << message.disk_cache_path();
+  ss << ", nwt_accumulation_mode=" << message.nwt_accumulation_mode();
+  ss << ", deterministic_nwt_reduction=" << (message.deterministic_nwt_reduction() ? "yes" : "no");
+  ss << ", phi_matrix_storage=" << message.phi_matrix_storage();
+  ss << ", document_chunk_size=" << message.document_chunk_size();
+  ss << ", theta_convergence_tolerance=" << message.theta_convergence_tolerance();
+  ss << ", num_active_topics=" << message.num_active_topics();
+  ss << ", num_prefetched_batches=" << message.num_prefetched_batches();
+  ss << ", theta_cache_memory_limit=" << message.theta_cache_memory_limit();
+  ss << ", theta_cache_float16=" << (message.theta_cache_float16() ? "yes" : "no");
+  ss << ", incremental_normalization_tolerance=" << message.incremental_normalization_tolerance();
+  ss << ", phi_matrix_pool_size=" << message.phi_matrix_pool_size();
+  ss << ", phi_matrix_locking=" << message.phi_matrix_locking();
+  ss << ", sparse_phi_max_density=" << message.sparse_phi_max_density();
+  ss << ", token_index_cache_byte_size=" << message.token_index_cache_byte_size();
 
   return ss.str();
 }
@@ -940,6 +963,7 @@ inline std::string DescribeMessage(const ::artm::ItemsProcessedScore& message) {
   ss << ", num_batches=" << message.num_batches();
   ss << ", token_weight=" << message.token_weight();
   ss << ", token_weight_in_effect=" << message.token_weight_in_effect();
+  ss << ", total_document_passes=" << message.total_document_passes();
   return ss.str();
 }
 
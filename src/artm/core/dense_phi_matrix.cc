@@ -2,7 +2,16 @@
 
 #include "artm/core/dense_phi_matrix.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 #include <algorithm>
+#include <new>
+#include <thread>  // NOLINT
 
 #include "artm/core/helpers.h"
 #include "artm/utility/memory_usage.h"
@@ -14,60 +23,123 @@ namespace core {
 // TokenCollection methods
 // =======================================================
 
+static int64_t NextTokenCollectionVersion() {
+  static std::atomic<int64_t> last_version(0);
+  return ++last_version;
+}
+
+TokenCollection::TokenCollection()
+    : index_(std::make_shared<Index>()), version_(NextTokenCollectionVersion()) {}
+
+TokenCollection::Index* TokenCollection::mutable_index() {
+  if (index_.use_count() > 1)
+    index_ = std::make_shared<Index>(*index_);
+  return index_.get();
+}
+
 int TokenCollection::AddToken(const Token& token) {
   int token_id = this->token_id(token);
   if (token_id != -1)
     return token_id;
 
+  Index* index = mutable_index();
   token_id = token_size();
-  token_to_token_id_.insert(
-    std::make_pair(token, token_id));
-  token_id_to_token_.push_back(token);
+  index->tokens.push_back(token);
+  index->token_index.insert(token, token_id);
+  version_ = NextTokenCollectionVersion();
   return token_id;
 }
 
+void TokenCollection::Reserve(int token_size) {
+  Index* index = mutable_index();
+  index->tokens.reserve(token_size);
+  index->token_index.reserve(token_size);
+}
+
 void TokenCollection::Swap(TokenCollection* rhs) {
-  token_to_token_id_.swap(rhs->token_to_token_id_);
-  token_id_to_token_.swap(rhs->token_id_to_token_);
+  index_.swap(rhs->index_);
+  std::swap(version_, rhs->version_);
 }
 
 bool TokenCollection::has_token(const Token& token) const {
-  return token_to_token_id_.count(token) > 0;
+  return token_id(token) != -1;
 }
 
 int TokenCollection::token_id(const Token& token) const {
-  auto iter = token_to_token_id_.find(token);
-  return (iter != token_to_token_id_.end()) ? iter->second : -1;
+  const std::vector<Token>& tokens = index_->tokens;
+  return index_->token_index.find(token, [&tokens](int token_id) -> const Token& { return tokens[token_id]; });
 }
 
 const Token& TokenCollection::token(int index) const {
-  return token_id_to_token_[index];
+  return index_->tokens[index];
 }
 
 void TokenCollection::Clear() {
-  token_to_token_id_.clear();
-  token_id_to_token_.clear();
+  // Shared index is left to other copies
+  if (index_.use_count() > 1) {
+    index_ = std::make_shared<Index>();
+  } else {
+    index_->tokens.clear();
+    index_->token_index.clear();
+  }
+  version_ = NextTokenCollectionVersion();
 }
 
 int TokenCollection::token_size() const {
-  return static_cast<int>(token_to_token_id_.size());
+  return static_cast<int>(index_->tokens.size());
 }
 
 int64_t TokenCollection::ByteSize() const {
   int64_t retval = 0;
-  retval += artm::utility::getMemoryUsage(token_id_to_token_);
-  retval += artm::utility::getMemoryUsage(token_to_token_id_);
-  for (auto& token : token_id_to_token_) retval += 2 * (token.keyword.size() + token.class_id.size());
+  retval += artm::utility::getMemoryUsage(index_->tokens);
+  retval += index_->token_index.ByteSize();
+  for (auto& token : index_->tokens) retval += token.keyword.size() + token.class_id.size();
   return retval;
 }
 
+// Adds increment to *target with a compare-and-swap loop, so that concurrent writers need no lock.
+// The float is never accessed through std::atomic<float> (it is not an atomic object);
+// instead its bits are exchanged as a 32-bit integer with compiler intrinsics, and converted with memcpy.
+static void AtomicAdd(float* target, float increment) {
+  static_assert(sizeof(float) == sizeof(uint32_t), "AtomicAdd requires 32-bit float");
+  float value;
+  uint32_t desired;
+#if defined(_MSC_VER)
+  volatile long* word = reinterpret_cast<volatile long*>(target);  // NOLINT
+  long expected = *word;  // NOLINT
+  for (;;) {
+    memcpy(&value, &expected, sizeof(float));
+    value += increment;
+    memcpy(&desired, &value, sizeof(float));
+    long previous = _InterlockedCompareExchange(word, static_cast<long>(desired), expected);  // NOLINT
+    if (previous == expected)
+      break;
+    expected = previous;
+  }
+#else
+  uint32_t* word = reinterpret_cast<uint32_t*>(target);
+  uint32_t expected = __atomic_load_n(word, __ATOMIC_RELAXED);
+  do {
+    memcpy(&value, &expected, sizeof(float));
+    value += increment;
+    memcpy(&desired, &value, sizeof(float));
+  } while (!__atomic_compare_exchange_n(word, &expected, desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+#endif
+}
+
 // =======================================================
 // SpinLock methods
 // =======================================================
 
 void SpinLock::Lock() {
+  // The owner might have been preempted (e.g. more threads than cores), so give up the time slice after a while
+  const int kSpinsBeforeYield = 64;
+  int spins = 0;
   while (state_.exchange(kLocked, std::memory_order_acquire) == kLocked) {
-    /* busy-wait */
+    if (++spins == kSpinsBeforeYield) {
+      std::this_thread::yield();
+      spins = 0;
+    }
   }
 }
 
@@ -81,7 +153,7 @@ void SpinLock::Unlock() {
 
 PhiMatrixFrame::PhiMatrixFrame(const ModelName& model_name,
                                const google::protobuf::RepeatedPtrField<std::string>& topic_name)
-    : model_name_(model_name), topic_name_(), token_collection_(), spin_locks_() {
+    : model_name_(model_name), topic_name_(), token_collection_(), locking_(PhiMatrixLocking_Striped) {
   if (topic_name.size() == 0)
     BOOST_THROW_EXCEPTION(artm::core::InvalidOperation("Can not create model " + model_name + " with 0 topics"));
   for (auto iter = topic_name.begin(); iter != topic_name.end(); ++iter) {
@@ -93,11 +165,7 @@ PhiMatrixFrame::PhiMatrixFrame(const PhiMatrixFrame& rhs)
     : model_name_(rhs.model_name_),
       topic_name_(rhs.topic_name_),
       token_collection_(rhs.token_collection_),
-      spin_locks_() {
-  spin_locks_.reserve(rhs.spin_locks_.size());
-  for (unsigned i = 0; i < rhs.spin_locks_.size(); ++i)
-    spin_locks_.push_back(std::make_shared<SpinLock>());
-}
+      locking_(rhs.locking_) {}
 
 const Token& PhiMatrixFrame::token(int index) const {
   return token_collection_.token(index);
@@ -134,23 +202,51 @@ int PhiMatrixFrame::token_index(const Token& token) const {
 
 void PhiMatrixFrame::Clear() {
   token_collection_.Clear();
-  spin_locks_.clear();
 }
 
 int PhiMatrixFrame::AddToken(const Token& token) {
-  int token_id = token_collection_.token_id(token);
-  if (token_id != -1)
-    return token_id;
-
-  spin_locks_.push_back(std::make_shared<SpinLock>());
   return token_collection_.AddToken(token);
 }
 
+// Returns the frame that holds tokens of phi_matrix, looking through matrices that borrow tokens of other matrices
+static const PhiMatrixFrame* FindPhiMatrixFrame(const PhiMatrix* phi_matrix) {
+  while (phi_matrix != nullptr) {
+    const PhiMatrixFrame* frame = dynamic_cast<const PhiMatrixFrame*>(phi_matrix);
+    if (frame != nullptr)
+      return frame;
+
+    const ScaledPhiMatrix* scaled = dynamic_cast<const ScaledPhiMatrix*>(phi_matrix);
+    phi_matrix = (scaled != nullptr) ? scaled->storage().get() : nullptr;
+  }
+
+  return nullptr;
+}
+
+void PhiMatrixFrame::Reshape(const PhiMatrix& phi_matrix) {
+  const PhiMatrixFrame* frame = FindPhiMatrixFrame(&phi_matrix);
+  if (frame != nullptr && frame->token_size() == phi_matrix.token_size()) {
+    token_collection_ = frame->token_collection_;
+    ResetRows(token_size());
+    return;
+  }
+
+  Clear();
+  token_collection_.Reserve(phi_matrix.token_size());
+  ReserveTokens(phi_matrix.token_size());
+  for (int token_id = 0; token_id < phi_matrix.token_size(); ++token_id) {
+    this->AddToken(phi_matrix.token(token_id));
+  }
+
+  // The tokens are now identical to phi_matrix, so both matrices may share cached token lookups
+  if (phi_matrix.token_set_version() != 0 && token_size() == phi_matrix.token_size())
+    token_collection_.set_version(phi_matrix.token_set_version());
+}
+
 void PhiMatrixFrame::Swap(PhiMatrixFrame* rhs) {
   model_name_.swap(rhs->model_name_);
   topic_name_.swap(rhs->topic_name_);
   token_collection_.Swap(&rhs->token_collection_);
-  spin_locks_.swap(rhs->spin_locks_);
+  std::swap(locking_, rhs->locking_);
 }
 
 int64_t PhiMatrixFrame::ByteSize() const {
@@ -161,110 +257,189 @@ int64_t PhiMatrixFrame::ByteSize() const {
 // PackedValues methods
 // =======================================================
 
-PackedValues::PackedValues() : values_(), bitmask_(), ptr_() {}
+static int PopCount(uint64_t word) {
+#if defined(_MSC_VER)
+  return static_cast<int>(__popcnt64(word));
+#else
+  return __builtin_popcountll(word);
+#endif
+}
+
+static int CountTrailingZeros(uint64_t word) {
+#if defined(_MSC_VER)
+  unsigned long index;  // NOLINT
+  _BitScanForward64(&index, word);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(word);
+#endif
+}
+
+static const int kBitsPerWord = 64;
 
-PackedValues::PackedValues(int size) : values_(), bitmask_(), ptr_() {
-  bitmask_.resize(size, false);
+static int NumWords(int size) {
+  return (size + kBitsPerWord - 1) / kBitsPerWord;
 }
 
+PackedValues::PackedValues() : size_(0), values_(), bitmask_() {}
+
+PackedValues::PackedValues(int size) : size_(size), values_(), bitmask_(NumWords(size), 0) {}
+
 PackedValues::PackedValues(const PackedValues& rhs)
-    : values_(rhs.values_), bitmask_(rhs.bitmask_), ptr_(rhs.ptr_) {}
+    : size_(rhs.size_), values_(rhs.values_), bitmask_(rhs.bitmask_) {}
 
-PackedValues::PackedValues(const float* values, int size) : values_(), bitmask_(), ptr_() {
-  values_.resize(size); memcpy(&values_[0], values, sizeof(float) * size);
-  pack();
+PackedValues::PackedValues(const float* values, int size) : size_(0), values_(), bitmask_() {
+  assign(values, size);
+}
+
+bool PackedValues::ShouldPack(int nonzero_size, int size) {
+  // pack iff at 60% of elements (or more) are zeros
+  return (size - nonzero_size) >= (3 * size / 5);
 }
 
 bool PackedValues::is_packed() const {
   return !bitmask_.empty();
 }
 
+const float* PackedValues::data() const {
+  return (is_packed() || values_.empty()) ? nullptr : &values_[0];
+}
+
 float PackedValues::get(int index) const {
-  if (is_packed()) {
-    if (!bitmask_[index])
-      return 0.0f;
-    const auto sparse_ptr = std::lower_bound(ptr_.begin(), ptr_.end(), index);
-    const int sparse_index = sparse_ptr - ptr_.begin();
-    return values_[sparse_index];
-  } else {
+  if (!is_packed())
     return values_[index];
-  }
+
+  const int word_index = index / kBitsPerWord;
+  const uint64_t bit = uint64_t(1) << (index % kBitsPerWord);
+  const uint64_t word = bitmask_[word_index];
+  if ((word & bit) == 0)
+    return 0.0f;
+
+  int rank = PopCount(word & (bit - 1));
+  for (int i = 0; i < word_index; ++i)
+    rank += PopCount(bitmask_[i]);
+  return values_[rank];
 }
 
 void PackedValues::get(std::vector<float>* buffer) const {
-  if (is_packed()) {
-    buffer->assign(buffer->size(), 0.0f);
-    for (int i = 0; i < ptr_.size(); i++)
-      buffer->at(ptr_[i]) = values_[i];
-  } else {
-    buffer->assign(values_.begin(), values_.end());
+  assert(static_cast<int>(buffer->size()) == size_);
+  if (size_ > 0)
+    get(&(*buffer)[0]);
+}
+
+void PackedValues::get(float* buffer) const {
+  if (!is_packed()) {
+    if (size_ > 0)
+      memcpy(buffer, &values_[0], sizeof(float) * size_);
+    return;
+  }
+
+  memset(buffer, 0, sizeof(float) * size_);
+  const float* value = values_.empty() ? nullptr : &values_[0];
+  for (int word_index = 0; word_index < static_cast<int>(bitmask_.size()); ++word_index) {
+    float* word_buffer = buffer + word_index * kBitsPerWord;
+    for (uint64_t word = bitmask_[word_index]; word != 0; word &= word - 1)
+      word_buffer[CountTrailingZeros(word)] = *value++;
   }
 }
 
-float* PackedValues::unpack() {
-  if (is_packed()) {
-    const int full_size = bitmask_.size();
-    const int sparse_size = values_.size();
-    if (values_.size() != ptr_.size())
-      assert(values_.size() == ptr_.size());
+int PackedValues::nonzero_size() const {
+  if (is_packed())
+    return static_cast<int>(values_.size());
+
+  int retval = 0;
+  for (float value : values_)
+    if (value != 0.0f)
+      retval++;
+  return retval;
+}
+
+int PackedValues::get_nonzeros(std::vector<int>* index, std::vector<float>* value) const {
+  if (!is_packed()) {
+    int retval = 0;
+    for (int i = 0; i < static_cast<int>(values_.size()); ++i) {
+      if (values_[i] != 0.0f) {
+        index->push_back(i);
+        value->push_back(values_[i]);
+        retval++;
+      }
+    }
+    return retval;
+  }
 
-    std::vector<float> values(full_size, 0.0f);
-    for (int i = 0; i < sparse_size; ++i)
-      values[ptr_[i]] = values_[i];
+  for (int word_index = 0; word_index < static_cast<int>(bitmask_.size()); ++word_index) {
+    for (uint64_t word = bitmask_[word_index]; word != 0; word &= word - 1)
+      index->push_back(word_index * kBitsPerWord + CountTrailingZeros(word));
+  }
+  value->insert(value->end(), values_.begin(), values_.end());
+  return static_cast<int>(values_.size());
+}
 
-    values_.swap(values);
+float* PackedValues::unpack() {
+  if (is_packed()) {
+    if (values_.empty()) {
+      // Zero row (e.g. after reset) reuses the memory that is still reserved in values_
+      values_.assign(size_, 0.0f);
+    } else {
+      std::vector<float> values(size_, 0.0f);
+      get(&values[0]);
+      values_.swap(values);
+    }
 
     bitmask_.clear();
-    ptr_.clear();
   }
 
   return &values_[0];
 }
 
 void PackedValues::pack() {
-  if (is_packed())
+  if (is_packed() || values_.empty())
     return;
 
-  int num_zeros = 0;
-  for (auto value : values_)
-    if (value == 0)
-      num_zeros++;
-
-  // pack iff at 60% of elements (or more) are zeros
-  if (num_zeros < (3 * values_.size() / 5))
+  if (!ShouldPack(nonzero_size(), size_))
     return;
 
-  bitmask_.resize(values_.size(), false);
-  ptr_.resize(values_.size() - num_zeros);
-  std::vector<float> values(values_.size() - num_zeros, 0.0f);
+  std::vector<float> values;
+  values.swap(values_);
+  assign(&values[0], size_);
+}
+
+void PackedValues::assign(const float* values, int size) {
+  size_ = size;
+  int nonzero_size = 0;
+  for (int i = 0; i < size; ++i)
+    if (values[i] != 0.0f)
+      nonzero_size++;
+
+  if (!ShouldPack(nonzero_size, size)) {
+    values_.assign(values, values + size);
+    bitmask_.clear();
+    return;
+  }
 
+  values_.resize(nonzero_size);
+  bitmask_.assign(NumWords(size), 0);
   int sparse_index = 0;
-  for (int i = 0; i < values_.size(); ++i) {
-    if (values_[i] == 0)
+  for (int i = 0; i < size; ++i) {
+    if (values[i] == 0.0f)
       continue;
 
-    ptr_[sparse_index] = i;
-    values[sparse_index] = values_[i];
-    bitmask_[i] = true;
-    sparse_index++;
+    values_[sparse_index++] = values[i];
+    bitmask_[i / kBitsPerWord] |= uint64_t(1) << (i % kBitsPerWord);
   }
-
-  values_.swap(values);
 }
 
 void PackedValues::reset(int size) {
-  bitmask_.resize(size, false);
+  size_ = size;
+  bitmask_.assign(NumWords(size), 0);
   values_.clear();
-  ptr_.clear();
 }
 
 int64_t PackedValues::ByteSize() const {
   return ::artm::utility::getMemoryUsage(values_) +
-         ::artm::utility::getMemoryUsage(bitmask_) +
-         ::artm::utility::getMemoryUsage(ptr_);
+         ::artm::utility::getMemoryUsage(bitmask_);
 }
 
-
 // =======================================================
 // DensePhiMatrix methods
 // =======================================================
@@ -299,6 +474,19 @@ void DensePhiMatrix::get(int token_id, std::vector<float>* buffer) const {
   values_[token_id].get(buffer);
 }
 
+const float* DensePhiMatrix::get_row(int token_id, std::vector<float>* buffer) const {
+  const float* data = values_[token_id].data();
+  if (data != nullptr)
+    return data;
+
+  // Packed rows have to be unpacked into the buffer
+  return PhiMatrix::get_row(token_id, buffer);
+}
+
+int DensePhiMatrix::get_nonzeros(int token_id, std::vector<int>* topic_index, std::vector<float>* value) const {
+  return values_[token_id].get_nonzeros(topic_index, value);
+}
+
 void DensePhiMatrix::set(int token_id, int topic_id, float value) {
   values_[token_id].unpack()[topic_id] = value;
   if ((topic_id + 1) == topic_size())
@@ -323,6 +511,10 @@ void DensePhiMatrix::increase(int token_id, const std::vector<float>& increment)
   this->Unlock(token_id);
 }
 
+void DensePhiMatrix::set_row(int token_id, const float* values) {
+  values_[token_id].assign(values, topic_size());
+}
+
 void DensePhiMatrix::Clear() {
   values_.clear();
   PhiMatrixFrame::Clear();
@@ -350,11 +542,145 @@ void DensePhiMatrix::Reset() {
     value.reset(topic_size());
 }
 
-void DensePhiMatrix::Reshape(const PhiMatrix& phi_matrix) {
-  Clear();
-  for (int token_id = 0; token_id < phi_matrix.token_size(); ++token_id) {
-    this->AddToken(phi_matrix.token(token_id));
+void DensePhiMatrix::ResetRows(int token_size) {
+  values_.resize(token_size);
+  Reset();
+}
+
+
+// =======================================================
+// ContiguousPhiMatrix methods
+// =======================================================
+
+static float* AllocateAligned(size_t size, size_t alignment) {
+  if (size == 0)
+    return nullptr;
+#if defined(_WIN32)
+  void* ptr = _aligned_malloc(size * sizeof(float), alignment);
+#else
+  void* ptr = nullptr;
+  if (posix_memalign(&ptr, alignment, size * sizeof(float)) != 0)
+    ptr = nullptr;
+#endif
+  if (ptr == nullptr)
+    throw std::bad_alloc();
+  return static_cast<float*>(ptr);
+}
+
+static void FreeAligned(float* ptr) {
+#if defined(_WIN32)
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+ContiguousPhiMatrix::ContiguousPhiMatrix(const ModelName& model_name,
+                                         const google::protobuf::RepeatedPtrField<std::string>& topic_name)
+    : PhiMatrixFrame(model_name, topic_name), row_stride_(0), capacity_(0), data_(nullptr) {
+  const int floats_per_line = kAlignment / sizeof(float);
+  row_stride_ = ((topic_size() + floats_per_line - 1) / floats_per_line) * floats_per_line;
+}
+
+ContiguousPhiMatrix::ContiguousPhiMatrix(const ContiguousPhiMatrix& rhs)
+    : PhiMatrixFrame(rhs), row_stride_(rhs.row_stride_), capacity_(rhs.token_size()), data_(nullptr) {
+  const size_t size = static_cast<size_t>(capacity_) * row_stride_;
+  data_ = AllocateAligned(size, kAlignment);
+  if (size > 0)
+    memcpy(data_, rhs.data_, sizeof(float) * size);
+}
+
+ContiguousPhiMatrix::~ContiguousPhiMatrix() {
+  FreeAligned(data_);
+}
+
+std::shared_ptr<PhiMatrix> ContiguousPhiMatrix::Duplicate() const {
+  return std::shared_ptr<PhiMatrix>(new ContiguousPhiMatrix(*this));
+}
+
+void ContiguousPhiMatrix::get(int token_id, std::vector<float>* buffer) const {
+  assert(topic_size() > 0 && buffer->size() == topic_size());
+  memcpy(&(*buffer)[0], row(token_id), sizeof(float) * topic_size());
+}
+
+void ContiguousPhiMatrix::increase(int token_id, const std::vector<float>& increment) {
+  const int topic_size = this->topic_size();
+  assert(increment.size() == topic_size);
+  float* values = row(token_id);
+
+  if (locking() == PhiMatrixLocking_Atomic) {
+    for (int topic_index = 0; topic_index < topic_size; ++topic_index) {
+      if (increment[topic_index] != 0.0f)
+        AtomicAdd(&values[topic_index], increment[topic_index]);
+    }
+    return;
   }
+
+  this->Lock(token_id);
+  for (int topic_index = 0; topic_index < topic_size; ++topic_index)
+    values[topic_index] += increment[topic_index];
+  this->Unlock(token_id);
+}
+
+void ContiguousPhiMatrix::ReserveTokens(int token_size) {
+  if (token_size <= capacity_)
+    return;
+
+  float* data = AllocateAligned(static_cast<size_t>(token_size) * row_stride_, kAlignment);
+  const size_t used_size = static_cast<size_t>(this->token_size()) * row_stride_;
+  if (used_size > 0)
+    memcpy(data, data_, sizeof(float) * used_size);
+  memset(data + used_size, 0, sizeof(float) * (static_cast<size_t>(token_size) * row_stride_ - used_size));
+
+  FreeAligned(data_);
+  data_ = data;
+  capacity_ = token_size;
+}
+
+int ContiguousPhiMatrix::AddToken(const Token& token) {
+  int token_id = token_index(token);
+  if (token_id != -1)
+    return token_id;
+
+  const int token_size = this->token_size();
+  if (token_size == capacity_)
+    ReserveTokens(std::max(16, 2 * capacity_));
+
+  // Rows beyond token_size() are kept zero-initialized by ReserveTokens and Clear
+  return PhiMatrixFrame::AddToken(token);
+}
+
+void ContiguousPhiMatrix::Clear() {
+  FreeAligned(data_);
+  data_ = nullptr;
+  capacity_ = 0;
+  PhiMatrixFrame::Clear();
+}
+
+void ContiguousPhiMatrix::Reset() {
+  if (data_ != nullptr)
+    memset(data_, 0, sizeof(float) * row_stride_ * static_cast<size_t>(capacity_));
+}
+
+void ContiguousPhiMatrix::ResetRows(int token_size) {
+  if (token_size > capacity_) {
+    FreeAligned(data_);
+    data_ = AllocateAligned(static_cast<size_t>(token_size) * row_stride_, kAlignment);
+    capacity_ = token_size;
+  }
+
+  Reset();
+}
+
+int64_t ContiguousPhiMatrix::ByteSize() const {
+  return PhiMatrixFrame::ByteSize() + sizeof(float) * row_stride_ * static_cast<int64_t>(capacity_);
+}
+
+std::shared_ptr<PhiMatrixFrame> CreatePhiMatrix(PhiMatrixStorage storage, const ModelName& model_name,
+                                                const google::protobuf::RepeatedPtrField<std::string>& topic_name) {
+  if (storage == PhiMatrixStorage_Contiguous)
+    return std::make_shared<ContiguousPhiMatrix>(model_name, topic_name);
+  return std::make_shared<DensePhiMatrix>(model_name, topic_name);
 }
 
 // =======================================================
@@ -400,6 +726,14 @@ void AttachedPhiMatrix::increase(int token_id, const std::vector<float>& increme
   assert(increment.size() == topic_size);
   float* values = values_[token_id];
 
+  if (locking() == PhiMatrixLocking_Atomic) {
+    for (int topic_index = 0; topic_index < topic_size; ++topic_index) {
+      if (increment[topic_index] != 0.0f)
+        AtomicAdd(&values[topic_index], increment[topic_index]);
+    }
+    return;
+  }
+
   this->Lock(token_id);
   for (int topic_index = 0; topic_index < topic_size; ++topic_index)
     values[topic_index] += increment[topic_index];
@@ -415,5 +749,162 @@ int AttachedPhiMatrix::AddToken(const Token& token) {
   BOOST_THROW_EXCEPTION(artm::core::InternalError("Tokens addition is not allowed for attached model."));
 }
 
+void AttachedPhiMatrix::ResetRows(int token_size) {
+  BOOST_THROW_EXCEPTION(artm::core::InternalError("Reshape is not allowed for attached model."));
+}
+
+// =======================================================
+// ScaledPhiMatrix methods
+// =======================================================
+
+void ScaledPhiMatrix::set_topic_name(int topic_id, const std::string& topic_name) {
+  storage_->set_topic_name(topic_id, topic_name);
+}
+
+float ScaledPhiMatrix::get(int token_id, int topic_id) const {
+  return static_cast<float>(scale_ * storage_->get(token_id, topic_id));
+}
+
+void ScaledPhiMatrix::get(int token_id, std::vector<float>* buffer) const {
+  storage_->get(token_id, buffer);
+  for (float& value : *buffer)
+    value = static_cast<float>(scale_ * value);
+}
+
+const float* ScaledPhiMatrix::get_row(int token_id, std::vector<float>* buffer) const {
+  // Scaled values never exist in memory, so the row is always copied into the buffer
+  buffer->resize(topic_size());
+  get(token_id, buffer);
+  return &(*buffer)[0];
+}
+
+int ScaledPhiMatrix::get_nonzeros(int token_id, std::vector<int>* topic_index,
+                                  std::vector<float>* value) const {
+  const size_t begin = value->size();
+  const int retval = storage_->get_nonzeros(token_id, topic_index, value);
+  for (size_t i = begin; i < value->size(); ++i)
+    (*value)[i] = static_cast<float>(scale_ * (*value)[i]);
+  return retval;
+}
+
+void ScaledPhiMatrix::set(int token_id, int topic_id, float value) {
+  storage_->set(token_id, topic_id, static_cast<float>(value / scale_));
+}
+
+void ScaledPhiMatrix::increase(int token_id, int topic_id, float increment) {
+  storage_->increase(token_id, topic_id, static_cast<float>(increment / scale_));
+}
+
+void ScaledPhiMatrix::increase(int token_id, const std::vector<float>& increment) {
+  std::vector<float> scaled_increment(increment);
+  for (float& value : scaled_increment)
+    value = static_cast<float>(value / scale_);
+  storage_->increase(token_id, scaled_increment);
+}
+
+std::shared_ptr<PhiMatrix> ScaledPhiMatrix::Duplicate() const {
+  return std::make_shared<ScaledPhiMatrix>(storage_->Duplicate(), scale_);
+}
+
+// =======================================================
+// SparsePhiMatrix methods
+// =======================================================
+
+SparsePhiMatrix::SparsePhiMatrix(const ModelName& model_name, const PhiMatrix& shape)
+    : PhiMatrixFrame(model_name, shape.topic_name()), rows_(kNumLockStripes), zeros_(), allocated_row_size_(0) {
+  zeros_.resize(topic_size(), 0.0f);
+  Reshape(shape);
+}
+
+int64_t SparsePhiMatrix::ByteSize() const {
+  const int64_t row_size = sizeof(float) * static_cast<int64_t>(topic_size()) + sizeof(RowMap::value_type);
+  return PhiMatrixFrame::ByteSize() + row_size * allocated_row_size_;
+}
+
+const float* SparsePhiMatrix::row(int token_id) const {
+  const RowMap& rows = rows_[lock_stripe(token_id)];
+  auto iter = rows.find(token_id);
+  return (iter == rows.end()) ? nullptr : iter->second.get();
+}
+
+std::vector<int> SparsePhiMatrix::allocated_tokens() const {
+  std::vector<int> token_ids;
+  token_ids.reserve(allocated_row_size_);
+  for (const RowMap& rows : rows_) {
+    for (const auto& elem : rows)
+      token_ids.push_back(elem.first);
+  }
+
+  std::sort(token_ids.begin(), token_ids.end());
+  return token_ids;
+}
+
+float SparsePhiMatrix::get(int token_id, int topic_id) const {
+  const float* values = row(token_id);
+  return (values == nullptr) ? 0.0f : values[topic_id];
+}
+
+void SparsePhiMatrix::get(int token_id, std::vector<float>* buffer) const {
+  const float* values = get_row(token_id, nullptr);
+  buffer->assign(values, values + topic_size());
+}
+
+const float* SparsePhiMatrix::get_row(int token_id, std::vector<float>* buffer) const {
+  const float* values = row(token_id);
+  return (values == nullptr) ? &zeros_[0] : values;
+}
+
+float* SparsePhiMatrix::mutable_row(int token_id) {
+  std::unique_ptr<float[]>& values = rows_[lock_stripe(token_id)][token_id];
+  if (values == nullptr) {
+    values.reset(new float[topic_size()]());
+    allocated_row_size_++;
+  }
+  return values.get();
+}
+
+void SparsePhiMatrix::set(int token_id, int topic_id, float value) {
+  this->Lock(token_id);
+  mutable_row(token_id)[topic_id] = value;
+  this->Unlock(token_id);
+}
+
+void SparsePhiMatrix::increase(int token_id, int topic_id, float increment) {
+  this->Lock(token_id);
+  mutable_row(token_id)[topic_id] += increment;
+  this->Unlock(token_id);
+}
+
+void SparsePhiMatrix::increase(int token_id, const std::vector<float>& increment) {
+  const int topic_size = this->topic_size();
+  assert(increment.size() == topic_size);
+
+  this->Lock(token_id);
+  float* values = mutable_row(token_id);
+  for (int topic_index = 0; topic_index < topic_size; ++topic_index)
+    values[topic_index] += increment[topic_index];
+  this->Unlock(token_id);
+}
+
+void SparsePhiMatrix::Clear() {
+  ResetRows(0);
+  PhiMatrixFrame::Clear();
+}
+
+void SparsePhiMatrix::ResetRows(int token_size) {
+  for (RowMap& rows : rows_)
+    rows.clear();
+  allocated_row_size_ = 0;
+}
+
+std::shared_ptr<PhiMatrix> SparsePhiMatrix::Duplicate() const {
+  auto retval = std::make_shared<SparsePhiMatrix>(model_name(), *this);
+  for (int token_id : allocated_tokens()) {
+    const float* values = row(token_id);
+    std::copy(values, values + topic_size(), retval->mutable_row(token_id));
+  }
+  return retval;
+}
+
 }  // namespace core
 }  // namespace artm
@@ -3,6 +3,8 @@
 #ifndef SRC_ARTM_CORE_DENSE_PHI_MATRIX_H_
 #define SRC_ARTM_CORE_DENSE_PHI_MATRIX_H_
 
+#include <stdint.h>
+
 #include <atomic>
 #include <map>
 #include <memory>
@@ -19,12 +21,18 @@ namespace artm {
 namespace core {
 
 // TokenCollection class represents a sequential vector of tokens.
-// It also contains a mapping from Token to its index for efficient lookup.
+// It also contains a TokenIndex for efficient lookup; the index refers to the vector and holds no copies of tokens.
 // For tokens that are not present in the collection loop up method will return 'UnknownId' constant.
+// Each modification of the collection assigns it a new globally unique version; copies share the version.
+// Copies also share the index itself until one of them is modified (copy-on-write),
+// so matrices of the same shape keep a single token index.
 class TokenCollection {
  public:
+  TokenCollection();
+
   void Clear();
   int  AddToken(const Token& token);
+  void Reserve(int token_size);
   void Swap(TokenCollection* rhs);
   int64_t ByteSize() const;
 
@@ -33,9 +41,19 @@ class TokenCollection {
   int token_id(const Token& token) const;
   const Token& token(int index) const;
 
+  int64_t version() const { return version_; }
+  void set_version(int64_t version) { version_ = version; }
+
  private:
-  std::unordered_map<Token, int, TokenHasher> token_to_token_id_;
-  std::vector<Token> token_id_to_token_;
+  struct Index {
+    std::vector<Token> tokens;
+    TokenIndex token_index;
+  };
+
+  Index* mutable_index();
+
+  std::shared_ptr<Index> index_;
+  int64_t version_;
 };
 
 // A simple spin lock class, used for synchronization.
@@ -68,29 +86,73 @@ class PhiMatrixFrame : public PhiMatrix {
   virtual const Token& token(int index) const;
   virtual bool has_token(const Token& token) const;
   virtual int token_index(const Token& token) const;
+  virtual int64_t token_set_version() const { return token_collection_.version(); }
   virtual google::protobuf::RepeatedPtrField<std::string> topic_name() const;
   virtual const std::string& topic_name(int topic_id) const;
   virtual void set_topic_name(int topic_id, const std::string& topic_name);
   virtual ModelName model_name() const;
   virtual int64_t ByteSize() const;
+  void set_model_name(const ModelName& model_name) { model_name_ = model_name; }
 
   void Clear();
   virtual int AddToken(const Token& token);
 
-  void Lock(int token_id) { spin_locks_[token_id]->Lock(); }
-  void Unlock(int token_id) { spin_locks_[token_id]->Unlock(); }
+  // Replaces all tokens with tokens from phi_matrix (in the same order). Values are set to zero.
+  // When phi_matrix is (or wraps) a PhiMatrixFrame the token index is shared instead of being copied,
+  // and the storage already allocated by this matrix is reused.
+  void Reshape(const PhiMatrix& phi_matrix);
+
+  // Lock(token_id) and Unlock(token_id) guard concurrent increase() of the same row.
+  // Rows are mapped onto a fixed table of lock stripes, so no lock objects are allocated per token.
+  // With PhiMatrixLocking_None the caller guarantees that there is a single writer, and no locks are taken.
+  // With PhiMatrixLocking_Atomic derived classes with stable row addresses add non-zero increments one by one with
+  // atomic operations (which only pays off for a small number of topics);
+  // others (e.g. DensePhiMatrix, whose rows may be packed) still use the lock stripes.
+  void Lock(int token_id) {
+    if (locking_ != PhiMatrixLocking_None)
+      lock_stripes_[lock_stripe(token_id)].lock.Lock();
+  }
+
+  void Unlock(int token_id) {
+    if (locking_ != PhiMatrixLocking_None)
+      lock_stripes_[lock_stripe(token_id)].lock.Unlock();
+  }
+
+  PhiMatrixLocking locking() const { return locking_; }
+  void set_locking(PhiMatrixLocking locking) { locking_ = locking; }
 
   void Swap(PhiMatrixFrame* rhs);
 
   PhiMatrixFrame(const PhiMatrixFrame& rhs);
   PhiMatrixFrame& operator=(const PhiMatrixFrame&);
 
+ protected:
+  static const int kNumLockStripes = 1024;
+
+  // Returns the lock stripe that guards the row; all rows of one stripe are written under the same lock
+  static int lock_stripe(int token_id) { return token_id % kNumLockStripes; }
+
+  // Allows derived classes to pre-allocate storage before a known number of tokens is added
+  virtual void ReserveTokens(int token_size) { }
+
+  // Resizes the storage to token_size rows with all values set to zero, reusing existing allocations if possible
+  virtual void ResetRows(int token_size) = 0;
+
  private:
   ModelName model_name_;
   std::vector<std::string> topic_name_;
 
+  static const int kCacheLineSize = 64;
+
+  // Each stripe takes a whole cache line, so that threads holding neighbouring stripes do not contend
+  struct LockStripe {
+    SpinLock lock;
+    char padding[kCacheLineSize - sizeof(SpinLock)];
+  };
+
   TokenCollection token_collection_;
-  std::vector<std::shared_ptr<SpinLock> > spin_locks_;
+  PhiMatrixLocking locking_;
+  LockStripe lock_stripes_[kNumLockStripes];
 };
 
 class DensePhiMatrix;
@@ -98,6 +160,9 @@ class AttachedPhiMatrix;
 
 // PackedValues class represents one row of Phi matrix.
 // Sparse rows (with many zeros) might be packed for memory efficiency.
+// A packed row keeps only its non-zero values, and a bitmap of 64-bit words that marks their positions.
+// Single values are located by counting the set bits (popcount) in front of their position,
+// and whole rows are scattered directly into the caller's buffer by walking the set bits.
 class PackedValues {
  public:
   PackedValues();
@@ -107,16 +172,29 @@ class PackedValues {
   virtual int64_t ByteSize() const;
 
   bool is_packed() const;
+  const float* data() const;  // returns nullptr for packed values
   float get(int index) const;
   void get(std::vector<float>* buffer) const;
+  void get(float* buffer) const;  // writes all size() values
   float* unpack();
   void pack();
   void reset(int size);
 
+  // Replaces all values of the row; the row is stored packed if it is sparse enough (see pack()).
+  void assign(const float* values, int size);
+
+  int size() const { return size_; }
+  int nonzero_size() const;
+
+  // Appends positions and values of non-zero elements; for packed rows they are read directly from the bitmap.
+  int get_nonzeros(std::vector<int>* index, std::vector<float>* value) const;
+
  private:
-  std::vector<float> values_;
-  std::vector<bool> bitmask_;
-  std::vector<int> ptr_;
+  static bool ShouldPack(int nonzero_size, int size);
+
+  int size_;
+  std::vector<float> values_;      // all values, or only non-zero values if the row is packed
+  std::vector<uint64_t> bitmask_;  // empty unless the row is packed
 };
 
 // DensePhiMatrix class implements PhiMatrix interface as a dense matrix.
@@ -133,6 +211,8 @@ class DensePhiMatrix : public PhiMatrixFrame {
 
   virtual float get(int token_id, int topic_id) const;
   virtual void get(int token_id, std::vector<float>* buffer) const;
+  virtual const float* get_row(int token_id, std::vector<float>* buffer) const;
+  virtual int get_nonzeros(int token_id, std::vector<int>* topic_index, std::vector<float>* value) const;
   virtual void set(int token_id, int topic_id, float value);
   virtual void increase(int token_id, int topic_id, float increment);
   virtual void increase(int token_id, const std::vector<float>& increment);  // must be thread-safe
@@ -141,7 +221,13 @@ class DensePhiMatrix : public PhiMatrixFrame {
   virtual int AddToken(const Token& token);
 
   void Reset();
-  void Reshape(const PhiMatrix& phi_matrix);
+
+  // Replaces all values of the row at once. Unlike a sequence of set() calls this never unpacks a packed row;
+  // the row is packed or unpacked depending on the density of new values.
+  void set_row(int token_id, const float* values);
+
+ protected:
+  virtual void ResetRows(int token_size);
 
  private:
   friend class AttachedPhiMatrix;
@@ -152,6 +238,56 @@ class DensePhiMatrix : public PhiMatrixFrame {
   std::vector<PackedValues> values_;
 };
 
+// ContiguousPhiMatrix class implements PhiMatrix interface as a dense matrix,
+// stored in a single 64-byte aligned block of memory (one allocation for the entire matrix).
+// Each row is padded to a multiple of 16 floats, so that every row starts at a cache line boundary
+// and can be read in place (see row() method) with aligned SIMD loads.
+// Unlike DensePhiMatrix, rows are never packed, so sparse matrices take more memory.
+class ContiguousPhiMatrix : public PhiMatrixFrame {
+ public:
+  static const int kAlignment = 64;  // in bytes
+
+  explicit ContiguousPhiMatrix(const ModelName& model_name,
+                               const google::protobuf::RepeatedPtrField<std::string>& topic_name);
+
+  virtual ~ContiguousPhiMatrix();
+  virtual int64_t ByteSize() const;
+
+  virtual std::shared_ptr<PhiMatrix> Duplicate() const;
+
+  virtual float get(int token_id, int topic_id) const { return row(token_id)[topic_id]; }
+  virtual void get(int token_id, std::vector<float>* buffer) const;
+  virtual const float* get_row(int token_id, std::vector<float>* buffer) const { return row(token_id); }
+  virtual void set(int token_id, int topic_id, float value) { row(token_id)[topic_id] = value; }
+  virtual void increase(int token_id, int topic_id, float increment) { row(token_id)[topic_id] += increment; }
+  virtual void increase(int token_id, const std::vector<float>& increment);  // must be thread-safe
+
+  virtual void Clear();
+  virtual int AddToken(const Token& token);
+
+  void Reset();
+
+  // Returns a pointer to topic_size() values of the token; valid until next AddToken or Clear.
+  const float* row(int token_id) const { return data_ + static_cast<size_t>(token_id) * row_stride_; }
+  float* row(int token_id) { return data_ + static_cast<size_t>(token_id) * row_stride_; }
+
+ protected:
+  virtual void ReserveTokens(int token_size);
+  virtual void ResetRows(int token_size);
+
+ private:
+  ContiguousPhiMatrix(const ContiguousPhiMatrix& rhs);
+  ContiguousPhiMatrix& operator=(const ContiguousPhiMatrix&);
+
+  int row_stride_;  // number of floats between two consecutive rows
+  int capacity_;    // number of rows allocated in data_
+  float* data_;
+};
+
+// Creates an empty phi matrix with the requested storage engine.
+std::shared_ptr<PhiMatrixFrame> CreatePhiMatrix(PhiMatrixStorage storage, const ModelName& model_name,
+                                                const google::protobuf::RepeatedPtrField<std::string>& topic_name);
+
 // DensePhiMatrix class implements PhiMatrix interface as a dense matrix.
 // The class DOES NOT own the memory, allocated to store the elements.
 // Instead the memory is provided by external code.
@@ -166,6 +302,7 @@ class AttachedPhiMatrix : boost::noncopyable, public PhiMatrixFrame {
 
   virtual float get(int token_id, int topic_id) const { return values_[token_id][topic_id]; }
   virtual void get(int token_id, std::vector<float>* buffer) const;
+  virtual const float* get_row(int token_id, std::vector<float>* buffer) const { return values_[token_id]; }
   virtual void set(int token_id, int topic_id, float value) { values_[token_id][topic_id] = value; }
   virtual void increase(int token_id, int topic_id, float increment) { values_[token_id][topic_id] += increment; }
   virtual void increase(int token_id, const std::vector<float>& increment);  // must be thread-safe
@@ -173,11 +310,101 @@ class AttachedPhiMatrix : boost::noncopyable, public PhiMatrixFrame {
   virtual void Clear();
   virtual int AddToken(const Token& token);
 
+ protected:
+  virtual void ResetRows(int token_size);
+
  private:
   friend class DensePhiMatrix;
   std::vector<float*> values_;
 };
 
+// ScaledPhiMatrix represents the matrix 'scale * storage' without touching the values in the storage.
+// This allows to multiply the whole matrix by a constant in O(1), which is used to decay n_wt in online algorithm.
+// All writes are divided by the scale before they go into the storage.
+// The storage may be shared between several ScaledPhiMatrix instances with different scales.
+class ScaledPhiMatrix : boost::noncopyable, public PhiMatrix {
+ public:
+  ScaledPhiMatrix(std::shared_ptr<PhiMatrix> storage, double scale) : storage_(storage), scale_(scale) {}
+
+  const std::shared_ptr<PhiMatrix>& storage() const { return storage_; }
+  double scale() const { return scale_; }
+
+  virtual int token_size() const { return storage_->token_size(); }
+  virtual int topic_size() const { return storage_->topic_size(); }
+  virtual google::protobuf::RepeatedPtrField<std::string> topic_name() const { return storage_->topic_name(); }
+  virtual const std::string& topic_name(int topic_id) const { return storage_->topic_name(topic_id); }
+  virtual void set_topic_name(int topic_id, const std::string& topic_name);
+  virtual ModelName model_name() const { return storage_->model_name(); }
+  virtual int64_t ByteSize() const { return storage_->ByteSize(); }
+
+  virtual const Token& token(int index) const { return storage_->token(index); }
+  virtual bool has_token(const Token& token) const { return storage_->has_token(token); }
+  virtual int token_index(const Token& token) const { return storage_->token_index(token); }
+  virtual int64_t token_set_version() const { return storage_->token_set_version(); }
+
+  virtual float get(int token_id, int topic_id) const;
+  virtual void get(int token_id, std::vector<float>* buffer) const;
+  virtual const float* get_row(int token_id, std::vector<float>* buffer) const;
+  virtual int get_nonzeros(int token_id, std::vector<int>* topic_index, std::vector<float>* value) const;
+
+  virtual void set(int token_id, int topic_id, float value);
+  virtual void increase(int token_id, int topic_id, float increment);
+  virtual void increase(int token_id, const std::vector<float>& increment);  // must be thread-safe
+
+  virtual void Clear() { storage_->Clear(); }
+  virtual int AddToken(const Token& token) { return storage_->AddToken(token); }
+
+  virtual std::shared_ptr<PhiMatrix> Duplicate() const;
+
+ private:
+  std::shared_ptr<PhiMatrix> storage_;
+  double scale_;
+};
+
+// SparsePhiMatrix is an accumulator for n_wt increments that allocates rows only for tokens that were written.
+// The set of tokens is shared with another matrix (typically p_wt) by Reshape(), so the structure is not copied.
+// Only allocated rows are indexed: each lock stripe of the frame owns a map from token id to the row,
+// so concurrent writers that hold different stripes never touch the same map.
+// Rows that were never written read as zeros; row() returns nullptr for them, which allows to skip such rows.
+// Writes are thread-safe with respect to each other, but must not be mixed with reads.
+class SparsePhiMatrix : boost::noncopyable, public PhiMatrixFrame {
+ public:
+  SparsePhiMatrix(const ModelName& model_name, const PhiMatrix& shape);
+  virtual ~SparsePhiMatrix() { }
+  virtual int64_t ByteSize() const;
+
+  virtual float get(int token_id, int topic_id) const;
+  virtual void get(int token_id, std::vector<float>* buffer) const;
+  virtual const float* get_row(int token_id, std::vector<float>* buffer) const;
+
+  virtual void set(int token_id, int topic_id, float value);
+  virtual void increase(int token_id, int topic_id, float increment);
+  virtual void increase(int token_id, const std::vector<float>& increment);  // must be thread-safe
+
+  virtual void Clear();
+
+  virtual std::shared_ptr<PhiMatrix> Duplicate() const;
+
+  // Returns values of the token, or nullptr if the row was never written.
+  const float* row(int token_id) const;
+  int allocated_row_size() const { return allocated_row_size_; }
+
+  // Returns ids of all written rows in ascending order.
+  std::vector<int> allocated_tokens() const;
+
+ protected:
+  virtual void ResetRows(int token_size);
+
+ private:
+  typedef std::unordered_map<int, std::unique_ptr<float[]>> RowMap;
+
+  float* mutable_row(int token_id);  // allocates the row on first access; caller must hold the lock
+
+  std::vector<RowMap> rows_;  // one map per lock stripe
+  std::vector<float> zeros_;
+  std::atomic<int> allocated_row_size_;
+};
+
 }  // namespace core
 }  // namespace artm
 
@@ -6,33 +6,37 @@
 namespace artm {
 namespace core {
 
+int Dictionary::token_index(const Token& token) const {
+  return token_index_.find(token, [this](int index) -> const Token& { return entries_[index].token(); });
+}
+
 void Dictionary::AddEntry(const DictionaryEntry& entry) {
-  if (token_index_.find(entry.token()) != token_index_.end()) {
+  if (token_index(entry.token()) != -1) {
     LOG(WARNING) << "Token " << entry.token().keyword << " (" << entry.token().class_id
       << ") is already in dictionary";
     return;
   }
 
   entries_.push_back(entry);
-  token_index_.insert(std::make_pair(entry.token(), entries_.size() - 1));
+  token_index_.insert(entry.token(), static_cast<int>(entries_.size()) - 1);
 }
 
 void Dictionary::AddCoocImpl(const Token& token_1, const Token& token_2, float value, CoocMap* cooc_map) {
   // check tokens are in the dictionary, e.g. exist in token_index_
-  auto token_1_index = token_index_.find(token_1);
-  if (token_1_index == token_index_.end()) {
+  int token_1_index = token_index(token_1);
+  if (token_1_index == -1) {
     LOG(WARNING) << "No token " << token_1.keyword
                  << " (" << token_1.class_id << ") in dictionary";
     return;
   }
 
-  auto token_2_index = token_index_.find(token_2);
-  if (token_2_index == token_index_.end()) {
+  int token_2_index = token_index(token_2);
+  if (token_2_index == -1) {
     LOG(WARNING) << "No token " << token_2.keyword << " (" << token_2.class_id << ") in dictionary";
     return;
   }
 
-  AddCoocImpl(token_1_index->second, token_2_index->second, value, cooc_map);
+  AddCoocImpl(token_1_index, token_2_index, value, cooc_map);
 }
 
 void Dictionary::AddCoocImpl(int index_1, int index_2, float value, CoocMap* cooc_map) {
@@ -79,7 +83,7 @@ bool Dictionary::has_valid_cooc_state() const {
 int64_t Dictionary::ByteSize() const {
   int64_t retval = 0;
   retval += ::artm::utility::getMemoryUsage(entries_);
-  retval += ::artm::utility::getMemoryUsage(token_index_);
+  retval += token_index_.ByteSize();
   retval += ::artm::utility::getMemoryUsage(cooc_values_);
   retval += ::artm::utility::getMemoryUsage(cooc_tfs_);
   retval += ::artm::utility::getMemoryUsage(cooc_dfs_);
@@ -87,15 +91,15 @@ int64_t Dictionary::ByteSize() const {
   for (auto& entry : cooc_tfs_) retval += ::artm::utility::getMemoryUsage(entry.second);
   for (auto& entry : cooc_dfs_) retval += ::artm::utility::getMemoryUsage(entry.second);
   for (auto& entry : entries_)
-    retval += 2 * (entry.token().keyword.size() + entry.token().class_id.size());
+    retval += entry.token().keyword.size() + entry.token().class_id.size();
   return retval;
 }
 
 const std::unordered_map<int, float>* Dictionary::cooc_info_impl(const Token& token, const CoocMap& cooc_map) const {
-  auto index_iter = token_index_.find(token);
-  if (index_iter == token_index_.end()) return nullptr;
+  int index = token_index(token);
+  if (index == -1) return nullptr;
 
-  auto cooc_map_iter = cooc_map.find(index_iter->second);
+  auto cooc_map_iter = cooc_map.find(index);
   if (cooc_map_iter == cooc_map.end()) return nullptr;
 
   return &(cooc_map_iter->second);
@@ -114,9 +118,9 @@ const std::unordered_map<int, float>*  Dictionary::token_cooc_dfs(const Token& t
 }
 
 const DictionaryEntry* Dictionary::entry(const Token& token) const {
-  auto find_iter = token_index_.find(token);
-  if (find_iter != token_index_.end())
-    return &entries_[find_iter->second];
+  int index = token_index(token);
+  if (index != -1)
+    return &entries_[index];
   else
     return nullptr;
 }
@@ -134,9 +138,7 @@ float Dictionary::CountTopicCoherence(const std::vector<core::Token>& tokens_to_
   // -1 means that find() result == end()
   auto indices = std::vector<int>(k, -1);
   for (int i = 0; i < k; ++i) {
-    auto token_index_iter = token_index_.find(tokens_to_score[i]);
-    if (token_index_iter == token_index_.end()) continue;
-    indices[i] = token_index_iter->second;
+    indices[i] = token_index(tokens_to_score[i]);
   }
 
   for (int i = 0; i < k - 1; ++i) {
@@ -67,7 +67,7 @@ class Dictionary {
 
   void SetNumItems(int num_items) { num_items_in_collection_ = num_items; }
 
-  bool HasToken(const Token& token) const { return token_index_.find(token) != token_index_.end(); }
+  bool HasToken(const Token& token) const { return token_index(token) != -1; }
 
   // SECTION OF GETTERS
   // general method to return all cooc tokens with their values for given token
@@ -85,7 +85,8 @@ class Dictionary {
   int64_t ByteSize() const;
 
   const std::vector<DictionaryEntry>& entries() const { return entries_; }
-  const std::unordered_map<Token, int, TokenHasher>& token_index() const { return token_index_; }
+  // Returns the index of the entry with given token, or -1 if there is no such entry
+  int token_index(const Token& token) const;
 
   const std::unordered_map<int, std::unordered_map<int, float> >& cooc_values() const { return cooc_values_; }
   const std::unordered_map<int, std::unordered_map<int, float> >& cooc_tfs() const { return cooc_tfs_; }
@@ -102,7 +103,7 @@ class Dictionary {
  private:
   std::string name_;
   std::vector<DictionaryEntry> entries_;
-  std::unordered_map<Token, int, TokenHasher> token_index_;
+  TokenIndex token_index_;
   CoocMap cooc_values_;
   CoocMap cooc_tfs_;
   CoocMap cooc_dfs_;
@@ -245,7 +245,7 @@ std::shared_ptr<Dictionary> DictionaryOperations::Gather(const GatherDictionaryA
     try {
       if (batch_ptr == nullptr) {
         batch_ptr = std::make_shared<Batch>();
-        ::artm::core::Helpers::LoadMessage(batch_file, batch_ptr.get());
+        ::artm::core::Helpers::LoadBatch(batch_file, batch_ptr.get());
       }
     }
     catch (std::exception& ex) {
@@ -425,7 +425,6 @@ std::shared_ptr<Dictionary> DictionaryOperations::Filter(const FilterDictionaryA
   auto dictionary = std::make_shared<Dictionary>(Dictionary(args.dictionary_target_name()));
 
   auto& src_entries = dict.entries();
-  auto& dictionary_token_index = dict.token_index();
   std::unordered_map<int, int> old_index_new_index;
 
   float size = static_cast<float>(dict.num_items());
@@ -471,8 +470,7 @@ std::shared_ptr<Dictionary> DictionaryOperations::Filter(const FilterDictionaryA
     accepted_tokens_count += 1;
     dictionary->AddEntry(entry);
 
-    old_index_new_index.insert(std::pair<int, int>(dictionary_token_index.find(entry.token())->second,
-      accepted_tokens_count - 1));
+    old_index_new_index.insert(std::pair<int, int>(entry_index, accepted_tokens_count - 1));
   }
 
   auto& cooc_values = dict.cooc_values();
@@ -0,0 +1,44 @@
+// Copyright 2016, Additive Regularization of Topic Models.
+
+#include "artm/core/document_chunk_task.h"
+
+#include <algorithm>
+
+namespace artm {
+namespace core {
+
+DocumentChunkTask::DocumentChunkTask(int size, int chunk_size, Function function)
+    : size_(size), chunk_size_(std::max(chunk_size, 1)), num_chunks_(0), function_(function),
+      next_chunk_(0), lock_(), completed_(), num_completed_(0) {
+  num_chunks_ = (size_ + chunk_size_ - 1) / chunk_size_;
+}
+
+void DocumentChunkTask::Run() {
+  int chunks_done = 0;
+  for (;;) {
+    const int chunk = next_chunk_.fetch_add(1);
+    if (chunk >= num_chunks_)
+      break;
+
+    const int begin = chunk * chunk_size_;
+    function_(begin, std::min(begin + chunk_size_, size_));
+    chunks_done++;
+  }
+
+  if (chunks_done == 0)
+    return;
+
+  boost::lock_guard<boost::mutex> guard(lock_);
+  num_completed_ += chunks_done;
+  if (num_completed_ == num_chunks_)
+    completed_.notify_all();
+}
+
+void DocumentChunkTask::Wait() {
+  boost::unique_lock<boost::mutex> lock(lock_);
+  while (num_completed_ < num_chunks_)
+    completed_.wait(lock);
+}
+
+}  // namespace core
+}  // namespace artm
@@ -0,0 +1,52 @@
+// Copyright 2016, Additive Regularization of Topic Models.
+
+#ifndef SRC_ARTM_CORE_DOCUMENT_CHUNK_TASK_H_
+#define SRC_ARTM_CORE_DOCUMENT_CHUNK_TASK_H_
+
+#include <atomic>
+#include <functional>
+
+#include "boost/thread/condition_variable.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/utility.hpp"
+
+namespace artm {
+namespace core {
+
+// DocumentChunkTask splits range [0, size) (typically documents or tokens of one batch) into chunks.
+// The processor that owns the batch creates the task and calls Run(); idle processors may join
+// by calling Run() as well (they receive the task via ProcessorInput::document_chunk_task()).
+// Each caller keeps taking the next unprocessed chunk until none are left, so fast threads steal work from slow ones.
+// The function must be thread-safe across different chunks.
+// Helpers may call Run() after the owner has finished; in this case no chunks are left and function is not called,
+// so it is safe for the function to capture references to the owner's stack.
+class DocumentChunkTask : boost::noncopyable {
+ public:
+  typedef std::function<void(int begin, int end)> Function;
+
+  DocumentChunkTask(int size, int chunk_size, Function function);
+
+  // Executes chunks until there are none left.
+  void Run();
+
+  // Blocks until all chunks are completed, including those taken by other threads.
+  void Wait();
+
+  int num_chunks() const { return num_chunks_; }
+
+ private:
+  int size_;
+  int chunk_size_;
+  int num_chunks_;
+  Function function_;
+  std::atomic<int> next_chunk_;
+
+  boost::mutex lock_;
+  boost::condition_variable completed_;
+  int num_completed_;
+};
+
+}  // namespace core
+}  // namespace artm
+
+#endif  // SRC_ARTM_CORE_DOCUMENT_CHUNK_TASK_H_
@@ -0,0 +1,222 @@
+// Copyright 2016, Additive Regularization of Topic Models.
+
+#include "artm/core/flat_batch.h"
+
+#include <string.h>
+
+#include <fstream>  // NOLINT
+#include <vector>
+
+#include "artm/core/binary_format.h"
+#include "artm/core/exceptions.h"
+
+namespace artm {
+namespace core {
+
+namespace {
+
+const char kFlatBatchMagic[BinaryFormat::kMagicSize] = { 'A', 'R', 'T', 'M', 'F', 'L', 'A', 'T' };
+const int kHeaderSize = BinaryFormat::kHeaderSize + 4 * sizeof(int);
+
+}  // namespace
+
+bool FlatBatch::IsFlatBatch(const std::string& full_filename) {
+  return BinaryFormat::HasMagic(full_filename, kFlatBatchMagic);
+}
+
+void FlatBatch::Save(const Batch& batch, const std::string& full_filename) {
+  if (!batch.has_id())
+    BOOST_THROW_EXCEPTION(InvalidOperation("FlatBatch::Save: batch expecting id"));
+  if (batch.class_id_size() != 0 && batch.class_id_size() != batch.token_size())
+    BOOST_THROW_EXCEPTION(InvalidOperation("FlatBatch::Save: batch.class_id_size() != batch.token_size()"));
+
+  if (batch.token_size() == 0 && batch.item_size() != 0)
+    BOOST_THROW_EXCEPTION(InvalidOperation(
+      "FlatBatch::Save: batch without tokens is not supported, its token ids refer to p_wt"));
+
+  std::vector<int> row_ptr(1, 0);
+  std::vector<int> token_id;
+  std::vector<float> token_weight;
+  std::vector<int> item_id;
+  for (const Item& item : batch.item()) {
+    if (item.field_size() != 0)
+      BOOST_THROW_EXCEPTION(InvalidOperation("FlatBatch::Save: obsolete item.field is not supported"));
+    if (item.token_id_size() != item.token_weight_size())
+      BOOST_THROW_EXCEPTION(InvalidOperation("FlatBatch::Save: item.token_id_size() != item.token_weight_size()"));
+    for (int token_id_value : item.token_id()) {
+      if (token_id_value < 0 || token_id_value >= batch.token_size())
+        BOOST_THROW_EXCEPTION(InvalidOperation("FlatBatch::Save: item.token_id is out of range"));
+    }
+
+    token_id.insert(token_id.end(), item.token_id().begin(), item.token_id().end());
+    token_weight.insert(token_weight.end(), item.token_weight().begin(), item.token_weight().end());
+    row_ptr.push_back(static_cast<int>(token_id.size()));
+    item_id.push_back(item.id());
+  }
+
+  std::ofstream fout(full_filename.c_str(), std::ofstream::binary);
+  if (!fout.is_open())
+    BOOST_THROW_EXCEPTION(DiskWriteException("Unable to create file " + full_filename));
+
+  BinaryFormat::WriteHeader(kFlatBatchMagic, kVersion, &fout);
+  BinaryFormat::WriteInt(batch.item_size(), &fout);
+  BinaryFormat::WriteInt(batch.token_size(), &fout);
+  BinaryFormat::WriteInt(batch.class_id_size(), &fout);
+  BinaryFormat::WriteInt(static_cast<int>(token_id.size()), &fout);
+  BinaryFormat::WriteArray(&row_ptr[0], static_cast<int>(row_ptr.size()), &fout);
+  BinaryFormat::WriteArray(token_id.data(), static_cast<int>(token_id.size()), &fout);
+  BinaryFormat::WriteArray(token_weight.data(), static_cast<int>(token_weight.size()), &fout);
+  BinaryFormat::WriteArray(item_id.data(), static_cast<int>(item_id.size()), &fout);
+
+  BinaryFormat::WriteString(batch.id(), &fout);
+  BinaryFormat::WriteString(batch.description(), &fout);
+  for (const std::string& token : batch.token())
+    BinaryFormat::WriteString(token, &fout);
+  for (const std::string& class_id : batch.class_id())
+    BinaryFormat::WriteString(class_id, &fout);
+  for (const Item& item : batch.item())
+    BinaryFormat::WriteString(item.title(), &fout);
+
+  fout.close();
+  if (!fout)
+    BOOST_THROW_EXCEPTION(DiskWriteException("Unable to write flat batch to " + full_filename));
+}
+
+FlatBatch::FlatBatch(const std::string& full_filename)
+    : file_(), num_items_(0), num_tokens_(0), num_class_ids_(0), nnz_(0),
+      row_ptr_(nullptr), token_id_(nullptr), token_weight_(nullptr), item_id_(nullptr),
+      strings_begin_(nullptr), strings_end_(nullptr), keyword_(), class_id_(), title_() {
+  try {
+    file_.open(full_filename);
+  } catch (std::exception&) {
+    BOOST_THROW_EXCEPTION(DiskReadException("Unable to open file " + full_filename));
+  }
+
+  const char* data = file_.data();
+  const int64_t size = static_cast<int64_t>(file_.size());
+  const std::string error = "Unable to read flat batch from " + full_filename;
+  BinaryFormat::CheckHeader(data, size, kFlatBatchMagic, kVersion, error);
+  if (size < kHeaderSize)
+    BOOST_THROW_EXCEPTION(DiskReadException(error + " (invalid header)"));
+
+  int header[4];
+  memcpy(header, data + BinaryFormat::kHeaderSize, sizeof(header));
+  num_items_ = header[0];
+  num_tokens_ = header[1];
+  num_class_ids_ = header[2];
+  nnz_ = header[3];
+  if (num_items_ < 0 || num_tokens_ < 0 || nnz_ < 0 || (num_class_ids_ != 0 && num_class_ids_ != num_tokens_))
+    BOOST_THROW_EXCEPTION(DiskReadException(error + " (invalid header)"));
+
+  const int64_t arrays_size = sizeof(int) * (static_cast<int64_t>(num_items_) * 2 + 1) +
+                              (sizeof(int) + sizeof(float)) * static_cast<int64_t>(nnz_);
+  if (size < kHeaderSize + arrays_size)
+    BOOST_THROW_EXCEPTION(DiskReadException(error + " (file is truncated)"));
+
+  // mapped memory is page-aligned, and all arrays are 4-byte aligned within the file
+  row_ptr_ = reinterpret_cast<const int*>(data + kHeaderSize);
+  token_id_ = row_ptr_ + num_items_ + 1;
+  token_weight_ = reinterpret_cast<const float*>(token_id_ + nnz_);
+  item_id_ = reinterpret_cast<const int*>(token_weight_ + nnz_);
+  strings_begin_ = reinterpret_cast<const char*>(item_id_ + num_items_);
+  strings_end_ = data + size;
+
+  if (row_ptr_[0] != 0 || row_ptr_[num_items_] != nnz_)
+    BOOST_THROW_EXCEPTION(DiskReadException(error + " (invalid row_ptr)"));
+  for (int item_index = 0; item_index < num_items_; ++item_index) {
+    if (row_ptr_[item_index] > row_ptr_[item_index + 1])
+      BOOST_THROW_EXCEPTION(DiskReadException(error + " (invalid row_ptr)"));
+  }
+
+  for (int i = 0; i < nnz_; ++i) {
+    if (token_id_[i] < 0 || token_id_[i] >= num_tokens_)
+      BOOST_THROW_EXCEPTION(DiskReadException(error + " (token_id is out of range)"));
+  }
+
+  const char* cursor = strings_begin_;
+  keyword_.reserve(num_tokens_);
+  class_id_.reserve(num_class_ids_);
+  title_.reserve(num_items_);
+  const int64_t num_strings = 2 + static_cast<int64_t>(num_tokens_) + num_class_ids_ + num_items_;
+  for (int64_t i = 0; i < num_strings; ++i) {
+    if (i >= 2 && i < 2 + num_tokens_)
+      keyword_.push_back(cursor);
+    else if (i >= 2 + num_tokens_ && i < 2 + num_tokens_ + num_class_ids_)
+      class_id_.push_back(cursor);
+    else if (i >= 2 + num_tokens_ + num_class_ids_)
+      title_.push_back(cursor);
+
+    if (!BinaryFormat::ReadString(&cursor, strings_end_, nullptr))
+      BOOST_THROW_EXCEPTION(DiskReadException(error + " (string table is truncated)"));
+  }
+}
+
+std::string FlatBatch::id() const {
+  std::string id;
+  const char* cursor = strings_begin_;
+  BinaryFormat::ReadString(&cursor, strings_end_, &id);
+  return id;
+}
+
+std::string FlatBatch::item_title(int item_index) const {
+  std::string title;
+  const char* cursor = title_[item_index];
+  BinaryFormat::ReadString(&cursor, strings_end_, &title);
+  return title;
+}
+
+Token FlatBatch::token(int token_index) const {
+  std::string keyword, class_id = DefaultClass;
+  const char* cursor = keyword_[token_index];
+  BinaryFormat::ReadString(&cursor, strings_end_, &keyword);
+  if (num_class_ids_ != 0) {
+    cursor = class_id_[token_index];
+    BinaryFormat::ReadString(&cursor, strings_end_, &class_id);
+  }
+
+  return Token(class_id, keyword);
+}
+
+void FlatBatch::ToBatch(Batch* batch) const {
+  batch->Clear();
+
+  const char* cursor = strings_begin_;
+  BinaryFormat::ReadString(&cursor, strings_end_, batch->mutable_id());
+  std::string description;
+  BinaryFormat::ReadString(&cursor, strings_end_, &description);
+  if (!description.empty())
+    batch->set_description(description);
+
+  batch->mutable_token()->Reserve(num_tokens_);
+  for (int token_index = 0; token_index < num_tokens_; ++token_index)
+    BinaryFormat::ReadString(&cursor, strings_end_, batch->add_token());
+
+  batch->mutable_class_id()->Reserve(num_class_ids_);
+  for (int token_index = 0; token_index < num_class_ids_; ++token_index)
+    BinaryFormat::ReadString(&cursor, strings_end_, batch->add_class_id());
+
+  batch->mutable_item()->Reserve(num_items_);
+  for (int item_index = 0; item_index < num_items_; ++item_index) {
+    Item* item = batch->add_item();
+    item->set_id(item_id_[item_index]);
+
+    std::string title;
+    BinaryFormat::ReadString(&cursor, strings_end_, &title);
+    if (!title.empty())
+      item->set_title(title);
+
+    // bulk copy instead of adding elements one by one
+    const int begin = row_ptr_[item_index];
+    const int size = row_ptr_[item_index + 1] - begin;
+    if (size == 0)
+      continue;
+
+    item->mutable_token_id()->Resize(size, 0);
+    memcpy(item->mutable_token_id()->mutable_data(), token_id_ + begin, sizeof(int) * size);
+    item->mutable_token_weight()->Resize(size, 0.0f);
+    memcpy(item->mutable_token_weight()->mutable_data(), token_weight_ + begin, sizeof(float) * size);
+  }
+}
+
+}  // namespace core
+}  // namespace artm
@@ -0,0 +1,83 @@
+// Copyright 2016, Additive Regularization of Topic Models.
+
+#ifndef SRC_ARTM_CORE_FLAT_BATCH_H_
+#define SRC_ARTM_CORE_FLAT_BATCH_H_
+
+#include <string>
+#include <vector>
+
+#include "boost/iostreams/device/mapped_file.hpp"
+#include "boost/utility.hpp"
+
+#include "artm/core/common.h"
+#include "artm/core/token.h"
+
+namespace artm {
+namespace core {
+
+// FlatBatch is a batch stored in flat binary format and memory-mapped from disk.
+// Unlike protobuf batches, the token_id / token_weight arrays of all items are stored as raw CSR arrays,
+// so they can be used without parsing. Flat batches keep the usual .batch extension;
+// the format is detected by the magic bytes at the beginning of the file.
+//
+// Layout (version 1, all integers are int32 in the native byte order of the machine that saved the batch):
+//   char magic[8] = "ARTMFLAT"; byte_order_mark = 0x01020304; version; num_items; num_tokens;
+//   num_class_ids (0 or num_tokens); nnz;
+//   row_ptr[num_items + 1]; token_id[nnz]; float token_weight[nnz]; item_id[num_items];
+//   string table: batch id, batch description, num_tokens tokens, num_class_ids class ids, num_items item titles;
+//   each string is stored as its length followed by the characters.
+class FlatBatch : boost::noncopyable {
+ public:
+  static const int kVersion = 1;
+
+  // Returns true if the file starts with the magic bytes of flat batch format.
+  static bool IsFlatBatch(const std::string& full_filename);
+
+  // Saves batch in flat format. Throws DiskWriteException on failure, and InvalidOperation for batches
+  // that can not be stored in flat format (e.g. batches without tokens, whose token ids refer to p_wt).
+  static void Save(const Batch& batch, const std::string& full_filename);
+
+  // Maps the file into memory and validates its structure. Throws DiskReadException on failure,
+  // including the files saved on a machine with different byte order.
+  explicit FlatBatch(const std::string& full_filename);
+
+  int num_items() const { return num_items_; }
+  int num_tokens() const { return num_tokens_; }
+  int nnz() const { return nnz_; }
+
+  const int* row_ptr() const { return row_ptr_; }
+  const int* token_id() const { return token_id_; }
+  const float* token_weight() const { return token_weight_; }
+  const int* item_id() const { return item_id_; }
+
+  // Decodes strings from the string table.
+  std::string id() const;
+  std::string item_title(int item_index) const;
+
+  // Decodes the token from the string table; tokens of batches saved without class ids belong to DefaultClass.
+  Token token(int token_index) const;
+
+  // Decodes the whole content into protobuf batch.
+  void ToBatch(Batch* batch) const;
+
+ private:
+  boost::iostreams::mapped_file_source file_;
+  int num_items_;
+  int num_tokens_;
+  int num_class_ids_;
+  int nnz_;
+  const int* row_ptr_;
+  const int* token_id_;
+  const float* token_weight_;
+  const int* item_id_;
+  const char* strings_begin_;
+  const char* strings_end_;
+  std::vector<const char*> keyword_;   // positions of keywords in the string table
+  std::vector<const char*> class_id_;  // positions of class ids in the string table
+  std::vector<const char*> title_;     // positions of item titles in the string table
+};
+
+}  // namespace core
+}  // namespace artm
+
+#endif  // SRC_ARTM_CORE_FLAT_BATCH_H_
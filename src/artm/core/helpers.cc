@@ -17,6 +17,7 @@
 #include "artm/core/common.h"
 #include "artm/core/helpers.h"
 #include "artm/core/exceptions.h"
+#include "artm/core/flat_batch.h"
 #include "artm/core/protobuf_helpers.h"
 #include "artm/core/token.h"
 
@@ -203,6 +204,15 @@ void Helpers::CreateFolderIfNotExists(const std::string& disk_path) {
   }
 }
 
+void Helpers::LoadBatch(const std::string& full_filename, Batch* batch) {
+  if (FlatBatch::IsFlatBatch(full_filename)) {
+    FlatBatch(full_filename).ToBatch(batch);
+    return;
+  }
+
+  LoadMessage(full_filename, batch);
+}
+
 void Helpers::SaveMessage(const std::string& filename, const std::string& disk_path,
                           const ::google::protobuf::Message& message) {
   CreateFolderIfNotExists(disk_path);
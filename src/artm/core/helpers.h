@@ -50,6 +50,9 @@ class Helpers {
   static void LoadMessage(const std::string& filename, const std::string& disk_path,
                           ::google::protobuf::Message* message);
 
+  // Loads batch from disk, either in protobuf or in flat binary format (see FlatBatch).
+  static void LoadBatch(const std::string& full_filename, Batch* batch);
+
   static void CreateFolderIfNotExists(const std::string& disk_path);
 
   // Saves protobuf message to disk.
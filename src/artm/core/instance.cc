@@ -10,13 +10,16 @@
 #include "boost/bind.hpp"
 #include "boost/filesystem.hpp"
 
+#include "artm/core/batch_loader.h"
 #include "artm/core/common.h"
 #include "artm/core/helpers.h"
 #include "artm/core/cache_manager.h"
 #include "artm/core/score_manager.h"
 #include "artm/core/dictionary.h"
 #include "artm/core/exceptions.h"
+#include "artm/core/phi_matrix_pool.h"
 #include "artm/core/processor.h"
+#include "artm/core/thread_pool.h"
 
 #include "artm/regularizer_interface.h"
 #include "artm/regularizer/decorrelator_phi.h"
@@ -73,6 +76,7 @@ Instance::Instance(const MasterModelConfig& config)
       processor_queue_(),
       cache_manager_(),
       score_manager_(),
+      thread_pool_(nullptr),
       processors_() {
   Reconfigure(config);
 }
@@ -87,6 +91,7 @@ Instance::Instance(const Instance& rhs)
       processor_queue_(),
       cache_manager_(),
       score_manager_(),
+      thread_pool_(nullptr),
       processors_() {
   Reconfigure(*rhs.config());
 
@@ -172,6 +177,9 @@ void Instance::RequestMasterComponentInfo(MasterComponentInfo* master_info) cons
     }
   }
 
+  if (phi_matrix_pool_ != nullptr)
+    master_info->set_phi_matrix_pool_byte_size(phi_matrix_pool_->ByteSize());
+
   master_info->set_processor_queue_size(static_cast<int>(processor_queue_.size()));
   master_info->set_num_processors(static_cast<int>(processors_.size()));
 }
@@ -188,10 +196,21 @@ ScoreTracker* Instance::score_tracker() {
   return score_tracker_.get();
 }
 
+BatchLoader* Instance::batch_loader() {
+  return batch_loader_.get();
+}
+
 void Instance::DisposeModel(ModelName model_name) {
   models_.erase(model_name);
 }
 
+void Instance::RecycleModel(ModelName model_name) {
+  std::shared_ptr<PhiMatrix> phi_matrix = models_.get(model_name);
+  models_.erase(model_name);
+  if (phi_matrix_pool_ != nullptr)
+    phi_matrix_pool_->Release(std::move(phi_matrix));
+}
+
 void Instance::CreateOrReconfigureRegularizer(const RegularizerConfig& config) {
   std::string regularizer_name = config.name();
   artm::RegularizerType regularizer_type = config.type();
@@ -390,10 +409,23 @@ void Instance::Reconfigure(const MasterModelConfig& master_config) {
     cache_manager_.reset(new CacheManager(master_config.disk_cache_path()));
     score_manager_.reset(new ScoreManager(this));
     score_tracker_.reset(new ScoreTracker());
+    token_index_cache_.reset(new TokenIndexCache(master_config.token_index_cache_byte_size()));
+    phi_matrix_pool_.reset(new PhiMatrixPool());
+    batch_loader_.reset(new BatchLoader(this));
 
     is_configured_  = true;
   }
 
+  batch_loader_->set_max_prefetched(master_config.num_prefetched_batches());
+  cache_manager_->set_use_float16(master_config.theta_cache_float16());
+  cache_manager_->set_memory_limit(master_config.theta_cache_memory_limit());
+  phi_matrix_pool_->set_max_size(master_config.phi_matrix_pool_size());
+  token_index_cache_->set_max_byte_size(master_config.token_index_cache_byte_size());
+
+  std::shared_ptr<ThreadPool> thread_pool = thread_pool_.get();
+  if (thread_pool == nullptr || thread_pool->num_threads() != target_processors_count)
+    thread_pool_.set(std::make_shared<ThreadPool>(target_processors_count));
+
   {
     // Adjust size of processors_; cast size to int to avoid compiler warning.
     while (static_cast<int>(processors_.size()) > target_processors_count) {
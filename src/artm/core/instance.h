@@ -21,10 +21,14 @@
 namespace artm {
 namespace core {
 
+class BatchLoader;
+class PhiMatrixPool;
+class TokenIndexCache;
 class CacheManager;
 class ScoreManager;
 class ScoreTracker;
 class Processor;
+class ThreadPool;
 class Merger;
 class Dictionary;
 typedef ThreadSafeCollectionHolder<std::string, Dictionary> ThreadSafeDictionaryCollection;
@@ -56,6 +60,10 @@ class Instance {
   CacheManager* cache_manager();
   ScoreManager* score_manager();
   ScoreTracker* score_tracker();
+  BatchLoader* batch_loader();
+  TokenIndexCache* token_index_cache() { return token_index_cache_.get(); }
+  PhiMatrixPool* phi_matrix_pool() { return phi_matrix_pool_.get(); }
+  std::shared_ptr<ThreadPool> thread_pool() const { return thread_pool_.get(); }
 
   size_t processor_size() { return processors_.size(); }
   Processor* processor(int processor_index) { return processors_[processor_index].get(); }
@@ -63,6 +71,10 @@ class Instance {
   void Reconfigure(const MasterModelConfig& master_config);
   void DisposeModel(ModelName model_name);
 
+  // Disposes a temporary model, created and exclusively used by the caller,
+  // and gives its matrix to phi_matrix_pool() for reuse.
+  void RecycleModel(ModelName model_name);
+
   void CreateOrReconfigureRegularizer(const RegularizerConfig& config);
   void DisposeRegularizer(const std::string& name);
 
@@ -96,6 +108,18 @@ class Instance {
   std::shared_ptr<ScoreManager> score_manager_;
   std::shared_ptr<ScoreTracker> score_tracker_;
 
+  // Depends on [none]
+  std::shared_ptr<TokenIndexCache> token_index_cache_;
+
+  // Depends on [none]
+  std::shared_ptr<PhiMatrixPool> phi_matrix_pool_;
+
+  // Depends on [none]; replaced when the number of processors changes (callers keep the old pool until they finish)
+  ThreadSafeHolder<ThreadPool> thread_pool_;
+
+  // Depends on batches_, models_ and token_index_cache_; must outlive processors_, which take batches prepared by the loader
+  std::shared_ptr<BatchLoader> batch_loader_;
+
   // Depends on schema_, processor_queue_, and merger_
   std::vector<std::shared_ptr<Processor> > processors_;
 
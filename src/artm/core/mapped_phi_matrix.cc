@@ -0,0 +1,194 @@
+// Copyright 2016, Additive Regularization of Topic Models.
+
+#include "artm/core/mapped_phi_matrix.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>  // NOLINT
+
+#include "artm/core/binary_format.h"
+#include "artm/core/exceptions.h"
+
+namespace artm {
+namespace core {
+
+namespace {
+
+const char kMappedPhiMatrixMagic[BinaryFormat::kMagicSize] = { 'A', 'R', 'T', 'M', 'P', 'H', 'I', 'M' };
+const int kHeaderSize = BinaryFormat::kHeaderSize + 2 * sizeof(int) + sizeof(int64_t);
+
+// The part of the header that follows the magic, the byte order mark and the version
+struct Header {
+  int topic_size;
+  int token_size;
+  int64_t strings_offset;
+};
+
+Header ReadHeader(const char* data) {
+  Header header;
+  const char* cursor = data + BinaryFormat::kHeaderSize;
+  memcpy(&header.topic_size, cursor, sizeof(int));
+  memcpy(&header.token_size, cursor + sizeof(int), sizeof(int));
+  memcpy(&header.strings_offset, cursor + 2 * sizeof(int), sizeof(int64_t));
+  return header;
+}
+
+}  // namespace
+
+bool MappedPhiMatrix::IsMappedPhiMatrix(const std::string& file_name) {
+  return BinaryFormat::HasMagic(file_name, kMappedPhiMatrixMagic);
+}
+
+void MappedPhiMatrix::Save(const PhiMatrix& phi_matrix, const std::string& file_name) {
+  const int topic_size = phi_matrix.topic_size();
+  const int token_size = phi_matrix.token_size();
+
+  std::ofstream fout(file_name.c_str(), std::ofstream::binary);
+  if (!fout.is_open())
+    BOOST_THROW_EXCEPTION(DiskWriteException("Unable to create file " + file_name));
+
+  const int64_t strings_offset = kValuesOffset + sizeof(float) * static_cast<int64_t>(topic_size) * token_size;
+  BinaryFormat::WriteHeader(kMappedPhiMatrixMagic, kVersion, &fout);
+  BinaryFormat::WriteInt(topic_size, &fout);
+  BinaryFormat::WriteInt(token_size, &fout);
+  fout.write(reinterpret_cast<const char*>(&strings_offset), sizeof(int64_t));
+  const std::vector<char> padding(kValuesOffset - kHeaderSize, 0);
+  fout.write(&padding[0], padding.size());
+
+  std::vector<float> buffer;
+  for (int token_id = 0; token_id < token_size; ++token_id) {
+    const float* values = phi_matrix.get_row(token_id, &buffer);
+    fout.write(reinterpret_cast<const char*>(values), sizeof(float) * topic_size);
+  }
+
+  for (int topic_id = 0; topic_id < topic_size; ++topic_id)
+    BinaryFormat::WriteString(phi_matrix.topic_name(topic_id), &fout);
+  for (int token_id = 0; token_id < token_size; ++token_id)
+    BinaryFormat::WriteString(phi_matrix.token(token_id).keyword, &fout);
+  for (int token_id = 0; token_id < token_size; ++token_id)
+    BinaryFormat::WriteString(phi_matrix.token(token_id).class_id, &fout);
+
+  fout.close();
+  if (!fout)
+    BOOST_THROW_EXCEPTION(DiskWriteException("Unable to write phi matrix to " + file_name));
+}
+
+std::shared_ptr<MappedPhiMatrix::MappedFile> MappedPhiMatrix::Open(const std::string& file_name) {
+  auto file = std::make_shared<MappedFile>();
+  try {
+    file->open(file_name);
+  } catch (std::exception&) {
+    BOOST_THROW_EXCEPTION(DiskReadException("Unable to open file " + file_name));
+  }
+
+  const char* data = file->data();
+  const int64_t size = static_cast<int64_t>(file->size());
+  const std::string error = "Unable to read phi matrix from " + file_name;
+  BinaryFormat::CheckHeader(data, size, kMappedPhiMatrixMagic, kVersion, error);
+  if (size < kValuesOffset)
+    BOOST_THROW_EXCEPTION(DiskReadException(error + " (invalid header)"));
+
+  Header header = ReadHeader(data);
+
+  const int64_t strings_offset =
+    kValuesOffset + sizeof(float) * static_cast<int64_t>(header.topic_size) * header.token_size;
+  if (header.topic_size <= 0 || header.token_size < 0 || header.strings_offset != strings_offset)
+    BOOST_THROW_EXCEPTION(DiskReadException(error + " (invalid header)"));
+
+  if (size < header.strings_offset)
+    BOOST_THROW_EXCEPTION(DiskReadException(error + " (file is truncated)"));
+
+  return file;
+}
+
+google::protobuf::RepeatedPtrField<std::string> MappedPhiMatrix::ReadTopicNames(const MappedFile& file) {
+  Header header = ReadHeader(file.data());
+  google::protobuf::RepeatedPtrField<std::string> topic_name;
+  const char* cursor = file.data() + header.strings_offset;
+  const char* end = file.data() + file.size();
+  for (int topic_id = 0; topic_id < header.topic_size; ++topic_id) {
+    if (!BinaryFormat::ReadString(&cursor, end, topic_name.Add()))
+      BOOST_THROW_EXCEPTION(DiskReadException("Unable to read phi matrix (string table is truncated)"));
+  }
+
+  return topic_name;
+}
+
+MappedPhiMatrix::MappedPhiMatrix(const ModelName& model_name, const std::string& file_name)
+    : MappedPhiMatrix(model_name, file_name, Open(file_name)) {}
+
+MappedPhiMatrix::MappedPhiMatrix(const ModelName& model_name, const std::string& file_name,
+                                 std::shared_ptr<MappedFile> file)
+    : PhiMatrixFrame(model_name, ReadTopicNames(*file)), file_(file), values_(nullptr) {
+  Header header = ReadHeader(file_->data());
+  const char* end = file_->data() + file_->size();
+  const char* cursor = file_->data() + header.strings_offset;
+  for (int topic_id = 0; topic_id < header.topic_size; ++topic_id)
+    BinaryFormat::ReadString(&cursor, end, nullptr);  // already validated by ReadTopicNames()
+
+  // Keywords and class ids are stored in two separate blocks of the string table
+  const char* class_id_cursor = cursor;
+  for (int token_id = 0; token_id < header.token_size; ++token_id) {
+    if (!BinaryFormat::ReadString(&class_id_cursor, end, nullptr))
+      BOOST_THROW_EXCEPTION(DiskReadException("Unable to read phi matrix from " + file_name +
+                                              " (string table is truncated)"));
+  }
+
+  std::string keyword, class_id;
+  for (int token_id = 0; token_id < header.token_size; ++token_id) {
+    if (!BinaryFormat::ReadString(&cursor, end, &keyword) ||
+        !BinaryFormat::ReadString(&class_id_cursor, end, &class_id))
+      BOOST_THROW_EXCEPTION(DiskReadException("Unable to read phi matrix from " + file_name +
+                                              " (string table is truncated)"));
+    if (PhiMatrixFrame::AddToken(Token(class_id, keyword)) != token_id)
+      BOOST_THROW_EXCEPTION(DiskReadException("Unable to read phi matrix from " + file_name +
+                                              " (duplicate token " + keyword + ")"));
+  }
+
+  // mapped memory is page-aligned, and values start at a multiple of the cache line
+  values_ = reinterpret_cast<const float*>(file_->data() + kValuesOffset);
+}
+
+std::shared_ptr<PhiMatrix> MappedPhiMatrix::Duplicate() const {
+  auto duplicate = std::make_shared<DensePhiMatrix>(model_name(), topic_name());
+  duplicate->Reshape(*this);
+  for (int token_id = 0; token_id < token_size(); ++token_id)
+    duplicate->set_row(token_id, row(token_id));
+  return duplicate;
+}
+
+void MappedPhiMatrix::get(int token_id, std::vector<float>* buffer) const {
+  assert(buffer->size() == topic_size());
+  const float* values = row(token_id);
+  std::copy(values, values + topic_size(), buffer->begin());
+}
+
+void MappedPhiMatrix::set(int token_id, int topic_id, float value) {
+  BOOST_THROW_EXCEPTION(InvalidOperation("Model " + model_name() + " is memory-mapped and can not be modified"));
+}
+
+void MappedPhiMatrix::increase(int token_id, int topic_id, float increment) {
+  BOOST_THROW_EXCEPTION(InvalidOperation("Model " + model_name() + " is memory-mapped and can not be modified"));
+}
+
+void MappedPhiMatrix::increase(int token_id, const std::vector<float>& increment) {
+  BOOST_THROW_EXCEPTION(InvalidOperation("Model " + model_name() + " is memory-mapped and can not be modified"));
+}
+
+void MappedPhiMatrix::Clear() {
+  values_ = nullptr;
+  file_.reset();
+  PhiMatrixFrame::Clear();
+}
+
+int MappedPhiMatrix::AddToken(const Token& token) {
+  BOOST_THROW_EXCEPTION(InvalidOperation("Tokens addition is not allowed for memory-mapped model."));
+}
+
+void MappedPhiMatrix::ResetRows(int token_size) {
+  BOOST_THROW_EXCEPTION(InvalidOperation("Reshape is not allowed for memory-mapped model."));
+}
+
+}  // namespace core
+}  // namespace artm
@@ -0,0 +1,82 @@
+// Copyright 2016, Additive Regularization of Topic Models.
+
+#ifndef SRC_ARTM_CORE_MAPPED_PHI_MATRIX_H_
+#define SRC_ARTM_CORE_MAPPED_PHI_MATRIX_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "boost/iostreams/device/mapped_file.hpp"
+#include "boost/utility.hpp"
+
+#include "artm/core/common.h"
+#include "artm/core/dense_phi_matrix.h"
+
+namespace artm {
+namespace core {
+
+// MappedPhiMatrix is a read-only phi matrix, memory-mapped from a file in raw row-major layout.
+// Values are never loaded into the heap: the OS page cache decides which rows stay resident,
+// so the matrix may be larger than RAM, and several processes mapping the same file share its pages.
+// Only the set of tokens is kept in memory. Duplicate() returns a writable DensePhiMatrix with a copy of values.
+//
+// Layout (version 1, all numbers in the native byte order of the machine that saved the model):
+//   char magic[8] = "ARTMPHIM"; int32 byte_order_mark = 0x01020304; int32 version; int32 topic_size; int32 token_size;
+//   int64 offset of the string table; zero padding up to kValuesOffset bytes;
+//   float values[token_size][topic_size];
+//   string table: topic_size topic names, token_size keywords, token_size class ids;
+//   each string is stored as int32 length followed by the characters.
+class MappedPhiMatrix : boost::noncopyable, public PhiMatrixFrame {
+ public:
+  static const int kVersion = 1;
+  static const int kValuesOffset = 64;  // in bytes; keeps rows of the mapping aligned to the cache line
+
+  // Returns true if the file starts with the magic bytes of mapped phi matrix format.
+  static bool IsMappedPhiMatrix(const std::string& file_name);
+
+  // Saves values of phi_matrix row by row, so the whole matrix is never copied in memory.
+  // Throws DiskWriteException on failure.
+  static void Save(const PhiMatrix& phi_matrix, const std::string& file_name);
+
+  // Maps the file into memory and reads its tokens. Throws DiskReadException on failure,
+  // including the files saved on a machine with different byte order.
+  MappedPhiMatrix(const ModelName& model_name, const std::string& file_name);
+
+  virtual ~MappedPhiMatrix() { }
+  virtual int64_t ByteSize() const { return PhiMatrixFrame::ByteSize(); }  // mapped values are not counted
+
+  virtual std::shared_ptr<PhiMatrix> Duplicate() const;
+
+  virtual float get(int token_id, int topic_id) const { return row(token_id)[topic_id]; }
+  virtual void get(int token_id, std::vector<float>* buffer) const;
+  virtual const float* get_row(int token_id, std::vector<float>* buffer) const { return row(token_id); }
+  virtual void set(int token_id, int topic_id, float value);
+  virtual void increase(int token_id, int topic_id, float increment);
+  virtual void increase(int token_id, const std::vector<float>& increment);
+
+  virtual void Clear();
+  virtual int AddToken(const Token& token);
+
+  const float* row(int token_id) const { return values_ + static_cast<int64_t>(token_id) * topic_size(); }
+
+ protected:
+  virtual void ResetRows(int token_size);
+
+ private:
+  typedef boost::iostreams::mapped_file_source MappedFile;
+
+  MappedPhiMatrix(const ModelName& model_name, const std::string& file_name, std::shared_ptr<MappedFile> file);
+
+  // Opens the mapping and validates the header; the string table is validated by the constructor
+  static std::shared_ptr<MappedFile> Open(const std::string& file_name);
+  static google::protobuf::RepeatedPtrField<std::string> ReadTopicNames(const MappedFile& file);
+
+  std::shared_ptr<MappedFile> file_;
+  const float* values_;
+};
+
+}  // namespace core
+}  // namespace artm
+
+#endif  // SRC_ARTM_CORE_MAPPED_PHI_MATRIX_H_
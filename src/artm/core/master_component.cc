@@ -3,7 +3,9 @@
 #include "artm/core/master_component.h"
 
 #include <algorithm>
+#include <cmath>
 #include <fstream>  // NOLINT
+#include <map>
 #include <vector>
 #include <set>
 #include <sstream>
@@ -23,16 +25,22 @@
 #include "artm/core/dictionary_operations.h"
 #include "artm/core/exceptions.h"
 #include "artm/core/helpers.h"
+#include "artm/core/batch_loader.h"
 #include "artm/core/batch_manager.h"
 #include "artm/core/cache_manager.h"
+#include "artm/core/call_on_destruction.h"
 #include "artm/core/check_messages.h"
 #include "artm/core/instance.h"
+#include "artm/core/mapped_phi_matrix.h"
+#include "artm/core/nwt_accumulator.h"
 #include "artm/core/processor.h"
 #include "artm/core/protobuf_helpers.h"
 #include "artm/core/phi_matrix_operations.h"
+#include "artm/core/phi_matrix_pool.h"
 #include "artm/core/score_manager.h"
 #include "artm/core/dense_phi_matrix.h"
 #include "artm/core/template_manager.h"
+#include "artm/core/thread_pool.h"
 
 namespace artm {
 namespace core {
@@ -301,11 +309,13 @@ void MasterComponent::ImportBatches(const ImportBatchesArgs& args) {
     std::shared_ptr<Batch> batch = std::make_shared<Batch>(args.batch(i));
     FixAndValidateMessage(batch.get(), /* throw_error =*/ true);
     instance_->batches()->set(batch->id(), batch);
+    instance_->token_index_cache()->erase(batch->id());
   }
 }
 
 void MasterComponent::DisposeBatch(const std::string& name) {
   instance_->batches()->erase(name);
+  instance_->token_index_cache()->erase(name);
 }
 
 void MasterComponent::ExportModel(const ExportModelArgs& args) {
@@ -316,10 +326,6 @@ void MasterComponent::ExportModel(const ExportModelArgs& args) {
   if (boost::filesystem::exists(args.file_name()))
     BOOST_THROW_EXCEPTION(DiskWriteException("File already exists: " + args.file_name()));
 
-  std::ofstream fout(args.file_name(), std::ofstream::binary);
-  if (!fout.is_open())
-    BOOST_THROW_EXCEPTION(DiskWriteException("Unable to create file " + args.file_name()));
-
   std::shared_ptr<const PhiMatrix> phi_matrix = instance_->GetPhiMatrixSafe(args.model_name());
   const PhiMatrix& n_wt = *phi_matrix;
 
@@ -329,6 +335,17 @@ void MasterComponent::ExportModel(const ExportModelArgs& args) {
   if (token_size == 0)
     BOOST_THROW_EXCEPTION(InvalidOperation("Model " + args.model_name() + " has no tokens, export failed"));
 
+  if (args.file_format() == ModelFileFormat_Mapped) {
+    MappedPhiMatrix::Save(n_wt, args.file_name());
+    LOG(INFO) << "Export completed, token_size = " << n_wt.token_size()
+              << ", topic_size = " << n_wt.topic_size();
+    return;
+  }
+
+  std::ofstream fout(args.file_name(), std::ofstream::binary);
+  if (!fout.is_open())
+    BOOST_THROW_EXCEPTION(DiskWriteException("Unable to create file " + args.file_name()));
+
   int tokens_per_chunk = std::min<int>(token_size, 100 * 1024 * 1024 / n_wt.topic_size());
 
   ::artm::GetTopicModelArgs get_topic_model_args;
@@ -365,6 +382,27 @@ void MasterComponent::ImportModel(const ImportModelArgs& args) {
   if (config != nullptr)
     if (!args.has_model_name()) const_cast<ImportModelArgs*>(&args)->set_model_name(config->pwt_name());
 
+  if (MappedPhiMatrix::IsMappedPhiMatrix(args.file_name())) {
+    // Mapped files are used in place, unless the caller explicitly asks for a particular storage
+    LOG(INFO) << "Mapping model " << args.model_name() << " from " << args.file_name();
+    auto mapped = std::make_shared<MappedPhiMatrix>(args.model_name(), args.file_name());
+    std::shared_ptr<PhiMatrix> target = mapped;
+    if (args.has_phi_matrix_storage()) {
+      auto copy = CreatePhiMatrix(args.phi_matrix_storage(), args.model_name(), mapped->topic_name());
+      copy->Reshape(*mapped);
+      for (int token_id = 0; token_id < mapped->token_size(); ++token_id) {
+        const float* row = mapped->row(token_id);
+        copy->increase(token_id, std::vector<float>(row, row + mapped->topic_size()));
+      }
+      target = copy;
+    }
+
+    instance_->SetPhiMatrix(args.model_name(), target);
+    LOG(INFO) << "Import completed, token_size = " << target->token_size()
+      << ", topic_size = " << target->topic_size();
+    return;
+  }
+
   std::ifstream fin(args.file_name(), std::ifstream::binary);
   if (!fin.is_open())
     BOOST_THROW_EXCEPTION(DiskReadException("Unable to open file " + args.file_name()));
@@ -379,7 +417,11 @@ void MasterComponent::ImportModel(const ImportModelArgs& args) {
     BOOST_THROW_EXCEPTION(DiskReadException(ss.str()));
   }
 
-  std::shared_ptr<DensePhiMatrix> target;
+  PhiMatrixStorage storage = args.phi_matrix_storage();
+  if (!args.has_phi_matrix_storage() && config != nullptr)
+    storage = config->phi_matrix_storage();
+
+  std::shared_ptr<PhiMatrixFrame> target;
   while (!fin.eof()) {
     int length;
     fin >> length;
@@ -398,7 +440,7 @@ void MasterComponent::ImportModel(const ImportModelArgs& args) {
     topic_model.set_name(args.model_name());
 
     if (target == nullptr)
-      target = std::make_shared<DensePhiMatrix>(args.model_name(), topic_model.topic_name());
+      target = CreatePhiMatrix(storage, args.model_name(), topic_model.topic_name());
 
     PhiMatrixOperations::ApplyTopicModelOperation(topic_model, 1.0f, /* add_missing_tokens = */ true, target.get());
   }
@@ -476,7 +518,7 @@ void MasterComponent::InitializeModel(const InitializeModelArgs& args) {
     }
 
     new_ttm = ttm->Duplicate();
-    PhiMatrixOperations::AssignValue(0.0f, new_ttm.get());
+    PhiMatrixOperations::AssignValue(0.0f, new_ttm.get(), instance_->thread_pool().get());
   }
 
   if (new_ttm->token_size() == 0) {
@@ -493,7 +535,7 @@ void MasterComponent::InitializeModel(const InitializeModelArgs& args) {
     new_ttm->increase(token_index, vec);
   }
 
-  PhiMatrixOperations::FindPwt(*new_ttm, new_ttm.get());
+  PhiMatrixOperations::FindPwt(*new_ttm, new_ttm.get(), instance_->thread_pool().get());
   instance_->SetPhiMatrix(args.model_name(), new_ttm);
 
   LOG(INFO) << "InitializeModel() created matrix " << new_ttm->model_name()
@@ -597,14 +639,32 @@ void MasterComponent::RequestProcessBatchesImpl(const ProcessBatchesArgs& proces
   std::shared_ptr<const PhiMatrix> phi_matrix = instance_->GetPhiMatrixSafe(model_name);
   const PhiMatrix& p_wt = *phi_matrix;
   const_cast<ProcessBatchesArgs*>(&args)->mutable_topic_name()->CopyFrom(p_wt.topic_name());
+  std::shared_ptr<NwtAccumulator> nwt_accumulator;
   if (args.has_nwt_target_name()) {
     if (args.nwt_target_name() == args.pwt_source_name())
       BOOST_THROW_EXCEPTION(InvalidOperation(
         "ProcessBatchesArgs.pwt_source_name == ProcessBatchesArgs.nwt_target_name"));
 
-    auto nwt_target(std::make_shared<DensePhiMatrix>(args.nwt_target_name(), p_wt.topic_name()));
-    nwt_target->Reshape(p_wt);
+    std::shared_ptr<PhiMatrix> nwt_target;
+    if (args.sparse_nwt_target()) {
+      nwt_target = std::make_shared<SparsePhiMatrix>(args.nwt_target_name(), p_wt);
+    } else {
+      // With per-task-group accumulation only the reduction step writes into the target.
+      // Atomic updates need rows that are never repacked, which only contiguous storage guarantees.
+      const bool single_writer = (args.nwt_accumulation_mode() == NwtAccumulationMode_PerTaskGroup);
+      PhiMatrixLocking locking = single_writer ? PhiMatrixLocking_None : args.phi_matrix_locking();
+      PhiMatrixStorage storage = (locking == PhiMatrixLocking_Atomic) ? PhiMatrixStorage_Contiguous
+                                                                      : PhiMatrixStorage_Packed;
+      std::shared_ptr<PhiMatrixFrame> dense_nwt_target = instance_->phi_matrix_pool()->Create(
+        storage, args.nwt_target_name(), p_wt.topic_name(), p_wt);
+      dense_nwt_target->set_locking(locking);
+      nwt_target = dense_nwt_target;
+    }
     instance_->SetPhiMatrix(args.nwt_target_name(), nwt_target);
+
+    const int num_tasks = args.batch_filename_size() + args.batch_size();
+    if (args.nwt_accumulation_mode() == NwtAccumulationMode_PerTaskGroup && num_tasks > 0)
+      nwt_accumulator = std::make_shared<NwtAccumulator>(nwt_target, num_tasks, args.deterministic_nwt_reduction());
   }
 
   if (async && args.theta_matrix_type() != ThetaMatrixType_None)
@@ -636,13 +696,15 @@ void MasterComponent::RequestProcessBatchesImpl(const ProcessBatchesArgs& proces
       return_ptdw = true;
   }
 
-  if (args.batch_filename_size() < instance_->processor_size()) {
+  // With document_chunk_size > 0 idle processors help with large batches (see DocumentChunkTask)
+  if (args.batch_filename_size() < instance_->processor_size() && args.document_chunk_size() <= 0) {
     LOG_FIRST_N(INFO, 1) << "Batches count (=" << args.batch_filename_size()
                          << ") is smaller than num processors (="
                          << instance_->processor_size()
                          << "), which may cause suboptimal performance.";
   }
 
+  int task_index = 0;
   auto createProcessorInput = [&](){  // NOLINT
     boost::uuids::uuid task_id = boost::uuids::random_generator()();
     batch_manager->Add(task_id);
@@ -655,6 +717,8 @@ void MasterComponent::RequestProcessBatchesImpl(const ProcessBatchesArgs& proces
     pi->set_model_name(model_name);
     pi->mutable_args()->CopyFrom(args);
     pi->set_task_id(task_id);
+    pi->set_task_index(task_index++);
+    pi->set_nwt_accumulator(nwt_accumulator);
 
     if (args.reuse_theta())
       pi->set_reuse_theta_cache_manager(instance_->cache_manager());
@@ -670,6 +734,7 @@ void MasterComponent::RequestProcessBatchesImpl(const ProcessBatchesArgs& proces
     auto pi = createProcessorInput();
     pi->set_batch_filename(args.batch_filename(batch_index));
     pi->set_batch_weight(args.batch_weight(batch_index));
+    instance_->batch_loader()->Schedule(pi);
     instance_->processor_queue()->push(pi);
   }
 
@@ -678,15 +743,14 @@ void MasterComponent::RequestProcessBatchesImpl(const ProcessBatchesArgs& proces
     auto pi = createProcessorInput();
     pi->mutable_batch()->CopyFrom(args.batch(batch_index));
     pi->set_batch_weight(args.batch_weight(batch_index));
+    instance_->batch_loader()->Schedule(pi);
     instance_->processor_queue()->push(pi);
   }
 
   if (async)
     return;
 
-  while (!batch_manager->IsEverythingProcessed()) {
-    boost::this_thread::sleep(boost::posix_time::milliseconds(kIdleLoopFrequency));
-  }
+  batch_manager->WaitUntilEverythingProcessed();
 
   GetThetaMatrixArgs get_theta_matrix_args;
   switch (args.theta_matrix_type()) {
@@ -761,10 +825,14 @@ void MasterComponent::MergeModel(const MergeModelArgs& merge_model_args) {
     const PhiMatrix& n_wt = *phi_matrix;
 
     if (n_wt.token_size() > 0) {
-      ::artm::TopicModel topic_model;
-      PhiMatrixOperations::RetrieveExternalTopicModel(n_wt, GetTopicModelArgs(), &topic_model);
+      // Take the token set of the first source as is, so that further sources with the same tokens
+      // are merged in place without token lookups
+      if (nwt_target->token_size() == 0 && dictionary == nullptr)
+        nwt_target->Reshape(n_wt);
+
       const bool add_missing_tokens = (dictionary == nullptr);
-      PhiMatrixOperations::ApplyTopicModelOperation(topic_model, weight, add_missing_tokens, nwt_target.get());
+      PhiMatrixOperations::ApplyPhiMatrix(n_wt, weight, add_missing_tokens, nwt_target.get(),
+                                          instance_->thread_pool().get());
     }
   }
 
@@ -795,8 +863,8 @@ void MasterComponent::RegularizeModel(const RegularizeModelArgs& regularize_mode
   std::shared_ptr<const PhiMatrix> pwt_phi_matrix = instance_->GetPhiMatrixSafe(pwt_source_name);
   const PhiMatrix& p_wt = *pwt_phi_matrix;
 
-  auto rwt_target(std::make_shared<DensePhiMatrix>(rwt_target_name, nwt_phi_matrix->topic_name()));
-  rwt_target->Reshape(*nwt_phi_matrix);
+  std::shared_ptr<PhiMatrixFrame> rwt_target = instance_->phi_matrix_pool()->Create(
+    PhiMatrixStorage_Packed, rwt_target_name, n_wt.topic_name(), n_wt);
   PhiMatrixOperations::InvokePhiRegularizers(instance_.get(), regularize_model_args.regularizer_settings(),
                                              p_wt, n_wt, rwt_target.get());
   instance_->SetPhiMatrix(rwt_target_name, rwt_target);
@@ -821,10 +889,18 @@ void MasterComponent::NormalizeModel(const NormalizeModelArgs& normalize_model_a
   if (normalize_model_args.has_rwt_source_name())
     rwt_phi_matrix = instance_->GetPhiMatrixSafe(rwt_source_name);
 
-  auto pwt_target(std::make_shared<DensePhiMatrix>(pwt_target_name, n_wt.topic_name()));
-  pwt_target->Reshape(n_wt);
-  if (rwt_phi_matrix == nullptr) PhiMatrixOperations::FindPwt(n_wt, pwt_target.get());
-  else                           PhiMatrixOperations::FindPwt(n_wt, *rwt_phi_matrix, pwt_target.get());
+  PhiMatrixStorage storage = normalize_model_args.phi_matrix_storage();
+  std::shared_ptr<MasterModelConfig> config = instance_->config();
+  if (!normalize_model_args.has_phi_matrix_storage() && config != nullptr)
+    storage = config->phi_matrix_storage();
+
+  std::shared_ptr<PhiMatrixFrame> pwt_target = instance_->phi_matrix_pool()->Create(
+    storage, pwt_target_name, n_wt.topic_name(), n_wt);
+  std::shared_ptr<ThreadPool> thread_pool = instance_->thread_pool();
+  if (rwt_phi_matrix == nullptr)
+    PhiMatrixOperations::FindPwt(n_wt, pwt_target.get(), thread_pool.get());
+  else
+    PhiMatrixOperations::FindPwt(n_wt, *rwt_phi_matrix, pwt_target.get(), thread_pool.get());
   instance_->SetPhiMatrix(pwt_target_name, pwt_target);
   VLOG(0) << "MasterComponent: complete normalizing model " << normalize_model_args.nwt_source_name();
 }
@@ -897,6 +973,14 @@ void MasterComponent::Request(const TransformMasterModelArgs& args, ::artm::Thet
 
   if (config->has_opt_for_avx()) process_batches_args.set_opt_for_avx(config->opt_for_avx());
   if (config->has_reuse_theta()) process_batches_args.set_reuse_theta(config->reuse_theta());
+  if (config->has_document_chunk_size())
+    process_batches_args.set_document_chunk_size(config->document_chunk_size());
+  if (config->has_theta_convergence_tolerance())
+    process_batches_args.set_theta_convergence_tolerance(config->theta_convergence_tolerance());
+  if (config->has_num_active_topics())
+    process_batches_args.set_num_active_topics(config->num_active_topics());
+  if (config->has_sparse_phi_max_density())
+    process_batches_args.set_sparse_phi_max_density(config->sparse_phi_max_density());
 
   process_batches_args.mutable_class_id()->CopyFrom(config->class_id());
   process_batches_args.mutable_class_weight()->CopyFrom(config->class_weight());
@@ -1023,6 +1107,10 @@ class StringIndex {
   std::string prefix_;
 };
 
+// Lazily decayed n_wt (see ArtmExecutor::Merge) is renormalized once its scale factor leaves this range
+const double kMinNwtScale = 1e-16;
+const double kMaxNwtScale = 1e16;
+
 class ArtmExecutor {
  public:
   ArtmExecutor(const MasterModelConfig& master_model_config,
@@ -1030,7 +1118,10 @@ class ArtmExecutor {
       : master_model_config_(master_model_config),
         pwt_name_(master_model_config.pwt_name()),
         nwt_name_(master_model_config.nwt_name()),
-        master_component_(master_component) {
+        master_component_(master_component),
+        incremental_normalization_(false),
+        incremental_pwt_valid_(false),
+        pwt_has_stale_rows_(false) {
     if (master_model_config.has_num_document_passes())
       process_batches_args_.set_num_document_passes(master_model_config.num_document_passes());
     process_batches_args_.mutable_class_id()->CopyFrom(master_model_config.class_id());
@@ -1052,6 +1143,25 @@ class ArtmExecutor {
       process_batches_args_.set_opt_for_avx(master_model_config.opt_for_avx());
     if (master_model_config.has_reuse_theta())
       process_batches_args_.set_reuse_theta(master_model_config.reuse_theta());
+    if (master_model_config.has_nwt_accumulation_mode())
+      process_batches_args_.set_nwt_accumulation_mode(master_model_config.nwt_accumulation_mode());
+    if (master_model_config.has_deterministic_nwt_reduction())
+      process_batches_args_.set_deterministic_nwt_reduction(master_model_config.deterministic_nwt_reduction());
+    if (master_model_config.has_document_chunk_size())
+      process_batches_args_.set_document_chunk_size(master_model_config.document_chunk_size());
+    if (master_model_config.has_theta_convergence_tolerance())
+      process_batches_args_.set_theta_convergence_tolerance(master_model_config.theta_convergence_tolerance());
+    if (master_model_config.has_num_active_topics())
+      process_batches_args_.set_num_active_topics(master_model_config.num_active_topics());
+    if (master_model_config.has_phi_matrix_locking())
+      process_batches_args_.set_phi_matrix_locking(master_model_config.phi_matrix_locking());
+    if (master_model_config.has_sparse_phi_max_density())
+      process_batches_args_.set_sparse_phi_max_density(master_model_config.sparse_phi_max_density());
+  }
+
+  ~ArtmExecutor() {
+    // Pooled matrices are only reused within one Fit* call, and must not hold memory between the calls
+    master_component_->instance_->phi_matrix_pool()->Clear();
   }
 
   void ExecuteOfflineAlgorithm(int num_collection_passes, OfflineBatchesIterator* iter) {
@@ -1065,13 +1175,26 @@ class ArtmExecutor {
       StoreScores(&score_manager);
     }
 
-    Dispose(rwt_name);
+    Recycle(rwt_name);
   }
 
   void ExecuteOnlineAlgorithm(OnlineBatchesIterator* iter) {
     const std::string rwt_name = "rwt";
     StringIndex nwt_hat_index("nwt_hat");
 
+    // Each nwt_hat covers only a few batches, so only rows of tokens that occur in them are allocated
+    process_batches_args_.set_sparse_nwt_target(true);
+    incremental_normalization_ = (master_model_config_.incremental_normalization_tolerance() > 0);
+    incremental_pwt_valid_ = false;
+
+    // n_wt must not stay lazily decayed, even if the pass is interrupted by an exception
+    call_on_destruction c([&]() {  // NOLINT
+      incremental_normalization_ = false;
+      incremental_pwt_valid_ = false;
+      owned_pwt_.reset();
+      MaterializeNwt();
+    });
+
     master_component_->ClearScoreCache(ClearScoreCacheArgs());
     while (iter->more()) {
       float apply_weight = iter->apply_weight();
@@ -1088,6 +1211,12 @@ class ArtmExecutor {
       nwt_hat_index++;
     }  // while (iter->more())
 
+    // The pass ends with exact p_wt, no matter how many rows were updated incrementally
+    if (pwt_has_stale_rows_) {
+      incremental_pwt_valid_ = false;
+      Normalize(pwt_name_, nwt_name_, rwt_name);
+    }
+
     iter->reset();
   }
 
@@ -1110,6 +1239,9 @@ class ArtmExecutor {
     StringIndex pwt_index("pwt");
     StringIndex nwt_hat_index("nwt_hat");
 
+    // Each nwt_hat covers only a few batches, so only rows of tokens that occur in them are allocated
+    process_batches_args_.set_sparse_nwt_target(true);
+    call_on_destruction c([&]() { MaterializeNwt(); });  // NOLINT
     master_component_->ClearScoreCache(ClearScoreCacheArgs());
     int op_id = AsyncProcessBatches(pwt_active, nwt_hat_index, iter);
 
@@ -1148,6 +1280,15 @@ class ArtmExecutor {
   RegularizeModelArgs regularize_model_args_;
   std::vector<std::shared_ptr<BatchManager>> async_;
 
+  // State of incremental normalization in online algorithm (see NormalizeIncrementally)
+  bool incremental_normalization_;
+  bool incremental_pwt_valid_;
+  bool pwt_has_stale_rows_;
+  std::vector<int> dirty_tokens_;
+  std::shared_ptr<const PhiMatrix> owned_pwt_;  // p_wt created by the last full normalization of this executor
+  std::map<ClassId, std::vector<float> > storage_n_t_;  // normalizers of the storage of lazily decayed n_wt
+  std::map<ClassId, std::vector<float> > pwt_storage_n_t_;  // storage_n_t_ at the last full recalculation of p_wt
+
   void ProcessBatches(std::string pwt, std::string nwt, BatchesIterator* iter, ScoreManager* score_manager) {
     process_batches_args_.set_pwt_source_name(pwt);
     process_batches_args_.set_nwt_target_name(nwt);
@@ -1182,13 +1323,12 @@ class ArtmExecutor {
   }
 
   void Await(int operation_id) {
-    while (!async_[operation_id]->IsEverythingProcessed()) {
-      boost::this_thread::sleep(boost::posix_time::milliseconds(kIdleLoopFrequency));
-    }
+    async_[operation_id]->WaitUntilEverythingProcessed();
   }
 
   void Regularize(std::string pwt, std::string nwt, std::string rwt) {
     if (regularize_model_args_.regularizer_settings_size() > 0) {
+      Recycle(rwt);  // r_wt of the previous iteration is no longer used
       regularize_model_args_.set_nwt_source_name(nwt);
       regularize_model_args_.set_pwt_source_name(pwt);
       regularize_model_args_.set_rwt_target_name(rwt);
@@ -1198,6 +1338,9 @@ class ArtmExecutor {
   }
 
   void Normalize(std::string pwt, std::string nwt, std::string rwt) {
+    if (NormalizeIncrementally(pwt, nwt))
+      return;
+
     NormalizeModelArgs normalize_model_args;
     if (regularize_model_args_.regularizer_settings_size() > 0)
       normalize_model_args.set_rwt_source_name(rwt);
@@ -1205,6 +1348,64 @@ class ArtmExecutor {
     normalize_model_args.set_pwt_target_name(pwt);
     LOG(INFO) << DescribeMessage(normalize_model_args);
     master_component_->NormalizeModel(normalize_model_args);
+
+    pwt_has_stale_rows_ = false;
+    dirty_tokens_.clear();
+    incremental_pwt_valid_ = false;
+    owned_pwt_.reset();
+    if (!incremental_normalization_ || pwt != pwt_name_ || regularize_model_args_.regularizer_settings_size() > 0)
+      return;
+
+    auto scaled_nwt = std::dynamic_pointer_cast<const ScaledPhiMatrix>(master_component_->instance_->GetPhiMatrix(nwt));
+    if (scaled_nwt == nullptr)
+      return;
+
+    storage_n_t_ = PhiMatrixOperations::FindNormalizers(*scaled_nwt->storage(),
+                                                        master_component_->instance_->thread_pool().get());
+    pwt_storage_n_t_ = storage_n_t_;
+    owned_pwt_ = master_component_->instance_->GetPhiMatrix(pwt);
+    incremental_pwt_valid_ = (owned_pwt_ != nullptr);
+  }
+
+  // Recalculates only the rows of p_wt that were changed by Merge since the last normalization.
+  // Other rows keep the values of the last full recalculation, which equal storage values divided by
+  // the storage normalizers of that time; the decay scale cancels out in both. So this is only done while
+  // the storage normalizers of every topic stay within the relative tolerance of those from the last full
+  // recalculation. Returns false when p_wt must be fully recalculated.
+  bool NormalizeIncrementally(const std::string& pwt, const std::string& nwt) {
+    if (!incremental_pwt_valid_ || pwt != pwt_name_)
+      return false;
+
+    Instance* instance = master_component_->instance_.get();
+    auto scaled_nwt = std::dynamic_pointer_cast<const ScaledPhiMatrix>(instance->GetPhiMatrix(nwt));
+    std::shared_ptr<const PhiMatrix> p_wt = instance->GetPhiMatrix(pwt);
+
+    // p_wt is updated in place, which is only done while it is the matrix created by this executor
+    if (scaled_nwt == nullptr || p_wt == nullptr || p_wt != owned_pwt_ ||
+        !PhiMatrixOperations::HasEqualShape(*p_wt, *scaled_nwt))
+      return false;
+
+    const float tolerance = master_model_config_.incremental_normalization_tolerance();
+    std::map<ClassId, std::vector<float> > n_t = storage_n_t_;
+    for (auto& class_n_t : n_t) {
+      auto iter = pwt_storage_n_t_.find(class_n_t.first);
+      if (iter == pwt_storage_n_t_.end())
+        return false;
+
+      for (int topic_id = 0; topic_id < static_cast<int>(class_n_t.second.size()); ++topic_id) {
+        float& value = class_n_t.second[topic_id];
+        if (std::fabs(value - iter->second[topic_id]) > tolerance * iter->second[topic_id])
+          return false;
+        value = static_cast<float>(value * scaled_nwt->scale());
+      }
+    }
+
+    LOG(INFO) << "Normalize " << dirty_tokens_.size() << " of " << p_wt->token_size() << " tokens in " << pwt;
+    PhiMatrixOperations::FindPwtRows(*scaled_nwt, n_t, dirty_tokens_, const_cast<PhiMatrix*>(p_wt.get()),
+                                     master_component_->instance_->thread_pool().get());
+    pwt_has_stale_rows_ = true;
+    dirty_tokens_.clear();
+    return true;
   }
 
   void StoreScores(::artm::core::ScoreManager* score_manager) {
@@ -1216,6 +1417,51 @@ class ArtmExecutor {
   }
 
   void Merge(std::string nwt, double decay_weight, std::string nwt_hat, double apply_weight) {
+    // n_wt is decayed lazily: it is kept as ScaledPhiMatrix with a running scale factor,
+    // so that only the rows touched by nwt_hat are written on each update.
+    Instance* instance = master_component_->instance_.get();
+    std::shared_ptr<const PhiMatrix> nwt_matrix = instance->GetPhiMatrix(nwt);
+    std::shared_ptr<const PhiMatrix> nwt_hat_matrix = instance->GetPhiMatrix(nwt_hat);
+    auto scaled_nwt = std::dynamic_pointer_cast<const ScaledPhiMatrix>(nwt_matrix);
+    if (scaled_nwt != nullptr && nwt_hat_matrix != nullptr) {
+      std::shared_ptr<PhiMatrix> storage = scaled_nwt->storage();
+      double scale = scaled_nwt->scale() * decay_weight;
+      if (!(scale >= kMinNwtScale && scale <= kMaxNwtScale)) {
+        // Apply the scale physically before values in the storage approach float limits
+        PhiMatrixOperations::MultiplyValue(static_cast<float>(scale), storage.get(), instance->thread_pool().get());
+        for (auto* normalizers : { &storage_n_t_, &pwt_storage_n_t_ }) {
+          for (auto& n_t : *normalizers) {
+            for (float& value : n_t.second)
+              value = static_cast<float>(value * scale);
+          }
+        }
+        scale = 1.0;
+      }
+
+      // Rows written by nwt_hat are the only rows of n_wt that change (besides the scale)
+      std::vector<int> touched_tokens;
+      auto sparse_nwt_hat = std::dynamic_pointer_cast<const SparsePhiMatrix>(nwt_hat_matrix);
+      if (incremental_pwt_valid_) {
+        if (sparse_nwt_hat != nullptr && PhiMatrixOperations::HasEqualShape(*sparse_nwt_hat, *storage)) {
+          touched_tokens = sparse_nwt_hat->allocated_tokens();
+        } else {
+          incremental_pwt_valid_ = false;
+        }
+      }
+
+      if (incremental_pwt_valid_)
+        PhiMatrixOperations::AddNormalizers(*storage, touched_tokens, -1.0f, &storage_n_t_);
+      PhiMatrixOperations::ApplyPhiMatrix(*nwt_hat_matrix, static_cast<float>(apply_weight / scale),
+                                          /* add_missing_tokens = */ true, storage.get(),
+                                          instance->thread_pool().get());
+      if (incremental_pwt_valid_) {
+        PhiMatrixOperations::AddNormalizers(*storage, touched_tokens, 1.0f, &storage_n_t_);
+        dirty_tokens_.insert(dirty_tokens_.end(), touched_tokens.begin(), touched_tokens.end());
+      }
+      instance->SetPhiMatrix(nwt, std::make_shared<ScaledPhiMatrix>(storage, scale));
+      return;
+    }
+
     MergeModelArgs merge_model_args;
     merge_model_args.add_nwt_source_name(nwt);
     merge_model_args.add_source_weight(decay_weight);
@@ -1224,12 +1470,36 @@ class ArtmExecutor {
     merge_model_args.set_nwt_target_name(nwt);
     LOG(INFO) << DescribeMessage(merge_model_args);
     master_component_->MergeModel(merge_model_args);
+
+    // The merged matrix is owned by this executor, so it becomes the storage of the lazily decayed n_wt
+    std::shared_ptr<const PhiMatrix> merged = instance->GetPhiMatrix(nwt);
+    if (merged != nullptr)
+      instance->SetPhiMatrix(nwt, std::make_shared<ScaledPhiMatrix>(std::const_pointer_cast<PhiMatrix>(merged), 1.0));
+  }
+
+  // Replaces lazily decayed n_wt with a regular matrix, so that the scale never leaks outside of the executor
+  void MaterializeNwt() {
+    Instance* instance = master_component_->instance_.get();
+    auto scaled_nwt = std::dynamic_pointer_cast<const ScaledPhiMatrix>(instance->GetPhiMatrix(nwt_name_));
+    if (scaled_nwt == nullptr)
+      return;
+
+    std::shared_ptr<PhiMatrix> storage = scaled_nwt->storage();
+    if (scaled_nwt->scale() != 1.0)
+      PhiMatrixOperations::MultiplyValue(static_cast<float>(scaled_nwt->scale()), storage.get(),
+                                         instance->thread_pool().get());
+    instance->SetPhiMatrix(nwt_name_, storage);
   }
 
   void Dispose(std::string model_name) {
     LOG(INFO) << "DisposeModel " << model_name;
     master_component_->DisposeModel(model_name);
   }
+
+  // Disposes a temporary matrix that is no longer referenced outside of the instance, and pools its memory
+  void Recycle(std::string model_name) {
+    master_component_->instance_->RecycleModel(model_name);
+  }
 };
 
 void MasterComponent::FitOnline(const FitOnlineMasterModelArgs& args) {
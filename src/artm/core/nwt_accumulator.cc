@@ -0,0 +1,96 @@
+// Copyright 2016, Additive Regularization of Topic Models.
+
+#include "artm/core/nwt_accumulator.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "glog/logging.h"
+
+namespace artm {
+namespace core {
+
+NwtBuffer::NwtBuffer(int topic_size) : topic_size_(topic_size), row_index_(), token_ids_(), values_() {}
+
+void NwtBuffer::Add(int token_id, const std::vector<float>& values) {
+  assert(static_cast<int>(values.size()) == topic_size_);
+  auto iter = row_index_.find(token_id);
+  int row;
+  if (iter == row_index_.end()) {
+    row = static_cast<int>(token_ids_.size());
+    row_index_.insert(std::make_pair(token_id, row));
+    token_ids_.push_back(token_id);
+    values_.resize(values_.size() + topic_size_, 0.0f);
+  } else {
+    row = iter->second;
+  }
+
+  float* row_ptr = &values_[static_cast<size_t>(row) * topic_size_];
+  for (int topic_index = 0; topic_index < topic_size_; ++topic_index)
+    row_ptr[topic_index] += values[topic_index];
+}
+
+void NwtBuffer::FlushTo(PhiMatrix* n_wt) {
+  std::vector<float> increment(topic_size_, 0.0f);
+  for (int row = 0; row < static_cast<int>(token_ids_.size()); ++row) {
+    const float* row_ptr = &values_[static_cast<size_t>(row) * topic_size_];
+    std::copy(row_ptr, row_ptr + topic_size_, increment.begin());
+    n_wt->increase(token_ids_[row], increment);
+  }
+
+  row_index_.clear();
+  token_ids_.clear();
+  values_.clear();
+}
+
+NwtAccumulator::NwtAccumulator(std::shared_ptr<PhiMatrix> nwt_target, int num_tasks, bool deterministic)
+    : lock_(), nwt_target_(nwt_target), num_tasks_(num_tasks), num_completed_(0),
+      deterministic_(deterministic), is_task_completed_(deterministic ? num_tasks : 0, 0), num_reduced_tasks_(0),
+      task_buffers_(), thread_buffers_() {}
+
+std::shared_ptr<NwtBuffer> NwtAccumulator::buffer(int task_index) {
+  boost::lock_guard<boost::mutex> guard(lock_);
+  std::shared_ptr<NwtBuffer>& retval = deterministic_ ? task_buffers_[task_index]
+                                                      : thread_buffers_[boost::this_thread::get_id()];
+  if (retval == nullptr)
+    retval = std::make_shared<NwtBuffer>(nwt_target_->topic_size());
+  return retval;
+}
+
+void NwtAccumulator::Complete(int task_index) {
+  // Buffers are reduced under the lock, so the target always has a single writer
+  boost::lock_guard<boost::mutex> guard(lock_);
+  num_completed_++;
+
+  if (deterministic_) {
+    assert(task_index >= 0 && task_index < num_tasks_);
+    is_task_completed_[task_index] = 1;
+
+    // Reduce the longest completed prefix of tasks, in the order of task indices
+    for (; num_reduced_tasks_ < num_tasks_ && is_task_completed_[num_reduced_tasks_]; ++num_reduced_tasks_) {
+      auto iter = task_buffers_.find(num_reduced_tasks_);
+      if (iter == task_buffers_.end())
+        continue;  // the task has failed before it wrote anything
+
+      iter->second->FlushTo(nwt_target_.get());
+      task_buffers_.erase(iter);
+    }
+  }
+
+  if (num_completed_ < num_tasks_)
+    return;
+
+  // All tasks are completed, so no processor touches the buffers any longer.
+  assert(task_buffers_.empty());
+  for (auto& buffer : thread_buffers_)
+    buffer.second->FlushTo(nwt_target_.get());
+
+  VLOG(1) << "NwtAccumulator: reduced " << (deterministic_ ? num_tasks_ : static_cast<int>(thread_buffers_.size()))
+          << " buffers from " << num_tasks_ << " tasks";
+  thread_buffers_.clear();
+}
+
+}  // namespace core
+}  // namespace artm
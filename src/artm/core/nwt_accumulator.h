@@ -0,0 +1,75 @@
+// Copyright 2016, Additive Regularization of Topic Models.
+
+#ifndef SRC_ARTM_CORE_NWT_ACCUMULATOR_H_
+#define SRC_ARTM_CORE_NWT_ACCUMULATOR_H_
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "boost/thread.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/utility.hpp"
+
+#include "artm/core/common.h"
+#include "artm/core/phi_matrix.h"
+
+namespace artm {
+namespace core {
+
+// NwtBuffer is a private (not thread-safe) sparse buffer of n_wt increments.
+// Rows are keyed by token index in the target phi matrix and allocated on first write.
+class NwtBuffer : boost::noncopyable {
+ public:
+  explicit NwtBuffer(int topic_size);
+
+  void Add(int token_id, const std::vector<float>& values);
+
+  // Adds all buffered rows to n_wt (in the order they were first written) and clears the buffer.
+  void FlushTo(PhiMatrix* n_wt);
+
+  int row_size() const { return static_cast<int>(token_ids_.size()); }
+  int topic_size() const { return topic_size_; }
+
+ private:
+  int topic_size_;
+  std::unordered_map<int, int> row_index_;
+  std::vector<int> token_ids_;
+  std::vector<float> values_;
+};
+
+// NwtAccumulator collects n_wt increments of one group of tasks (all batches from one ProcessBatches request)
+// in private buffers, and reduces them into the n_wt target once the last task of the group is completed.
+// This replaces contended per-token locking of the target with a single reduction step.
+// When 'deterministic' is set each task gets its own buffer, and buffers are reduced in the order of task indices,
+// so the result does not depend on how tasks were scheduled across processors. The buffer of task i is reduced
+// (and freed) as soon as tasks 0..i are completed, so only buffers of tasks that finished out of order are kept.
+// Otherwise each processor thread keeps one buffer for all tasks it handles in this group.
+class NwtAccumulator : boost::noncopyable {
+ public:
+  NwtAccumulator(std::shared_ptr<PhiMatrix> nwt_target, int num_tasks, bool deterministic);
+
+  // Returns the buffer where the calling processor should store n_wt increments of the given task.
+  std::shared_ptr<NwtBuffer> buffer(int task_index);
+
+  // Marks task as completed. Must be called exactly once per task, even if the task has failed.
+  // The call that completes the last task reduces all remaining buffers into the target.
+  void Complete(int task_index);
+
+ private:
+  mutable boost::mutex lock_;
+  std::shared_ptr<PhiMatrix> nwt_target_;
+  int num_tasks_;
+  int num_completed_;
+  bool deterministic_;
+  std::vector<char> is_task_completed_;  // only used when deterministic
+  int num_reduced_tasks_;                // tasks 0..num_reduced_tasks_-1 are already reduced into the target
+  std::map<int, std::shared_ptr<NwtBuffer>> task_buffers_;
+  std::map<boost::thread::id, std::shared_ptr<NwtBuffer>> thread_buffers_;
+};
+
+}  // namespace core
+}  // namespace artm
+
+#endif  // SRC_ARTM_CORE_NWT_ACCUMULATOR_H_
@@ -31,8 +31,41 @@ class PhiMatrix {
   virtual bool has_token(const Token& token) const = 0;
   virtual int token_index(const Token& token) const = 0;
 
+  // Identifies the set of tokens (with their order). Two matrices with equal non-zero versions
+  // are guaranteed to have identical tokens, so results of token_index() may be reused between them.
+  // Zero means that the version is unknown.
+  virtual int64_t token_set_version() const { return 0; }
+
   virtual float get(int token_id, int topic_id) const = 0;
   virtual void get(int token_id, std::vector<float>* buffer) const = 0;
+
+  // Returns a read-only pointer to topic_size() values of the token.
+  // Implementations that keep the row in contiguous memory return a pointer into their own storage;
+  // otherwise the row is copied into 'buffer' (resized if needed), and the pointer refers to 'buffer'.
+  // The pointer is valid until the matrix or the buffer is modified.
+  virtual const float* get_row(int token_id, std::vector<float>* buffer) const {
+    buffer->resize(topic_size());
+    get(token_id, buffer);
+    return &(*buffer)[0];
+  }
+
+  // Appends indices and values of non-zero elements of the row to 'topic_index' and 'value',
+  // and returns the number of appended elements. Implementations that keep sparse rows in compact form
+  // override this method to avoid expanding the row to topic_size() values.
+  virtual int get_nonzeros(int token_id, std::vector<int>* topic_index, std::vector<float>* value) const {
+    std::vector<float> buffer;
+    const float* row = get_row(token_id, &buffer);
+    int nonzero_size = 0;
+    for (int topic_id = 0; topic_id < topic_size(); ++topic_id) {
+      if (row[topic_id] != 0.0f) {
+        topic_index->push_back(topic_id);
+        value->push_back(row[topic_id]);
+        nonzero_size++;
+      }
+    }
+    return nonzero_size;
+  }
+
   virtual void set(int token_id, int topic_id, float value) = 0;
   virtual void increase(int token_id, int topic_id, float increment) = 0;
   virtual void increase(int token_id, const std::vector<float>& increment) = 0;  // must be thread-safe
@@ -5,6 +5,7 @@
 #include <assert.h>
 
 #include <algorithm>
+#include <unordered_map>
 #include <utility>
 #include <string>
 
@@ -16,11 +17,40 @@
 #include "artm/core/helpers.h"
 #include "artm/core/dense_phi_matrix.h"
 #include "artm/core/instance.h"
+#include "artm/core/phi_matrix_pool.h"
+#include "artm/core/thread_pool.h"
 #include "artm/regularizer_interface.h"
 
 namespace artm {
 namespace core {
 
+// Token ranges smaller than this are not worth a separate thread
+static const int kMinTokensPerPartition = 16 * 1024;
+
+static int GetNumPartitions(ThreadPool* thread_pool, int token_size) {
+  int num_threads = (thread_pool == nullptr) ? 1 : thread_pool->num_threads();
+  return std::max(1, std::min(num_threads, token_size / kMinTokensPerPartition));
+}
+
+// Splits [0, token_size) into num_partitions contiguous ranges and calls func(begin, end, partition) for each range.
+// The ranges are processed by the thread pool (including the calling thread);
+// exceptions are re-thrown on the calling thread.
+template<typename Func>
+static void ParallelForTokens(ThreadPool* thread_pool, int token_size, int num_partitions, const Func& func) {
+  if (num_partitions <= 1 || thread_pool == nullptr) {
+    func(0, token_size, 0);
+    return;
+  }
+
+  auto partition_begin = [token_size, num_partitions](int partition) {
+    return static_cast<int>(static_cast<int64_t>(token_size) * partition / num_partitions);
+  };
+
+  thread_pool->ParallelFor(num_partitions, [&](int partition) {
+    func(partition_begin(partition), partition_begin(partition + 1), partition);
+  });
+}
+
 void PhiMatrixOperations::RetrieveExternalTopicModel(const PhiMatrix& phi_matrix,
                                                      const ::artm::GetTopicModelArgs& get_model_args,
                                                      ::artm::TopicModel* topic_model) {
@@ -188,6 +218,84 @@ void PhiMatrixOperations::ApplyTopicModelOperation(const ::artm::TopicModel& top
   }
 }
 
+void PhiMatrixOperations::ApplyPhiMatrix(const PhiMatrix& source, float apply_weight, bool add_missing_tokens,
+                                         PhiMatrix* phi_matrix, ThreadPool* thread_pool) {
+  const int source_topic_size = source.topic_size();
+  const int this_topic_size = phi_matrix->topic_size();
+
+  auto this_topic_name = phi_matrix->topic_name();
+  std::vector<int> target_topic_index;
+  bool ok = false;
+  for (int topic_index = 0; topic_index < source_topic_size; ++topic_index) {
+    int index = repeated_field_index_of(this_topic_name, source.topic_name(topic_index));
+    target_topic_index.push_back(index);
+    if (index != -1) ok = true;
+  }
+  if (!ok) {
+    LOG(ERROR) << "None of topic names in " << source.model_name() << " match topic names in target model";
+    return;
+  }
+
+  bool same_topics = (source_topic_size == this_topic_size);
+  for (int topic_index = 0; same_topics && topic_index < source_topic_size; ++topic_index)
+    same_topics = (target_topic_index[topic_index] == topic_index);
+
+  // Only written rows of a sparse source are visited (typical for n_wt increments of a few batches)
+  const SparsePhiMatrix* sparse_source = dynamic_cast<const SparsePhiMatrix*>(&source);
+  std::vector<int> source_token_id;
+  if (sparse_source != nullptr)
+    source_token_id = sparse_source->allocated_tokens();
+  auto get_source_token_id = [&](int index) {  // NOLINT
+    return (sparse_source != nullptr) ? source_token_id[index] : index;
+  };
+
+  // When shapes differ, source tokens are remapped into the target.
+  // Missing tokens are added here, because AddToken is not thread-safe.
+  const int token_size = (sparse_source != nullptr) ? static_cast<int>(source_token_id.size()) : source.token_size();
+  const bool same_tokens = same_topics && HasEqualShape(source, *phi_matrix);
+  std::vector<int> target_token_index;
+  if (!same_tokens) {
+    target_token_index.resize(token_size, -1);
+    for (int token_index = 0; token_index < token_size; ++token_index) {
+      const Token& token = source.token(get_source_token_id(token_index));
+      int current_token_id = phi_matrix->token_index(token);
+      if (current_token_id == -1 && add_missing_tokens)
+        current_token_id = phi_matrix->AddToken(token);
+      target_token_index[token_index] = current_token_id;
+    }
+  }
+
+  const int num_partitions = GetNumPartitions(thread_pool, token_size);
+  ParallelForTokens(thread_pool, token_size, num_partitions, [&](int begin, int end, int partition) {
+    std::vector<float> buffer;
+    std::vector<float> increment(this_topic_size, 0.0f);
+    for (int token_index = begin; token_index < end; ++token_index) {
+      const int source_token = get_source_token_id(token_index);
+      const int current_token_id = same_tokens ? source_token : target_token_index[token_index];
+      if (current_token_id == -1)
+        continue;
+
+      // Rows that are not touched in the source are skipped (typical for n_wt increments of a few batches)
+      const float* values = source.get_row(source_token, &buffer);
+      if (std::all_of(values, values + source_topic_size, [](float value) { return value == 0.0f; }))
+        continue;
+
+      if (same_topics) {
+        for (int topic_index = 0; topic_index < this_topic_size; ++topic_index)
+          increment[topic_index] = apply_weight * values[topic_index];
+      } else {
+        std::fill(increment.begin(), increment.end(), 0.0f);
+        for (int topic_index = 0; topic_index < source_topic_size; ++topic_index) {
+          if (target_topic_index[topic_index] != -1)
+            increment[target_topic_index[topic_index]] += apply_weight * values[topic_index];
+        }
+      }
+
+      phi_matrix->increase(current_token_id, increment);
+    }
+  });
+}
+
 void PhiMatrixOperations::InvokePhiRegularizers(
     Instance* instance,
     const ::google::protobuf::RepeatedPtrField<RegularizerSettings>& regularizer_settings,
@@ -196,10 +304,15 @@ void PhiMatrixOperations::InvokePhiRegularizers(
   int topic_size = n_wt.topic_size();
   int token_size = n_wt.token_size();
 
-  DensePhiMatrix local_r_wt(ModelName(), n_wt.topic_name());
-  local_r_wt.Reshape(n_wt);
+  // Scratch matrix is taken from the pool and given back once all regularizers are applied
+  PhiMatrixPool* pool = instance->phi_matrix_pool();
+  std::shared_ptr<DensePhiMatrix> local_r_wt_ptr = std::static_pointer_cast<DensePhiMatrix>(
+    pool->Create(PhiMatrixStorage_Packed, ModelName(), n_wt.topic_name(), n_wt));
+  DensePhiMatrix& local_r_wt = *local_r_wt_ptr;
 
-  auto n_t_all = PhiMatrixOperations::FindNormalizers(n_wt);
+  std::shared_ptr<ThreadPool> thread_pool_ptr = instance->thread_pool();
+  ThreadPool* thread_pool = thread_pool_ptr.get();
+  auto n_t_all = PhiMatrixOperations::FindNormalizers(n_wt, thread_pool);
 
   for (auto reg_iterator = regularizer_settings.begin();
        reg_iterator != regularizer_settings.end();
@@ -249,6 +362,36 @@ void PhiMatrixOperations::InvokePhiRegularizers(
         else
           topics_to_regularize.assign(topic_size, true);
 
+        // r_it = sum_w |r_wt| is accumulated per class over token ranges, and then reduced
+        std::unordered_map<core::ClassId, std::vector<float> > r_it_all;
+        for (const auto& class_id : class_ids) {
+          if (n_t_all.find(class_id) != n_t_all.end())
+            r_it_all.insert(std::make_pair(class_id, std::vector<float>(topic_size, 0.0f)));
+        }
+
+        const int num_partitions = GetNumPartitions(thread_pool, token_size);
+        std::vector<std::unordered_map<core::ClassId, std::vector<float> > > r_it_partial(num_partitions, r_it_all);
+        ParallelForTokens(thread_pool, token_size, num_partitions, [&](int begin, int end, int partition) {
+          std::vector<float> buffer;
+          for (int token_id = begin; token_id < end; ++token_id) {
+            auto iter = r_it_partial[partition].find(n_wt.token(token_id).class_id);
+            if (iter == r_it_partial[partition].end())
+              continue;
+
+            const float* r_wt_row = local_r_wt.get_row(token_id, &buffer);
+            for (int topic_id = 0; topic_id < topic_size; ++topic_id)
+              iter->second[topic_id] += fabs(r_wt_row[topic_id]);
+          }
+        });
+
+        for (auto& r_it_class : r_it_all) {
+          for (const auto& partial : r_it_partial) {
+            const std::vector<float>& partial_r_it = partial.find(r_it_class.first)->second;
+            for (int topic_id = 0; topic_id < topic_size; ++topic_id)
+              r_it_class.second[topic_id] += partial_r_it[topic_id];
+          }
+        }
+
         for (const auto& class_id : class_ids) {
           auto iter = n_t_all.find(class_id);
           if (iter != n_t_all.end()) {
@@ -256,6 +399,7 @@ void PhiMatrixOperations::InvokePhiRegularizers(
             double r_i = 0.0;
             std::vector<float> r_it;
             std::vector<float> n_t = iter->second;
+            const std::vector<float>& r_it_class = r_it_all[class_id];
 
             for (int topic_id = 0; topic_id < topic_size; ++topic_id) {
               if (!topics_to_regularize[topic_id]) {
@@ -264,13 +408,7 @@ void PhiMatrixOperations::InvokePhiRegularizers(
               }
               n += n_t[topic_id];
 
-              float r_it_current = 0.0f;
-              for (int token_id = 0; token_id < token_size; ++token_id) {
-                if (n_wt.token(token_id).class_id != iter->first) continue;
-
-                r_it_current += fabs(local_r_wt.get(token_id, topic_id));
-              }
-
+              float r_it_current = r_it_class[topic_id];
               r_it.push_back(r_it_current);
               r_i += r_it_current;
             }
@@ -287,58 +425,141 @@ void PhiMatrixOperations::InvokePhiRegularizers(
         }
       }
 
-      for (int token_id = 0; token_id < token_size; ++token_id) {
-        auto iter = parameters.find(n_wt.token(token_id).class_id);
-        if (relative_reg) {
-          if (iter == parameters.end()) continue;
-        }
-        // ToDo (MelLain): move this loop outside the outer one
-        for (int topic_id = 0; topic_id < topic_size; ++topic_id) {
-          float coefficient = 1.0f;
+      // Each token range updates its own rows of r_wt
+      const int num_partitions = GetNumPartitions(thread_pool, token_size);
+      ParallelForTokens(thread_pool, token_size, num_partitions, [&](int begin, int end, int partition) {
+        std::vector<float> buffer;
+        std::vector<float> increment(topic_size, 0.0f);
+        for (int token_id = begin; token_id < end; ++token_id) {
+          auto iter = parameters.find(n_wt.token(token_id).class_id);
           if (relative_reg) {
-            if (!topics_to_regularize[topic_id]) continue;
-
-            double gamma = reg_iterator->gamma();
-            float n_t = iter->second.first.second[topic_id];
-            float n = iter->second.first.first;
-            float r_it = iter->second.second.second[topic_id];
-            float r_i = iter->second.second.first;
-            coefficient = static_cast<float>(gamma) * (n_t / r_it) + static_cast<float>(1 - gamma) * (n / r_i);
+            if (iter == parameters.end()) continue;
           }
-          // update global r_wt using coefficient and tau
-          float increment = coefficient * tau * local_r_wt.get(token_id, topic_id);
-          r_wt->increase(token_id, topic_id, increment);
+
+          const float* r_wt_row = local_r_wt.get_row(token_id, &buffer);
+          for (int topic_id = 0; topic_id < topic_size; ++topic_id) {
+            float coefficient = 1.0f;
+            increment[topic_id] = 0.0f;
+            if (relative_reg) {
+              if (!topics_to_regularize[topic_id]) continue;
+
+              double gamma = reg_iterator->gamma();
+              float n_t = iter->second.first.second[topic_id];
+              float n = iter->second.first.first;
+              float r_it = iter->second.second.second[topic_id];
+              float r_i = iter->second.second.first;
+              coefficient = static_cast<float>(gamma) * (n_t / r_it) + static_cast<float>(1 - gamma) * (n / r_i);
+            }
+            // update global r_wt using coefficient and tau
+            increment[topic_id] = coefficient * tau * r_wt_row[topic_id];
+          }
+
+          r_wt->increase(token_id, increment);
         }
-      }
+      });
       local_r_wt.Reset();
     }
   }
+
+  pool->Release(std::move(local_r_wt_ptr));
 }
 
-static std::map<ClassId, std::vector<float> > FindNormalizersImpl(const PhiMatrix& n_wt, const PhiMatrix* r_wt) {
-  std::map<ClassId, std::vector<float> > retval;
+static std::map<ClassId, std::vector<float> > FindNormalizersImpl(const PhiMatrix& n_wt, const PhiMatrix* r_wt,
+                                                                  ThreadPool* thread_pool) {
   assert((r_wt == nullptr) || (r_wt->token_size() == n_wt.token_size() && r_wt->topic_size() == n_wt.topic_size()));
+  const int topic_size = n_wt.topic_size();
 
-  for (int token_id = 0; token_id < n_wt.token_size(); ++token_id) {
-    const Token& token = n_wt.token(token_id);
-    assert(r_wt == nullptr || r_wt->token(token_id) == token);
-    auto iter = retval.find(token.class_id);
-    if (iter == retval.end()) {
-      retval.insert(std::pair<ClassId, std::vector<float> >(token.class_id, std::vector<float>(n_wt.topic_size(), 0)));
-      iter = retval.find(token.class_id);
+  // Normalizers are accumulated per token range, and then reduced
+  const int num_partitions = GetNumPartitions(thread_pool, n_wt.token_size());
+  std::vector<std::map<ClassId, std::vector<float> > > partial(num_partitions);
+  ParallelForTokens(thread_pool, n_wt.token_size(), num_partitions, [&](int begin, int end, int partition) {
+    std::map<ClassId, std::vector<float> >& retval = partial[partition];
+    std::vector<float> nwt_buffer, rwt_buffer;
+    std::vector<float>* n_t = nullptr;
+    const ClassId* last_class_id = nullptr;
+    for (int token_id = begin; token_id < end; ++token_id) {
+      const Token& token = n_wt.token(token_id);
+      assert(r_wt == nullptr || r_wt->token(token_id) == token);
+
+      // Tokens of the same class usually go together, so the map lookup is skipped for them
+      if (last_class_id == nullptr || *last_class_id != token.class_id) {
+        auto iter = retval.find(token.class_id);
+        if (iter == retval.end())
+          iter = retval.insert(std::make_pair(token.class_id, std::vector<float>(topic_size, 0))).first;
+        n_t = &iter->second;
+        last_class_id = &token.class_id;
+      }
+
+      const float* nwt_row = n_wt.get_row(token_id, &nwt_buffer);
+      const float* rwt_row = (r_wt == nullptr) ? nullptr : r_wt->get_row(token_id, &rwt_buffer);
+      for (int topic_id = 0; topic_id < topic_size; ++topic_id) {
+        const float sum = nwt_row[topic_id] + ((rwt_row == nullptr) ? 0.0f : rwt_row[topic_id]);
+        if (sum > 0)
+          (*n_t)[topic_id] += sum;
+      }
     }
+  });
 
-    for (int topic_id = 0; topic_id < n_wt.topic_size(); ++topic_id) {
-      const float sum = n_wt.get(token_id, topic_id) + ((r_wt == nullptr) ? 0.0f : r_wt->get(token_id, topic_id));
-      if (sum > 0)
-        iter->second[topic_id] += sum;
+  std::map<ClassId, std::vector<float> > retval;
+  for (const auto& partial_retval : partial) {
+    for (const auto& partial_n_t : partial_retval) {
+      auto iter = retval.find(partial_n_t.first);
+      if (iter == retval.end()) {
+        retval.insert(partial_n_t);
+        continue;
+      }
+
+      for (int topic_id = 0; topic_id < topic_size; ++topic_id)
+        iter->second[topic_id] += partial_n_t.second[topic_id];
     }
   }
 
   return retval;
 }
 
-static void FindPwtImpl(const PhiMatrix& n_wt, const PhiMatrix* r_wt, PhiMatrix* p_wt) {
+// Calculates one row of p_wt. All values are written, so the row may be recalculated in place.
+// Rows of a DensePhiMatrix are written at once, so that they are packed or unpacked according to their new density.
+static void FindPwtRow(int token_id, const std::map<ClassId, std::vector<float> >& n_t,
+                       const PhiMatrix& n_wt, const PhiMatrix* r_wt, PhiMatrix* p_wt, DensePhiMatrix* dense_p_wt,
+                       std::vector<float>* nwt_buffer, std::vector<float>* rwt_buffer, std::vector<float>* pwt_buffer) {
+  const int topic_size = n_wt.topic_size();
+  const Token& token = n_wt.token(token_id);
+  assert(r_wt == nullptr || r_wt->token(token_id) == token);
+  assert(p_wt->token(token_id) == token);
+  auto n_t_iter = n_t.find(token.class_id);
+  assert(n_t_iter != n_t.end());
+  const std::vector<float>& nt = n_t_iter->second;
+
+  const float* nwt_row = n_wt.get_row(token_id, nwt_buffer);
+  const float* rwt_row = (r_wt == nullptr) ? nullptr : r_wt->get_row(token_id, rwt_buffer);
+  pwt_buffer->resize(topic_size);
+  float* pwt_row = &(*pwt_buffer)[0];
+  for (int topic_index = 0; topic_index < topic_size; ++topic_index) {
+    float value = 0.0f;
+    if (nt[topic_index] > 0) {
+      float nwt_value = nwt_row[topic_index];
+      float rwt_value = (rwt_row == nullptr) ? 0.0f : rwt_row[topic_index];
+      value = std::max<float>(nwt_value + rwt_value, 0.0f) / nt[topic_index];
+      if (value < 1e-16) {
+        // Reset small values to 0.0 to avoid performance hit.
+        // http://en.wikipedia.org/wiki/Denormal_number#Performance_issues
+        // http://stackoverflow.com/questions/13964606/inconsistent-multiplication-performance-with-floats
+        value = 0.0f;
+      }
+    }
+
+    pwt_row[topic_index] = value;
+  }
+
+  if (dense_p_wt != nullptr) {
+    dense_p_wt->set_row(token_id, pwt_row);
+  } else {
+    for (int topic_index = 0; topic_index < topic_size; ++topic_index)
+      p_wt->set(token_id, topic_index, pwt_row[topic_index]);
+  }
+}
+
+static void FindPwtImpl(const PhiMatrix& n_wt, const PhiMatrix* r_wt, PhiMatrix* p_wt, ThreadPool* thread_pool) {
   const int topic_size = n_wt.topic_size();
   const int token_size = n_wt.token_size();
 
@@ -350,46 +571,67 @@ static void FindPwtImpl(const PhiMatrix& n_wt, const PhiMatrix* r_wt, PhiMatrix*
   assert((r_wt == nullptr) || (r_wt->token_size() == n_wt.token_size() && r_wt->topic_size() == n_wt.topic_size()));
   assert(p_wt->token_size() == n_wt.token_size() && p_wt->topic_size() == n_wt.topic_size());
 
-  std::map<ClassId, std::vector<float> > n_t = FindNormalizersImpl(n_wt, r_wt);
-  for (int token_id = 0; token_id < token_size; ++token_id) {
-    const Token& token = n_wt.token(token_id);
-    assert(r_wt == nullptr || r_wt->token(token_id) == token);
-    assert(p_wt->token(token_id) == token);
-    const std::vector<float>& nt = n_t[token.class_id];
-    for (int topic_index = 0; topic_index < topic_size; ++topic_index) {
-      if (nt[topic_index] <= 0)
-        continue;
-
-      float nwt_value = n_wt.get(token_id, topic_index);
-      float rwt_value = (r_wt == nullptr) ? 0.0f : r_wt->get(token_id, topic_index);
-      float value = std::max<float>(nwt_value + rwt_value, 0.0f) / nt[topic_index];
-      if (value < 1e-16) {
-        // Reset small values to 0.0 to avoid performance hit.
-        // http://en.wikipedia.org/wiki/Denormal_number#Performance_issues
-        // http://stackoverflow.com/questions/13964606/inconsistent-multiplication-performance-with-floats
-        value = 0.0f;
-      }
+  std::map<ClassId, std::vector<float> > n_t = FindNormalizersImpl(n_wt, r_wt, thread_pool);
+  DensePhiMatrix* dense_p_wt = dynamic_cast<DensePhiMatrix*>(p_wt);
 
-      p_wt->set(token_id, topic_index, value);
-    }
-  }
+  // Each token range writes its own rows of p_wt (which may be the same matrix as n_wt)
+  const int num_partitions = GetNumPartitions(thread_pool, token_size);
+  ParallelForTokens(thread_pool, token_size, num_partitions, [&](int begin, int end, int partition) {
+    std::vector<float> nwt_buffer, rwt_buffer, pwt_buffer;
+    for (int token_id = begin; token_id < end; ++token_id)
+      FindPwtRow(token_id, n_t, n_wt, r_wt, p_wt, dense_p_wt, &nwt_buffer, &rwt_buffer, &pwt_buffer);
+  });
 }
 
-std::map<ClassId, std::vector<float> > PhiMatrixOperations::FindNormalizers(const PhiMatrix& n_wt) {
-  return FindNormalizersImpl(n_wt, nullptr);
+std::map<ClassId, std::vector<float> > PhiMatrixOperations::FindNormalizers(const PhiMatrix& n_wt,
+                                                                            ThreadPool* thread_pool) {
+  return FindNormalizersImpl(n_wt, nullptr, thread_pool);
 }
 
 std::map<ClassId, std::vector<float> > PhiMatrixOperations::FindNormalizers(const PhiMatrix& n_wt,
-                                                                            const PhiMatrix& r_wt) {
-  return FindNormalizersImpl(n_wt, &r_wt);
+                                                                            const PhiMatrix& r_wt,
+                                                                            ThreadPool* thread_pool) {
+  return FindNormalizersImpl(n_wt, &r_wt, thread_pool);
 }
 
-void PhiMatrixOperations::FindPwt(const PhiMatrix& n_wt, PhiMatrix* p_wt) {
-  FindPwtImpl(n_wt, nullptr, p_wt);
+void PhiMatrixOperations::FindPwt(const PhiMatrix& n_wt, PhiMatrix* p_wt, ThreadPool* thread_pool) {
+  FindPwtImpl(n_wt, nullptr, p_wt, thread_pool);
 }
 
-void PhiMatrixOperations::FindPwt(const PhiMatrix& n_wt, const PhiMatrix& r_wt, PhiMatrix* p_wt) {
-  FindPwtImpl(n_wt, &r_wt, p_wt);
+void PhiMatrixOperations::FindPwt(const PhiMatrix& n_wt, const PhiMatrix& r_wt, PhiMatrix* p_wt,
+                                  ThreadPool* thread_pool) {
+  FindPwtImpl(n_wt, &r_wt, p_wt, thread_pool);
+}
+
+void PhiMatrixOperations::AddNormalizers(const PhiMatrix& n_wt, const std::vector<int>& token_ids, float weight,
+                                         std::map<ClassId, std::vector<float> >* n_t) {
+  const int topic_size = n_wt.topic_size();
+  std::vector<float> buffer;
+  for (int token_id : token_ids) {
+    const Token& token = n_wt.token(token_id);
+    auto iter = n_t->find(token.class_id);
+    if (iter == n_t->end())
+      iter = n_t->insert(std::make_pair(token.class_id, std::vector<float>(topic_size, 0))).first;
+
+    const float* values = n_wt.get_row(token_id, &buffer);
+    for (int topic_id = 0; topic_id < topic_size; ++topic_id) {
+      if (values[topic_id] > 0)
+        iter->second[topic_id] += weight * values[topic_id];
+    }
+  }
+}
+
+void PhiMatrixOperations::FindPwtRows(const PhiMatrix& n_wt, const std::map<ClassId, std::vector<float> >& n_t,
+                                      const std::vector<int>& token_ids, PhiMatrix* p_wt, ThreadPool* thread_pool) {
+  assert(p_wt->token_size() == n_wt.token_size() && p_wt->topic_size() == n_wt.topic_size());
+  const int size = static_cast<int>(token_ids.size());
+  DensePhiMatrix* dense_p_wt = dynamic_cast<DensePhiMatrix*>(p_wt);
+  const int num_partitions = GetNumPartitions(thread_pool, size);
+  ParallelForTokens(thread_pool, size, num_partitions, [&](int begin, int end, int partition) {
+    std::vector<float> nwt_buffer, pwt_buffer;
+    for (int i = begin; i < end; ++i)
+      FindPwtRow(token_ids[i], n_t, n_wt, nullptr, p_wt, dense_p_wt, &nwt_buffer, nullptr, &pwt_buffer);
+  });
 }
 
 bool PhiMatrixOperations::HasEqualShape(const PhiMatrix& first, const PhiMatrix& second) {
@@ -403,6 +645,9 @@ bool PhiMatrixOperations::HasEqualShape(const PhiMatrix& first, const PhiMatrix&
   if (first.token_size() != second.token_size())
     return false;
 
+  if (first.token_set_version() != 0 && first.token_set_version() == second.token_set_version())
+    return true;
+
   for (int i = 0; i < first.token_size(); ++i)
     if (first.token(i) != second.token(i))
       return false;
@@ -410,10 +655,24 @@ bool PhiMatrixOperations::HasEqualShape(const PhiMatrix& first, const PhiMatrix&
   return true;
 }
 
-void PhiMatrixOperations::AssignValue(float value, PhiMatrix* phi_matrix) {
-  for (int token_index = 0; token_index < phi_matrix->token_size(); token_index++)
-    for (int topic_index = 0; topic_index < phi_matrix->topic_size(); topic_index++)
-      phi_matrix->set(token_index, topic_index, value);
+void PhiMatrixOperations::AssignValue(float value, PhiMatrix* phi_matrix, ThreadPool* thread_pool) {
+  const int token_size = phi_matrix->token_size();
+  const int num_partitions = GetNumPartitions(thread_pool, token_size);
+  ParallelForTokens(thread_pool, token_size, num_partitions, [phi_matrix, value](int begin, int end, int partition) {
+    for (int token_index = begin; token_index < end; token_index++)
+      for (int topic_index = 0; topic_index < phi_matrix->topic_size(); topic_index++)
+        phi_matrix->set(token_index, topic_index, value);
+  });
+}
+
+void PhiMatrixOperations::MultiplyValue(float factor, PhiMatrix* phi_matrix, ThreadPool* thread_pool) {
+  const int token_size = phi_matrix->token_size();
+  const int num_partitions = GetNumPartitions(thread_pool, token_size);
+  ParallelForTokens(thread_pool, token_size, num_partitions, [phi_matrix, factor](int begin, int end, int partition) {
+    for (int token_index = begin; token_index < end; token_index++)
+      for (int topic_index = 0; topic_index < phi_matrix->topic_size(); topic_index++)
+        phi_matrix->set(token_index, topic_index, factor * phi_matrix->get(token_index, topic_index));
+  });
 }
 
 }  // namespace core
@@ -14,7 +14,11 @@
 namespace artm {
 namespace core {
 
+class ThreadPool;
+
 // PhiMatrixOperations contains helper methods to operate on PhiMatrix class.
+// Methods that take thread_pool split the tokens of large matrices between threads of the pool
+// (see Instance::thread_pool()); without the pool they run on the calling thread.
 class PhiMatrixOperations {
  public:
   // Extract protobuf message 'topic_model' from phi matrix
@@ -26,6 +30,13 @@ class PhiMatrixOperations {
   static void ApplyTopicModelOperation(
     const ::artm::TopicModel& topic_model, float apply_weight, bool add_missing_tokens, PhiMatrix* phi_matrix);
 
+  // Add 'source' scaled by 'apply_weight' to phi_matrix, matching tokens and topics by their names.
+  // Gives the same result as ApplyTopicModelOperation with the topic model retrieved from 'source',
+  // but works directly on the matrices (in place when both matrices have equal shape).
+  static void ApplyPhiMatrix(
+    const PhiMatrix& source, float apply_weight, bool add_missing_tokens, PhiMatrix* phi_matrix,
+    ThreadPool* thread_pool = nullptr);
+
   // Calculate phi matrix regularizers (r_wt)
   static void InvokePhiRegularizers(
     Instance* instance,
@@ -33,17 +44,31 @@ class PhiMatrixOperations {
     const PhiMatrix& p_wt, const PhiMatrix& n_wt, PhiMatrix* r_wt);
 
   // For each ClassId finds a sum of all n_wt values for each topic with (optionally) regularizers r_wt
-  static std::map<ClassId, std::vector<float> > FindNormalizers(const PhiMatrix& n_wt);
-  static std::map<ClassId, std::vector<float> > FindNormalizers(const PhiMatrix& n_wt, const PhiMatrix& r_wt);
+  static std::map<ClassId, std::vector<float> > FindNormalizers(const PhiMatrix& n_wt,
+                                                                ThreadPool* thread_pool = nullptr);
+  static std::map<ClassId, std::vector<float> > FindNormalizers(const PhiMatrix& n_wt, const PhiMatrix& r_wt,
+                                                                ThreadPool* thread_pool = nullptr);
 
   // Produce normalized p_wt matrix from counters n_wt and (optionaly) regularizers r_wt
-  static void FindPwt(const PhiMatrix& n_wt, PhiMatrix* p_wt);
-  static void FindPwt(const PhiMatrix& n_wt, const PhiMatrix& r_wt, PhiMatrix* p_wt);
+  static void FindPwt(const PhiMatrix& n_wt, PhiMatrix* p_wt, ThreadPool* thread_pool = nullptr);
+  static void FindPwt(const PhiMatrix& n_wt, const PhiMatrix& r_wt, PhiMatrix* p_wt,
+                      ThreadPool* thread_pool = nullptr);
+
+  // Adds 'weight' times the values from given rows of n_wt to normalizers n_t (same rules as in FindNormalizers).
+  // Allows to maintain n_t when only a few rows of n_wt change.
+  static void AddNormalizers(const PhiMatrix& n_wt, const std::vector<int>& token_ids, float weight,
+                             std::map<ClassId, std::vector<float> >* n_t);
+
+  // Recalculates given rows of p_wt (without regularizers) with normalizers n_t; other rows are not touched.
+  // n_t must contain all classes of the tokens.
+  static void FindPwtRows(const PhiMatrix& n_wt, const std::map<ClassId, std::vector<float> >& n_t,
+                          const std::vector<int>& token_ids, PhiMatrix* p_wt, ThreadPool* thread_pool = nullptr);
 
   // Checks whether two PhiMatrix instances has same set of tokens and topic names.
   // The order of the tokens and topics must also match.
   static bool HasEqualShape(const PhiMatrix& first, const PhiMatrix& second);
-  static void AssignValue(float value, PhiMatrix* phi_matrix);
+  static void AssignValue(float value, PhiMatrix* phi_matrix, ThreadPool* thread_pool = nullptr);
+  static void MultiplyValue(float factor, PhiMatrix* phi_matrix, ThreadPool* thread_pool = nullptr);
 };
 
 }  // namespace core
@@ -0,0 +1,108 @@
+// Copyright 2016, Additive Regularization of Topic Models.
+
+#include "artm/core/phi_matrix_pool.h"
+
+#include <algorithm>
+
+namespace artm {
+namespace core {
+
+static bool IsStorage(const PhiMatrixFrame& phi_matrix, PhiMatrixStorage storage) {
+  if (storage == PhiMatrixStorage_Contiguous)
+    return dynamic_cast<const ContiguousPhiMatrix*>(&phi_matrix) != nullptr;
+  return dynamic_cast<const DensePhiMatrix*>(&phi_matrix) != nullptr;
+}
+
+void PhiMatrixPool::set_max_size(int max_size) {
+  std::list<std::shared_ptr<PhiMatrixFrame>> released;
+  {
+    boost::lock_guard<boost::mutex> guard(lock_);
+    max_size_ = max_size;
+    while (static_cast<int>(matrices_.size()) > std::max(max_size_, 0)) {
+      released.push_back(matrices_.front());
+      matrices_.pop_front();
+    }
+  }
+
+  // Matrices are destroyed outside of the lock
+}
+
+int PhiMatrixPool::size() const {
+  boost::lock_guard<boost::mutex> guard(lock_);
+  return static_cast<int>(matrices_.size());
+}
+
+int64_t PhiMatrixPool::ByteSize() const {
+  boost::lock_guard<boost::mutex> guard(lock_);
+  int64_t retval = 0;
+  for (auto& phi_matrix : matrices_)
+    retval += phi_matrix->ByteSize();
+  return retval;
+}
+
+void PhiMatrixPool::Clear() {
+  std::list<std::shared_ptr<PhiMatrixFrame>> released;
+  {
+    boost::lock_guard<boost::mutex> guard(lock_);
+    released.swap(matrices_);
+  }
+
+  // Matrices are destroyed outside of the lock
+}
+
+std::shared_ptr<PhiMatrixFrame> PhiMatrixPool::Create(
+    PhiMatrixStorage storage, const ModelName& model_name,
+    const google::protobuf::RepeatedPtrField<std::string>& topic_name, const PhiMatrix& shape) {
+  std::shared_ptr<PhiMatrixFrame> retval;
+  {
+    boost::lock_guard<boost::mutex> guard(lock_);
+
+    // Prefer the matrix that already has the same tokens, and take the most recently released one otherwise
+    auto found = matrices_.end();
+    for (auto iter = matrices_.begin(); iter != matrices_.end(); ++iter) {
+      if ((*iter)->topic_size() != topic_name.size() || !IsStorage(**iter, storage))
+        continue;
+
+      found = iter;
+      if ((*iter)->token_set_version() == shape.token_set_version())
+        break;
+    }
+
+    if (found != matrices_.end()) {
+      retval = *found;
+      matrices_.erase(found);
+    }
+  }
+
+  if (retval == nullptr) {
+    retval = CreatePhiMatrix(storage, model_name, topic_name);
+  } else {
+    retval->set_model_name(model_name);
+    retval->set_locking(PhiMatrixLocking_Striped);
+    for (int topic_id = 0; topic_id < topic_name.size(); ++topic_id)
+      retval->set_topic_name(topic_id, topic_name.Get(topic_id));
+  }
+
+  retval->Reshape(shape);
+  return retval;
+}
+
+void PhiMatrixPool::Release(std::shared_ptr<PhiMatrix> phi_matrix) {
+  auto frame = std::dynamic_pointer_cast<PhiMatrixFrame>(phi_matrix);
+  if (frame == nullptr || !(IsStorage(*frame, PhiMatrixStorage_Packed) || IsStorage(*frame, PhiMatrixStorage_Contiguous)))
+    return;
+
+  std::shared_ptr<PhiMatrixFrame> dropped;
+  boost::lock_guard<boost::mutex> guard(lock_);
+  if (max_size_ <= 0)
+    return;
+
+  matrices_.push_back(frame);
+  if (static_cast<int>(matrices_.size()) > max_size_) {
+    dropped = matrices_.front();
+    matrices_.pop_front();
+  }
+}
+
+}  // namespace core
+}  // namespace artm
@@ -0,0 +1,56 @@
+// Copyright 2016, Additive Regularization of Topic Models.
+
+#ifndef SRC_ARTM_CORE_PHI_MATRIX_POOL_H_
+#define SRC_ARTM_CORE_PHI_MATRIX_POOL_H_
+
+#include <list>
+#include <memory>
+#include <string>
+
+#include "boost/thread/locks.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/utility.hpp"
+
+#include "artm/core/common.h"
+#include "artm/core/dense_phi_matrix.h"
+
+namespace artm {
+namespace core {
+
+// PhiMatrixPool keeps temporary phi matrices that are no longer used, so that their memory is reused for new
+// matrices instead of being returned to the allocator. This avoids allocating (and page-faulting) the whole r_wt
+// matrix on every iteration. New matrices share the token index with the matrix they are shaped after.
+// Only DensePhiMatrix and ContiguousPhiMatrix are pooled.
+class PhiMatrixPool : boost::noncopyable {
+ public:
+  PhiMatrixPool() : lock_(), max_size_(0), matrices_() {}
+
+  // Non-positive value disables the pool and releases all pooled matrices.
+  void set_max_size(int max_size);
+  int size() const;
+  int64_t ByteSize() const;
+
+  // Releases all pooled matrices, but keeps the pool enabled.
+  void Clear();
+
+  // Returns a matrix with given name and topics, the tokens of 'shape', all values set to zero,
+  // and default (striped) locking.
+  // A pooled matrix of the same storage and number of topics is reused when available.
+  std::shared_ptr<PhiMatrixFrame> Create(PhiMatrixStorage storage, const ModelName& model_name,
+                                         const google::protobuf::RepeatedPtrField<std::string>& topic_name,
+                                         const PhiMatrix& shape);
+
+  // Gives the matrix to the pool. The caller passes the ownership: the matrix must not be referenced
+  // (nor used later) anywhere else. When the pool is full the matrix released the longest time ago is dropped.
+  void Release(std::shared_ptr<PhiMatrix> phi_matrix);
+
+ private:
+  mutable boost::mutex lock_;
+  int max_size_;
+  std::list<std::shared_ptr<PhiMatrixFrame>> matrices_;
+};
+
+}  // namespace core
+}  // namespace artm
+
+#endif  // SRC_ARTM_CORE_PHI_MATRIX_POOL_H_
@@ -5,9 +5,12 @@
 #include <stdlib.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "boost/exception/diagnostic_information.hpp"
@@ -22,8 +25,11 @@
 #include "artm/score_calculator_interface.h"
 
 #include "artm/core/protobuf_helpers.h"
+#include "artm/core/batch_loader.h"
 #include "artm/core/call_on_destruction.h"
 #include "artm/core/cuckoo_watch.h"
+#include "artm/core/dense_phi_matrix.h"
+#include "artm/core/document_chunk_task.h"
 #include "artm/core/helpers.h"
 #include "artm/core/batch_manager.h"
 #include "artm/core/cache_manager.h"
@@ -31,6 +37,7 @@
 #include "artm/core/phi_matrix.h"
 #include "artm/core/phi_matrix_operations.h"
 #include "artm/core/instance.h"
+#include "artm/core/nwt_accumulator.h"
 
 #include "artm/utility/blas.h"
 
@@ -109,16 +116,15 @@ class NormalizeThetaAgent : public RegularizeThetaAgent {
 
 static void CreateThetaCacheEntry(ThetaMatrix* new_cache_entry_ptr,
                                   LocalThetaMatrix<float>* theta_matrix,
-                                  const Batch& batch,
+                                  const PreparedBatch& batch,
                                   const PhiMatrix& p_wt,
                                   const ProcessBatchesArgs& args) {
   if (new_cache_entry_ptr == nullptr) return;
 
   const int topic_size = p_wt.topic_size();
   for (int item_index = 0; item_index < batch.item_size(); ++item_index) {
-    const Item& item = batch.item(item_index);
-    new_cache_entry_ptr->add_item_id(item.id());
-    new_cache_entry_ptr->add_item_title(item.has_title() ? item.title() : std::string());
+    new_cache_entry_ptr->add_item_id(batch.item_id(item_index));
+    new_cache_entry_ptr->add_item_title(batch.item_title(item_index));
     FloatArray* cached_theta = new_cache_entry_ptr->add_item_weights();
   }
 
@@ -130,16 +136,18 @@ static void CreateThetaCacheEntry(ThetaMatrix* new_cache_entry_ptr,
     }
   } else {
     new_cache_entry_ptr->clear_topic_name();
+    std::vector<float> phi_buffer;
     for (int token_index = 0; token_index < p_wt.token_size(); token_index++) {
       const Token& token = p_wt.token(token_index);
       if (token.class_id != args.predict_class_id())
         continue;
 
       new_cache_entry_ptr->add_topic_name(token.keyword);
+      const float* phi_row = p_wt.get_row(token_index, &phi_buffer);
       for (int item_index = 0; item_index < batch.item_size(); ++item_index) {
         float weight = 0.0;
         for (int topic_index = 0; topic_index < topic_size; ++topic_index)
-          weight += (*theta_matrix)(topic_index, item_index) * p_wt.get(token_index, topic_index);
+          weight += (*theta_matrix)(topic_index, item_index) * phi_row[topic_index];
         new_cache_entry_ptr->mutable_item_weights(item_index)->add_value(weight);
       }
     }
@@ -148,15 +156,16 @@ static void CreateThetaCacheEntry(ThetaMatrix* new_cache_entry_ptr,
 
 static void CreatePtdwCacheEntry(ThetaMatrix* new_cache_entry_ptr,
                                  LocalPhiMatrix<float>* ptdw_matrix,
-                                 const Batch& batch,
+                                 const PreparedBatch& batch,
                                  int item_index,
                                  int topic_size) {
   if (new_cache_entry_ptr == nullptr) return;
 
-  const Item& item = batch.item(item_index);
+  const int item_id = batch.item_id(item_index);
+  const std::string item_title = batch.item_title(item_index);
   for (int token_index = 0; token_index < ptdw_matrix->num_tokens(); ++token_index) {
-    new_cache_entry_ptr->add_item_id(item.id());
-    new_cache_entry_ptr->add_item_title(item.has_title() ? item.title() : std::string());
+    new_cache_entry_ptr->add_item_id(item_id);
+    new_cache_entry_ptr->add_item_title(item_title);
     auto non_zero_topic_values = new_cache_entry_ptr->add_item_weights();
     auto non_zero_topic_indices = new_cache_entry_ptr->add_topic_indices();
 
@@ -191,6 +200,52 @@ class PhiMatrixWriter : public NwtWriteAdapter {
   PhiMatrix* n_wt_;
 };
 
+class NwtBufferWriter : public NwtWriteAdapter {
+ public:
+  explicit NwtBufferWriter(NwtBuffer* buffer) : buffer_(buffer) {}
+
+  virtual void Store(int batch_token_id, int pwt_token_id, const std::vector<float>& nwt_vector) {
+    buffer_->Add(pwt_token_id, nwt_vector);
+  }
+
+ private:
+  NwtBuffer* buffer_;
+};
+
+// Keeps rows stored by one chunk of tokens (see RunInChunks) until they are flushed to the actual writer,
+// so that chunks processed by several threads do not have to synchronize on each row.
+class NwtChunkWriter : public NwtWriteAdapter {
+ public:
+  NwtChunkWriter() : batch_token_id_(), pwt_token_id_(), values_() {}
+
+  virtual void Store(int batch_token_id, int pwt_token_id, const std::vector<float>& nwt_vector) {
+    batch_token_id_.push_back(batch_token_id);
+    pwt_token_id_.push_back(pwt_token_id);
+    values_.insert(values_.end(), nwt_vector.begin(), nwt_vector.end());
+  }
+
+  void FlushTo(NwtWriteAdapter* target) {
+    if (batch_token_id_.empty())
+      return;
+
+    const int topic_size = static_cast<int>(values_.size() / batch_token_id_.size());
+    std::vector<float> row(topic_size);
+    for (int i = 0; i < static_cast<int>(batch_token_id_.size()); ++i) {
+      std::copy(values_.begin() + i * topic_size, values_.begin() + (i + 1) * topic_size, row.begin());
+      target->Store(batch_token_id_[i], pwt_token_id_[i], row);
+    }
+
+    batch_token_id_.clear();
+    pwt_token_id_.clear();
+    values_.clear();
+  }
+
+ private:
+  std::vector<int> batch_token_id_;
+  std::vector<int> pwt_token_id_;
+  std::vector<float> values_;
+};
+
 Processor::Processor(Instance* instance)
     : instance_(instance),
       is_stopping(false),
@@ -203,43 +258,56 @@ Processor::Processor(Instance* instance)
 
 Processor::~Processor() {
   is_stopping = true;
+  instance_->processor_queue()->notify_all();
   if (thread_.joinable()) {
     thread_.join();
   }
 }
 
 static std::shared_ptr<LocalThetaMatrix<float>>
-InitializeTheta(int topic_size, const Batch& batch, const ProcessBatchesArgs& args, const ThetaMatrix* cache) {
+InitializeTheta(int topic_size, const PreparedBatch& batch, const ProcessBatchesArgs& args,
+                const ThetaCacheEntry* cache) {
   auto Theta = std::make_shared<LocalThetaMatrix<float>>(topic_size, batch.item_size());
 
   Theta->InitializeZeros();
 
+  // Typically the batch has the same items in the same order as its cache entry, so position is checked first,
+  // and the hash index is only built when the items do not match
+  std::unordered_map<int, int> cache_item_index;
   for (int item_index = 0; item_index < batch.item_size(); ++item_index) {
     int index_of_item = -1;
     if ((cache != nullptr) && args.reuse_theta()) {
-      index_of_item = repeated_field_index_of(cache->item_id(),
-        batch.item(item_index).id());
+      const int item_id = batch.item_id(item_index);
+      if (item_index < cache->item_size() && cache->item_id(item_index) == item_id) {
+        index_of_item = item_index;
+      } else {
+        if (cache_item_index.empty()) {
+          for (int i = 0; i < cache->item_size(); ++i)
+            cache_item_index.insert(std::make_pair(cache->item_id(i), i));
+        }
+
+        auto iter = cache_item_index.find(item_id);
+        if (iter != cache_item_index.end())
+          index_of_item = iter->second;
+      }
     }
 
-    if ((index_of_item != -1) && args.reuse_theta()) {
-      const FloatArray& old_thetas = cache->item_weights(index_of_item);
-      for (int topic_index = 0; topic_index < topic_size; ++topic_index) {
-        (*Theta)(topic_index, item_index) = old_thetas.value(topic_index);
+    // Theta is stored by items, so the weights of an item are copied as one contiguous block
+    if ((index_of_item != -1) && cache->CopyItemWeights(index_of_item, topic_size, &(*Theta)(0, item_index)))
+      continue;
+
+    if (args.use_random_theta()) {
+      size_t seed = 0;
+      boost::hash_combine(seed, std::hash<std::string>()(batch.batch_id()));
+      boost::hash_combine(seed, std::hash<int>()(item_index));
+      std::vector<float> theta_values = Helpers::GenerateRandomVector(topic_size, seed);
+      for (int iTopic = 0; iTopic < topic_size; ++iTopic) {
+        (*Theta)(iTopic, item_index) = theta_values[iTopic];
       }
     } else {
-      if (args.use_random_theta()) {
-        size_t seed = 0;
-        boost::hash_combine(seed, std::hash<std::string>()(batch.id()));
-        boost::hash_combine(seed, std::hash<int>()(item_index));
-        std::vector<float> theta_values = Helpers::GenerateRandomVector(topic_size, seed);
-        for (int iTopic = 0; iTopic < topic_size; ++iTopic) {
-          (*Theta)(iTopic, item_index) = theta_values[iTopic];
-        }
-      } else {
-        const float default_theta = 1.0f / topic_size;
-        for (int iTopic = 0; iTopic < topic_size; ++iTopic) {
-          (*Theta)(iTopic, item_index) = default_theta;
-        }
+      const float default_theta = 1.0f / topic_size;
+      for (int iTopic = 0; iTopic < topic_size; ++iTopic) {
+        (*Theta)(iTopic, item_index) = default_theta;
       }
     }
   }
@@ -248,20 +316,20 @@ InitializeTheta(int topic_size, const Batch& batch, const ProcessBatchesArgs& ar
 }
 
 static std::shared_ptr<LocalPhiMatrix<float>>
-InitializePhi(const Batch& batch,
+InitializePhi(const PreparedBatch& batch, const std::vector<int>& token_id,
               const ::artm::core::PhiMatrix& p_wt) {
   bool phi_is_empty = true;
   int topic_size = p_wt.topic_size();
   auto phi_matrix = std::make_shared<LocalPhiMatrix<float>>(batch.token_size(), topic_size);
   phi_matrix->InitializeZeros();
+  std::vector<float> phi_buffer;
   for (int token_index = 0; token_index < batch.token_size(); ++token_index) {
-    Token token = Token(batch.class_id(token_index), batch.token(token_index));
-
-    int p_wt_token_index = p_wt.token_index(token);
+    int p_wt_token_index = token_id[token_index];
     if (p_wt_token_index != ::artm::core::PhiMatrix::kUndefIndex) {
       phi_is_empty = false;
+      const float* phi_row = p_wt.get_row(p_wt_token_index, &phi_buffer);
       for (int topic_index = 0; topic_index < topic_size; ++topic_index) {
-        float value = p_wt.get(p_wt_token_index, topic_index);
+        float value = phi_row[topic_index];
         if (value < kProcessorEps) {
           // Reset small values to 0.0 to avoid performance hit.
           // http://en.wikipedia.org/wiki/Denormal_number#Performance_issues
@@ -280,7 +348,7 @@ InitializePhi(const Batch& batch,
 }
 
 static void
-CreateRegularizerAgents(const Batch& batch, const ProcessBatchesArgs& args, Instance* instance,
+CreateRegularizerAgents(const PreparedBatch& batch, const ProcessBatchesArgs& args, Instance* instance,
                         RegularizeThetaAgentCollection* theta_agents, RegularizePtdwAgentCollection* ptdw_agents) {
   for (int reg_index = 0; reg_index < args.regularizer_name_size(); ++reg_index) {
     auto& reg_name = args.regularizer_name(reg_index);
@@ -292,79 +360,158 @@ CreateRegularizerAgents(const Batch& batch, const ProcessBatchesArgs& args, Inst
     }
 
     if (theta_agents != nullptr)
-      theta_agents->AddAgent(regularizer->CreateRegularizeThetaAgent(batch, args, tau));
+      theta_agents->AddAgent(regularizer->CreateRegularizeThetaAgent(batch.batch(), args, tau));
 
     if (ptdw_agents != nullptr)
-      ptdw_agents->AddAgent(regularizer->CreateRegularizePtdwAgent(batch, args, tau));
+      ptdw_agents->AddAgent(regularizer->CreateRegularizePtdwAgent(batch.batch(), args, tau));
   }
 
   if (theta_agents != nullptr)
     theta_agents->AddAgent(std::make_shared<NormalizeThetaAgent>());
 }
 
-static std::shared_ptr<CsrMatrix<float>>
-InitializeSparseNdw(const Batch& batch, const ProcessBatchesArgs& args) {
-  std::vector<float> n_dw_val;
-  std::vector<int> n_dw_row_ptr;
-  std::vector<int> n_dw_col_ind;
-
-  bool use_classes = false;
-  std::map<ClassId, float> class_id_to_weight;
-  if (args.class_id_size() != 0) {
-    use_classes = true;
-    for (int i = 0; i < args.class_id_size(); ++i) {
-      class_id_to_weight.insert(std::make_pair(args.class_id(i), args.class_weight(i)));
+// Calls function(begin, end) for chunks of [0, size) with at most chunk_size elements each.
+// If other processors are idle (the processor queue is empty) they are invited to steal chunks,
+// otherwise all chunks are executed by the calling thread. Non-positive chunk_size disables chunking.
+static void RunInChunks(Instance* instance, int size, int chunk_size, const DocumentChunkTask::Function& function) {
+  const int num_processors = (instance == nullptr) ? 1 : static_cast<int>(instance->processor_size());
+  if (chunk_size <= 0 || size <= chunk_size || num_processors <= 1 || !instance->processor_queue()->empty()) {
+    function(0, size);
+    return;
+  }
+
+  auto task = std::make_shared<DocumentChunkTask>(size, chunk_size, function);
+  const int num_helpers = std::min(task->num_chunks(), num_processors) - 1;
+  for (int i = 0; i < num_helpers; ++i) {
+    auto helper_input = std::make_shared<ProcessorInput>();
+    helper_input->set_document_chunk_task(task);
+    instance->processor_queue()->push(helper_input);
+  }
+
+  task->Run();
+  task->Wait();
+}
+
+// Selects top_k topics with largest theta values into active (sorted by topic index),
+// and zeroes out all other topics of the theta column.
+static void SelectActiveTopics(int num_topics, int top_k, float* theta_ptr, std::vector<int>* order, int* active) {
+  order->resize(num_topics);
+  for (int k = 0; k < num_topics; ++k)
+    (*order)[k] = k;
+  std::nth_element(order->begin(), order->begin() + top_k, order->end(),
+                   [theta_ptr](int lhs, int rhs) { return theta_ptr[lhs] > theta_ptr[rhs]; });  // NOLINT
+  std::sort(order->begin(), order->begin() + top_k);
+  std::copy(order->begin(), order->begin() + top_k, active);
+}
+
+// Keeps only active topics in a theta column and renormalizes them to sum up to one.
+// Needed because regularizer agents operate on the full column and might assign weight to inactive topics.
+static void KeepActiveTopics(int num_topics, int top_k, const int* active, float* theta_ptr) {
+  float sum = 0.0f;
+  for (int j = 0; j < top_k; ++j)
+    sum += theta_ptr[active[j]];
+
+  int j = 0;
+  for (int k = 0; k < num_topics; ++k) {
+    if (j < top_k && active[j] == k) {
+      if (sum > 0.0f)
+        theta_ptr[k] /= sum;
+      j++;
+    } else {
+      theta_ptr[k] = 0.0f;
     }
   }
+}
 
-  // For sparse case
-  for (int item_index = 0; item_index < batch.item_size(); ++item_index) {
-    n_dw_row_ptr.push_back(static_cast<int>(n_dw_val.size()));
-    const Item& item = batch.item(item_index);
-    for (int token_index = 0; token_index < item.token_id_size(); ++token_index) {
-      int token_id = item.token_id(token_index);
-
-      float class_weight = 1.0f;
-      if (use_classes) {
-        ClassId class_id = batch.class_id(token_id);
-        auto iter = class_id_to_weight.find(class_id);
-        class_weight = (iter == class_id_to_weight.end()) ? 0.0f : iter->second;
-      }
+// Non-zero elements of p_wt rows for the tokens of a batch, in CSR layout (one row per batch token).
+// Only rows with density (the fraction of non-zero topics) of at most max_density are collected;
+// other rows are left empty and keep using dense kernels from blas. Zero max_density marks all rows dense.
+struct SparsePhiRows {
+  std::vector<char> is_sparse;
+  std::vector<int> row_ptr;
+  std::vector<int> topic_index;
+  std::vector<float> value;
+};
 
-      const float token_weight = item.token_weight(token_index);
-      n_dw_val.push_back(class_weight * token_weight);
-      n_dw_col_ind.push_back(token_id);
+static void FindSparsePhiRows(const std::vector<int>& token_id, const ::artm::core::PhiMatrix& p_wt,
+                              float max_density, SparsePhiRows* rows) {
+  const int tokens_count = static_cast<int>(token_id.size());
+  const int max_nonzero_size = static_cast<int>(max_density * p_wt.topic_size());
+  rows->is_sparse.assign(tokens_count, 0);
+  rows->row_ptr.assign(tokens_count + 1, 0);
+  rows->topic_index.clear();
+  rows->value.clear();
+  if (max_nonzero_size <= 0)
+    return;
+
+  for (int w = 0; w < tokens_count; ++w) {
+    rows->row_ptr[w + 1] = rows->row_ptr[w];
+    if (token_id[w] == ::artm::core::PhiMatrix::kUndefIndex)
+      continue;
+
+    const int nonzero_size = p_wt.get_nonzeros(token_id[w], &rows->topic_index, &rows->value);
+    if (nonzero_size > max_nonzero_size) {
+      rows->topic_index.resize(rows->row_ptr[w]);
+      rows->value.resize(rows->row_ptr[w]);
+      continue;
     }
+
+    rows->is_sparse[w] = 1;
+    rows->row_ptr[w + 1] += nonzero_size;
   }
+}
 
-  n_dw_row_ptr.push_back(static_cast<int>(n_dw_val.size()));
-  return std::make_shared<CsrMatrix<float>>(batch.token_size(), &n_dw_val, &n_dw_row_ptr, &n_dw_col_ind);
+// Sparse version of Blas::sdotaxpy for a vector x, given by its non-zero elements x[j] at positions index[j]:
+// p = <x, y>; if p != 0 then z += (numerator / p) * x. Returns p.
+static float SparseDotAxpy(int nonzero_size, float numerator, const int* index, const float* x,
+                           const float* y, float* z) {
+  float p = 0.0f;
+  for (int j = 0; j < nonzero_size; ++j)
+    p += x[j] * y[index[j]];
+  if (p == 0.0f)
+    return p;
+
+  const float alpha = numerator / p;
+  for (int j = 0; j < nonzero_size; ++j)
+    z[index[j]] += alpha * x[j];
+  return p;
 }
 
 static void
-InferThetaAndUpdateNwtSparse(const ProcessBatchesArgs& args, const Batch& batch, float batch_weight,
-                             const CsrMatrix<float>& sparse_ndw,
+InferThetaAndUpdateNwtSparse(const ProcessBatchesArgs& args, const PreparedBatch& batch, float batch_weight,
+                             const CsrMatrix<float>& sparse_ndw, const std::vector<int>& token_id,
                              const ::artm::core::PhiMatrix& p_wt,
                              const RegularizeThetaAgentCollection& theta_agents,
                              LocalThetaMatrix<float>* theta_matrix,
-                             NwtWriteAdapter* nwt_writer, util::Blas* blas,
+                             NwtWriteAdapter* nwt_writer, util::Blas* blas, Instance* instance,
+                             int64_t* document_passes, std::vector<float>* p_dw,
                              ThetaMatrix* new_cache_entry_ptr = nullptr) {
   LocalThetaMatrix<float> n_td(theta_matrix->num_topics(), theta_matrix->num_items());
   const int num_topics = p_wt.topic_size();
   const int docs_count = theta_matrix->num_items();
   const int tokens_count = batch.token_size();
-
-  std::vector<int> token_id(batch.token_size(), -1);
-  for (int token_index = 0; token_index < batch.token_size(); ++token_index)
-    token_id[token_index] = p_wt.token_index(Token(batch.class_id(token_index), batch.token(token_index)));
+  const float tolerance = args.theta_convergence_tolerance();
+
+  // With num_active_topics each document keeps only top_k topics after the first (warm-up) pass.
+  // active_topics stores the list of active topics for documents where this has happened.
+  const int top_k = (args.opt_for_avx() && args.num_active_topics() > 0 && args.num_active_topics() < num_topics &&
+                     args.num_document_passes() > 1) ? args.num_active_topics() : 0;
+  std::vector<int> active_topics(static_cast<size_t>(docs_count) * top_k);
+  std::vector<char> has_active_topics(top_k > 0 ? docs_count : 0, 0);
+
+  // Sparse rows of p_wt are processed by kernels that iterate only over their non-zero topics.
+  // In the top_k mode the E-step still reads such rows in dense form, because active topics are gathered from them.
+  // Rows are only gathered when a kernel that uses them will run (the E-step below, or the n_wt update);
+  // otherwise all rows are marked dense, and p_wt is not scanned.
+  const bool use_sparse_phi = (args.opt_for_avx() && top_k == 0) || (nwt_writer != nullptr);
+  SparsePhiRows sparse_phi;
+  FindSparsePhiRows(token_id, p_wt, use_sparse_phi ? args.sparse_phi_max_density() : 0.0f, &sparse_phi);
 
   if (args.opt_for_avx()) {
   // This version is about 40% faster than the second alternative below.
-  // Both versions return 100% equal results.
-  // Speedup is due to several factors:
-  // 1. explicit loops instead of blas->saxpy and blas->sdot
-  //    makes compiler generate AVX instructions (vectorized 128-bit float-point operations)
-  // 2. better memory usage (reduced bandwith to DRAM and more sequential accesss)
+  // Both versions return equal results (up to float rounding).
+  // Speedup is due to better memory usage (reduced bandwith to DRAM and more sequential accesss).
+  // Both versions use SIMD kernels from blas, selected at runtime for the host CPU.
 
   int max_local_token_size = 0;  // find the longest document from the batch
   for (int d = 0; d < docs_count; ++d) {
@@ -373,55 +520,122 @@ InferThetaAndUpdateNwtSparse(const ProcessBatchesArgs& args, const Batch& batch,
     const int local_token_size = end_index - begin_index;
     max_local_token_size = std::max(max_local_token_size, local_token_size);
   }
-  LocalPhiMatrix<float> local_phi(max_local_token_size, num_topics);
-  LocalThetaMatrix<float> r_td(num_topics, 1);
-  std::vector<float> helper_vector(num_topics, 0.0f);
+  const std::vector<float> zero_row(num_topics, 0.0f);
+  std::atomic<int64_t> total_passes(0);
+
+  // Documents are independent, so chunks of documents can be processed by several processors.
+  // Each document writes only to its own columns of theta_matrix and n_td.
+  RunInChunks(instance, docs_count, args.document_chunk_size(), [&](int begin_doc, int end_doc) {  // NOLINT
+    // Rows of p_wt are read in place whenever possible (see PhiMatrix::get_row);
+    // row_buffers are only used by phi matrices that can not expose their rows (e.g. packed rows).
+    std::vector<const float*> phi_rows(max_local_token_size, nullptr);
+    std::vector<std::vector<float>> row_buffers(max_local_token_size);
+    LocalThetaMatrix<float> r_td(num_topics, 1);
+    std::vector<float> theta_prev(tolerance > 0 ? num_topics : 0);
+    int64_t chunk_passes = 0;
+
+    // Buffers for the top_k mode: values of theta, n_td and phi rows restricted to the active topics
+    std::vector<int> topic_order;
+    std::vector<float> theta_active(top_k), ntd_active(top_k);
+    std::vector<float> phi_active(static_cast<size_t>(max_local_token_size) * top_k);
+
+    for (int d = begin_doc; d < end_doc; ++d) {
+      float* ntd_ptr = &n_td(0, d);
+      float* theta_ptr = &(*theta_matrix)(0, d);  // NOLINT
+
+      const int begin_index = sparse_ndw.row_ptr()[d];
+      const int end_index = sparse_ndw.row_ptr()[d + 1];
+      bool item_has_tokens = false;
+      for (int i = begin_index; i < end_index; ++i) {
+        int w = sparse_ndw.col_ind()[i];
+        if (token_id[w] == ::artm::core::PhiMatrix::kUndefIndex) {
+          phi_rows[i - begin_index] = &zero_row[0];
+          continue;
+        }
 
-  for (int d = 0; d < docs_count; ++d) {
-    float* ntd_ptr = &n_td(0, d);
-    float* theta_ptr = &(*theta_matrix)(0, d);  // NOLINT
+        item_has_tokens = true;
+        phi_rows[i - begin_index] = (top_k == 0 && sparse_phi.is_sparse[w]) ?
+          nullptr : p_wt.get_row(token_id[w], &row_buffers[i - begin_index]);
+      }
 
-    const int begin_index = sparse_ndw.row_ptr()[d];
-    const int end_index = sparse_ndw.row_ptr()[d + 1];
-    local_phi.InitializeZeros();
-    bool item_has_tokens = false;
-    for (int i = begin_index; i < end_index; ++i) {
-      int w = sparse_ndw.col_ind()[i];
-      if (token_id[w] == ::artm::core::PhiMatrix::kUndefIndex) continue;
-      item_has_tokens = true;
-      float* local_phi_ptr = &local_phi(i - begin_index, 0);
-      p_wt.get(token_id[w], &helper_vector);
-      for (int k = 0; k < num_topics; ++k) local_phi_ptr[k] = helper_vector[k];
-    }
+      if (!item_has_tokens) continue;  // continue to the next item
 
-    if (!item_has_tokens) continue;  // continue to the next item
+      int* active = nullptr;  // set once the document switches to its top_k topics
+      for (int inner_iter = 0; inner_iter < args.num_document_passes(); ++inner_iter) {
+        chunk_passes++;
+        if (tolerance > 0)
+          std::copy(theta_ptr, theta_ptr + num_topics, theta_prev.begin());
 
-    for (int inner_iter = 0; inner_iter < args.num_document_passes(); ++inner_iter) {
-      for (int k = 0; k < num_topics; ++k)
-        ntd_ptr[k] = 0.0f;
+        if (active == nullptr) {
+          for (int k = 0; k < num_topics; ++k)
+            ntd_ptr[k] = 0.0f;
 
-      for (int i = begin_index; i < end_index; ++i) {
-        const float* phi_ptr = &local_phi(i - begin_index, 0);
+          for (int i = begin_index; i < end_index; ++i) {
+            const float* phi_ptr = phi_rows[i - begin_index];
+            if (phi_ptr != nullptr) {
+              blas->sdotaxpy(num_topics, sparse_ndw.val()[i], phi_ptr, theta_ptr, ntd_ptr);
+            } else {
+              const int w = sparse_ndw.col_ind()[i];
+              const int begin = sparse_phi.row_ptr[w];
+              SparseDotAxpy(sparse_phi.row_ptr[w + 1] - begin, sparse_ndw.val()[i],
+                            sparse_phi.topic_index.data() + begin, sparse_phi.value.data() + begin,
+                            theta_ptr, ntd_ptr);
+            }
+          }
 
-        float p_dw_val = 0;
-        for (int k = 0; k < num_topics; ++k)
-          p_dw_val += phi_ptr[k] * theta_ptr[k];
-        if (p_dw_val == 0) continue;
+          blas->svmul(num_topics, ntd_ptr, theta_ptr);
+        } else {
+          for (int j = 0; j < top_k; ++j) {
+            theta_active[j] = theta_ptr[active[j]];
+            ntd_active[j] = 0.0f;
+          }
 
-        const float alpha = sparse_ndw.val()[i] / p_dw_val;
-        for (int k = 0; k < num_topics; ++k)
-          ntd_ptr[k] += alpha * phi_ptr[k];
-      }
+          for (int i = begin_index; i < end_index; ++i) {
+            const float* phi_ptr = &phi_active[static_cast<size_t>(i - begin_index) * top_k];
+            blas->sdotaxpy(top_k, sparse_ndw.val()[i], phi_ptr, &theta_active[0], &ntd_active[0]);
+          }
+
+          blas->svmul(top_k, &ntd_active[0], &theta_active[0]);
+          for (int j = 0; j < top_k; ++j)
+            theta_ptr[active[j]] = theta_active[j];
+        }
 
-      for (int k = 0; k < num_topics; ++k)
-        theta_ptr[k] *= ntd_ptr[k];
+        r_td.InitializeZeros();
+        theta_agents.Apply(d, inner_iter, num_topics, theta_ptr, r_td.get_data());
 
-      r_td.InitializeZeros();
-      theta_agents.Apply(d, inner_iter, num_topics, theta_ptr, r_td.get_data());
+        if (active != nullptr) {
+          KeepActiveTopics(num_topics, top_k, active, theta_ptr);
+        } else if (top_k > 0) {
+          // The warm-up pass is over: restrict the document to its top_k topics,
+          // and gather the corresponding values of phi rows into a compact buffer.
+          active = &active_topics[static_cast<size_t>(d) * top_k];
+          SelectActiveTopics(num_topics, top_k, theta_ptr, &topic_order, active);
+          KeepActiveTopics(num_topics, top_k, active, theta_ptr);
+          for (int i = begin_index; i < end_index; ++i) {
+            const float* phi_ptr = phi_rows[i - begin_index];
+            float* phi_active_ptr = &phi_active[static_cast<size_t>(i - begin_index) * top_k];
+            for (int j = 0; j < top_k; ++j)
+              phi_active_ptr[j] = phi_ptr[active[j]];
+          }
+          has_active_topics[d] = 1;
+        }
+
+        if (tolerance > 0) {
+          // Stop iterating this document once L1 change of its theta column falls below tolerance.
+          // Remaining passes are skipped entirely, so agents never see a gap in inner_iter.
+          float change = 0.0f;
+          for (int k = 0; k < num_topics; ++k)
+            change += std::fabs(theta_ptr[k] - theta_prev[k]);
+          if (change < tolerance)
+            break;
+        }
+      }
     }
-  }
+    total_passes += chunk_passes;
+  });
+  *document_passes += total_passes;
   } else {
-  std::shared_ptr<LocalPhiMatrix<float>> phi_matrix_ptr = InitializePhi(batch, p_wt);
+  std::shared_ptr<LocalPhiMatrix<float>> phi_matrix_ptr = InitializePhi(batch, token_id, p_wt);
   if (phi_matrix_ptr == nullptr) return;
   const LocalPhiMatrix<float>& phi_matrix = *phi_matrix_ptr;
   for (int inner_iter = 0; inner_iter < args.num_document_passes(); ++inner_iter) {
@@ -432,17 +646,17 @@ InferThetaAndUpdateNwtSparse(const ProcessBatchesArgs& args, const Batch& batch,
     for (int d = 0; d < docs_count; ++d) {
       for (int i = sparse_ndw.row_ptr()[d]; i < sparse_ndw.row_ptr()[d + 1]; ++i) {
         int w = sparse_ndw.col_ind()[i];
-        float p_dw_val = blas->sdot(num_topics, &phi_matrix(w, 0), 1, &(*theta_matrix)(0, d), 1);  // NOLINT
-        if (p_dw_val == 0) continue;
-        blas->saxpy(num_topics, sparse_ndw.val()[i] / p_dw_val, &phi_matrix(w, 0), 1, &helper_td(0, d), 1);
+        blas->sdotaxpy(num_topics, sparse_ndw.val()[i],
+                       &phi_matrix(w, 0), &(*theta_matrix)(0, d), &helper_td(0, d));  // NOLINT
       }
     }
 
-    AssignDenseMatrixByProduct(*theta_matrix, helper_td, theta_matrix);
+    blas->svmul(theta_matrix->size(), helper_td.get_data(), theta_matrix->get_data());
 
     helper_td.InitializeZeros();  // from now this represents r_td
     theta_agents.Apply(inner_iter, *theta_matrix, &helper_td);
   }
+  *document_passes += static_cast<int64_t>(docs_count) * args.num_document_passes();
   }
 
   CreateThetaCacheEntry(new_cache_entry_ptr, theta_matrix, batch, p_wt, args);
@@ -453,34 +667,103 @@ InferThetaAndUpdateNwtSparse(const ProcessBatchesArgs& args, const Batch& batch,
   CsrMatrix<float> sparse_nwd(sparse_ndw);
   sparse_nwd.Transpose(blas);
 
-  std::vector<float> p_wt_local(num_topics, 0.0f);
-  std::vector<float> n_wt_local(num_topics, 0.0f);
-  for (int w = 0; w < tokens_count; ++w) {
-    if (token_id[w] == -1) continue;
-    p_wt.get(token_id[w], &p_wt_local);
-
-    for (int i = sparse_nwd.row_ptr()[w]; i < sparse_nwd.row_ptr()[w + 1]; ++i) {
-      int d = sparse_nwd.col_ind()[i];
-      float p_wd_val = blas->sdot(num_topics, &p_wt_local[0], 1, &(*theta_matrix)(0, d), 1);  // NOLINT
-      if (p_wd_val == 0) continue;
-      blas->saxpy(num_topics, sparse_nwd.val()[i] / p_wd_val,
-        &(*theta_matrix)(0, d), 1, &n_wt_local[0], 1);  // NOLINT
-    }
-
+  // p(w|d) for the final theta is a by-product of the n_wt update; keep it for fused scores (see ProcessedBatch)
+  std::vector<float> p_dw_nwd;
+  if (p_dw != nullptr)
+    p_dw_nwd.assign(sparse_nwd.nnz(), 0.0f);
+
+  // Each token produces exactly one row of n_wt increments, so chunks of tokens are also independent.
+  // Chunks that run in parallel keep their rows in private buffers, which are stored to nwt_writer
+  // by this thread once all chunks are done, in the order of chunks.
+  const int chunk_size = std::max(args.document_chunk_size(), 1);
+  const int num_chunks = (args.document_chunk_size() > 0) ? (tokens_count + chunk_size - 1) / chunk_size : 0;
+  std::vector<NwtChunkWriter> chunk_writers(num_chunks);
+  RunInChunks(instance, tokens_count, args.document_chunk_size(), [&](int begin_token, int end_token) {  // NOLINT
+    NwtWriteAdapter* writer = (end_token - begin_token == tokens_count) ? nwt_writer
+                                                                        : &chunk_writers[begin_token / chunk_size];
+    std::vector<float> p_wt_buffer;
+    std::vector<float> n_wt_local(num_topics, 0.0f);
     std::vector<float> values(num_topics, 0.0f);
-    for (int topic_index = 0; topic_index < num_topics; ++topic_index) {
-      values[topic_index] = p_wt_local[topic_index] * n_wt_local[topic_index];
-      n_wt_local[topic_index] = 0.0f;
+    for (int w = begin_token; w < end_token; ++w) {
+      if (token_id[w] == -1) continue;
+      if (sparse_phi.is_sparse[w]) {
+        // Only non-zero topics of p(w|t) contribute to p(w|d) and to n_wt increments of the token
+        const int nonzero_size = sparse_phi.row_ptr[w + 1] - sparse_phi.row_ptr[w];
+        const int* topic_index = sparse_phi.topic_index.data() + sparse_phi.row_ptr[w];
+        const float* phi_value = sparse_phi.value.data() + sparse_phi.row_ptr[w];
+        for (int i = sparse_nwd.row_ptr()[w]; i < sparse_nwd.row_ptr()[w + 1]; ++i) {
+          const float* theta_ptr = &(*theta_matrix)(0, sparse_nwd.col_ind()[i]);  // NOLINT
+          float p = 0.0f;
+          for (int j = 0; j < nonzero_size; ++j)
+            p += theta_ptr[topic_index[j]] * phi_value[j];
+          if (p_dw != nullptr) p_dw_nwd[i] = p;
+          if (p == 0.0f) continue;
+
+          const float alpha = sparse_nwd.val()[i] / p;
+          for (int j = 0; j < nonzero_size; ++j)
+            n_wt_local[topic_index[j]] += alpha * theta_ptr[topic_index[j]];
+        }
+
+        std::fill(values.begin(), values.end(), 0.0f);
+        for (int j = 0; j < nonzero_size; ++j) {
+          const int k = topic_index[j];
+          values[k] = (phi_value[j] * n_wt_local[k]) * batch_weight;
+          n_wt_local[k] = 0.0f;
+        }
+
+        writer->Store(w, token_id[w], values);
+        continue;
+      }
+
+      const float* p_wt_local = p_wt.get_row(token_id[w], &p_wt_buffer);
+
+      for (int i = sparse_nwd.row_ptr()[w]; i < sparse_nwd.row_ptr()[w + 1]; ++i) {
+        int d = sparse_nwd.col_ind()[i];
+        const float* theta_ptr = &(*theta_matrix)(0, d);  // NOLINT
+        if (top_k > 0 && has_active_topics[d]) {
+          // Scatter only into active topics of the document (other theta values are zero)
+          const int* active = &active_topics[static_cast<size_t>(d) * top_k];
+          float p = 0.0f;
+          for (int j = 0; j < top_k; ++j)
+            p += theta_ptr[active[j]] * p_wt_local[active[j]];
+          if (p_dw != nullptr) p_dw_nwd[i] = p;
+          if (p == 0.0f) continue;
+
+          const float alpha = sparse_nwd.val()[i] / p;
+          for (int j = 0; j < top_k; ++j)
+            n_wt_local[active[j]] += alpha * theta_ptr[active[j]];
+        } else {
+          const float p = blas->sdotaxpy(num_topics, sparse_nwd.val()[i], theta_ptr, p_wt_local, &n_wt_local[0]);
+          if (p_dw != nullptr) p_dw_nwd[i] = p;
+        }
+      }
+
+      blas->svprod(num_topics, p_wt_local, &n_wt_local[0], &values[0]);
+      blas->sscal(num_topics, batch_weight, &values[0]);
+      std::fill(n_wt_local.begin(), n_wt_local.end(), 0.0f);
+
+      writer->Store(w, token_id[w], values);
     }
+  });
+
+  for (auto& chunk_writer : chunk_writers)
+    chunk_writer.FlushTo(nwt_writer);
 
-    for (float& value : values) value *= batch_weight;
-    nwt_writer->Store(w, token_id[w], values);
+  if (p_dw != nullptr) {
+    // Convert p_dw from the transposed order back to the order of items and their tokens.
+    // Transpose keeps entries of each column sorted by document, so a cursor per token is enough.
+    std::vector<int> cursor(sparse_nwd.row_ptr(), sparse_nwd.row_ptr() + tokens_count);
+    p_dw->resize(sparse_ndw.nnz());
+    for (int d = 0; d < docs_count; ++d) {
+      for (int i = sparse_ndw.row_ptr()[d]; i < sparse_ndw.row_ptr()[d + 1]; ++i)
+        (*p_dw)[i] = p_dw_nwd[cursor[sparse_ndw.col_ind()[i]]++];
+    }
   }
 }
 
 static void
-InferPtdwAndUpdateNwtSparse(const ProcessBatchesArgs& args, const Batch& batch, float batch_weight,
-                            const CsrMatrix<float>& sparse_ndw,
+InferPtdwAndUpdateNwtSparse(const ProcessBatchesArgs& args, const PreparedBatch& batch, float batch_weight,
+                            const CsrMatrix<float>& sparse_ndw, const std::vector<int>& token_id,
                             const ::artm::core::PhiMatrix& p_wt,
                             const RegularizeThetaAgentCollection& theta_agents,
                             const RegularizePtdwAgentCollection& ptdw_agents,
@@ -495,10 +778,9 @@ InferPtdwAndUpdateNwtSparse(const ProcessBatchesArgs& args, const Batch& batch,
   const int docs_count = theta_matrix->num_items();
   const int tokens_count = batch.token_size();
 
-  std::vector<int> token_id(batch.token_size(), -1);
-  for (int token_index = 0; token_index < batch.token_size(); ++token_index)
-    token_id[token_index] = p_wt.token_index(Token(batch.class_id(token_index), batch.token(token_index)));
-
+  std::vector<const float*> phi_rows;
+  std::vector<std::vector<float>> row_buffers;
+  const std::vector<float> zero_row(num_topics, 0.0f);
   for (int d = 0; d < docs_count; ++d) {
     float* ntd_ptr = &n_td(0, d);
     float* theta_ptr = &(*theta_matrix)(0, d);  // NOLINT
@@ -506,16 +788,22 @@ InferPtdwAndUpdateNwtSparse(const ProcessBatchesArgs& args, const Batch& batch,
     const int begin_index = sparse_ndw.row_ptr()[d];
     const int end_index = sparse_ndw.row_ptr()[d + 1];
     const int local_token_size = end_index - begin_index;
-    LocalPhiMatrix<float> local_phi(local_token_size, num_topics);
     LocalPhiMatrix<float> local_ptdw(local_token_size, num_topics);
-    local_phi.InitializeZeros();
+    if (static_cast<int>(phi_rows.size()) < local_token_size) {
+      phi_rows.resize(local_token_size);
+      row_buffers.resize(local_token_size);
+    }
+
     bool item_has_tokens = false;
     for (int i = begin_index; i < end_index; ++i) {
       int w = sparse_ndw.col_ind()[i];
-      if (token_id[w] == ::artm::core::PhiMatrix::kUndefIndex) continue;
+      if (token_id[w] == ::artm::core::PhiMatrix::kUndefIndex) {
+        phi_rows[i - begin_index] = &zero_row[0];
+        continue;
+      }
+
       item_has_tokens = true;
-      float* local_phi_ptr = &local_phi(i - begin_index, 0);
-      for (int k = 0; k < num_topics; ++k) local_phi_ptr[k] = p_wt.get(token_id[w], k);
+      phi_rows[i - begin_index] = p_wt.get_row(token_id[w], &row_buffers[i - begin_index]);
     }
 
     if (!item_has_tokens) continue;  // continue to the next item
@@ -523,20 +811,12 @@ InferPtdwAndUpdateNwtSparse(const ProcessBatchesArgs& args, const Batch& batch,
     for (int inner_iter = 0; inner_iter <= args.num_document_passes(); ++inner_iter) {
       const bool last_iteration = (inner_iter == args.num_document_passes());
       for (int i = begin_index; i < end_index; ++i) {
-        const float* phi_ptr = &local_phi(i - begin_index, 0);
+        const float* phi_ptr = phi_rows[i - begin_index];
         float* ptdw_ptr = &local_ptdw(i - begin_index, 0);
 
-        float p_dw_val = 0.0f;
-        for (int k = 0; k < num_topics; ++k) {
-          float p_tdw_val = phi_ptr[k] * theta_ptr[k];
-          ptdw_ptr[k] = p_tdw_val;
-          p_dw_val += p_tdw_val;
-        }
-
+        const float p_dw_val = blas->svprod(num_topics, phi_ptr, theta_ptr, ptdw_ptr);
         if (p_dw_val == 0) continue;
-        const float Z = 1.0f / p_dw_val;
-          for (int k = 0; k < num_topics; ++k)
-              ptdw_ptr[k] *= Z;
+        blas->sscal(num_topics, 1.0f / p_dw_val, ptdw_ptr);
       }
 
       ptdw_agents.Apply(d, inner_iter, &local_ptdw);
@@ -547,8 +827,7 @@ InferPtdwAndUpdateNwtSparse(const ProcessBatchesArgs& args, const Batch& batch,
         for (int i = begin_index; i < end_index; ++i) {
           const float n_dw = sparse_ndw.val()[i];
           const float* ptdw_ptr = &local_ptdw(i - begin_index, 0);
-          for (int k = 0; k < num_topics; ++k)
-            ntd_ptr[k] += n_dw * ptdw_ptr[k];
+          blas->saxpy(num_topics, n_dw, ptdw_ptr, 1, ntd_ptr, 1);
         }
 
         for (int k = 0; k < num_topics; ++k)
@@ -562,9 +841,8 @@ InferPtdwAndUpdateNwtSparse(const ProcessBatchesArgs& args, const Batch& batch,
           for (int i = begin_index; i < end_index; ++i) {
             const float n_dw = batch_weight * sparse_ndw.val()[i];
             const float* ptdw_ptr = &local_ptdw(i - begin_index, 0);
-
-            for (int k = 0; k < num_topics; ++k)
-              values[k] = ptdw_ptr[k] * n_dw;
+            std::copy(ptdw_ptr, ptdw_ptr + num_topics, values.begin());
+            blas->sscal(num_topics, n_dw, &values[0]);
 
             int w = sparse_ndw.col_ind()[i];
             nwt_writer->Store(w, token_id[w], values);
@@ -578,61 +856,32 @@ InferPtdwAndUpdateNwtSparse(const ProcessBatchesArgs& args, const Batch& batch,
 }
 
 static std::shared_ptr<Score>
-CalcScores(ScoreCalculatorInterface* score_calc, const Batch& batch,
-           const PhiMatrix& p_wt, const ProcessBatchesArgs& args, const LocalThetaMatrix<float>& theta_matrix) {
+CalcScores(ScoreCalculatorInterface* score_calc, const ProcessedBatch& processed_batch,
+           const PreparedBatch& prepared) {
   if (!score_calc->is_cumulative())
     return nullptr;
 
-  std::vector<Token> token_dict;
-  for (int token_index = 0; token_index < batch.token_size(); ++token_index) {
-    token_dict.push_back(Token(batch.class_id(token_index), batch.token(token_index)));
+  std::shared_ptr<Score> score = score_calc->CreateScore();
+  if (score_calc->is_fused()) {
+    score_calc->AppendScore(processed_batch, score.get());
+    return score;
   }
 
-  std::shared_ptr<Score> score = score_calc->CreateScore();
+  const Batch& batch = prepared.batch();
+  const PhiMatrix& p_wt = processed_batch.p_wt();
+  std::vector<float> theta_vec(p_wt.topic_size(), 0.0f);
   for (int item_index = 0; item_index < batch.item_size(); ++item_index) {
-    const Item& item = batch.item(item_index);
-
-    std::vector<float> theta_vec;
-    assert(theta_matrix.num_topics() == p_wt.topic_size());
-    for (int topic_index = 0; topic_index < theta_matrix.num_topics(); ++topic_index) {
-      theta_vec.push_back(theta_matrix(topic_index, item_index));
-    }
-
-    score_calc->AppendScore(item, token_dict, p_wt, args, theta_vec, score.get());
+    const float* theta = processed_batch.theta(item_index);
+    std::copy(theta, theta + p_wt.topic_size(), theta_vec.begin());
+    score_calc->AppendScore(batch.item(item_index), processed_batch.token_dict(), p_wt, processed_batch.args(),
+                            theta_vec, score.get());
   }
 
-  score_calc->AppendScore(batch, p_wt, args, score.get());
+  score_calc->AppendScore(batch, p_wt, processed_batch.args(), score.get());
 
   return score;
 }
 
-bool fillTokensInBatch(const PhiMatrix& phi_matrix, Batch* batch) {
-  if (batch->token_size() > 0)
-    return true;
-
-  // Verify that max token_id is compatible with topic model.
-  const int token_size = phi_matrix.token_size();
-  for (auto& item : batch->item()) {
-    for (int token_id : item.token_id()) {
-      if (token_id < 0 || token_id >= token_size) {
-        LOG(ERROR) << "Batch " << batch->id() << " is incompatible with model " << phi_matrix.model_name()
-                    << " (batch.token_size() = 0 && item.token_id >= phi_matrix.token_size())";
-        return false;
-      }
-    }
-  }
-
-  batch->mutable_token()->Reserve(token_size);
-  batch->mutable_class_id()->Reserve(token_size);
-  for (int token_index = 0; token_index < token_size; ++token_index) {
-    const Token& token = phi_matrix.token(token_index);
-    batch->add_token(token.keyword);
-    batch->add_class_id(token.class_id);
-  }
-
-  return true;
-}
-
 void Processor::ThreadFunction() {
   try {
     int total_processed_batches = 0;  // counter
@@ -642,8 +891,6 @@ void Processor::ThreadFunction() {
 
     Helpers::SetThreadName(-1, "Processor thread");
     LOG(INFO) << "Processor thread started";
-    int pop_retries = 0;
-    const int pop_retries_max = 20;
 
     util::Blas* blas = util::Blas::builtin();
 
@@ -654,49 +901,38 @@ void Processor::ThreadFunction() {
         break;
       }
 
+      // Blocks until the next task arrives; returns false only when the processor is being destroyed.
       std::shared_ptr<ProcessorInput> part;
-      if (!instance_->processor_queue()->try_pop(&part)) {
-        pop_retries++;
-        LOG_IF(INFO, pop_retries == pop_retries_max) << "No data in processing queue, waiting...";
-
-        boost::this_thread::sleep(boost::posix_time::milliseconds(kIdleLoopFrequency));
+      if (!instance_->processor_queue()->wait_and_pop(&part, &is_stopping))
+        continue;
 
+      if (part->document_chunk_task() != nullptr) {
+        // Help another processor with its batch (see RunInChunks)
+        part->document_chunk_task()->Run();
         continue;
       }
 
-      LOG_IF(INFO, pop_retries >= pop_retries_max) << "Processing queue has data, processing started";
-      pop_retries = 0;
-
       // CuckooWatch logs time from now to destruction
       const std::string batch_name = part->has_batch_filename() ? part->batch_filename() : part->batch().id();
       CuckooWatch cuckoo(std::string("ProcessBatch(") + batch_name + std::string(")"));
       total_processed_batches++;
 
       call_on_destruction c([&]() {  // NOLINT
+        // Accumulator must be notified first, so that the reduction of n_wt buffers
+        // is finished before batch_manager reports the last task as processed.
+        if (part->nwt_accumulator() != nullptr) {
+          part->nwt_accumulator()->Complete(part->task_index());
+        }
+
         if (part->batch_manager() != nullptr) {
           part->batch_manager()->Callback(part->task_id());
         }
       });
 
-      Batch batch;
-      {
-        CuckooWatch cuckoo2("LoadMessage", &cuckoo, kTimeLoggingThreshold);
-        if (part->has_batch_filename()) {
-          auto mem_batch = instance_->batches()->get(part->batch_filename());
-          if (mem_batch != nullptr) {
-            batch.CopyFrom(*mem_batch);
-          } else {
-            try {
-              ::artm::core::Helpers::LoadMessage(part->batch_filename(), &batch);
-            } catch (std::exception& ex) {
-              LOG(ERROR) << ex.what() << ", the batch will be skipped.";
-              continue;
-            }
-          }
-        } else {  // part->has_batch_filename()
-          batch.CopyFrom(part->batch());
-        }
-      }
+      // Take the slot first, so that the batch loader does not start this batch any more
+      std::shared_ptr<PreparedBatch> prepared;
+      if (part->prepared_batch_slot() != nullptr)
+        prepared = part->prepared_batch_slot()->Take();
 
       std::shared_ptr<MasterModelConfig> master_config = instance_->config();
 
@@ -714,12 +950,18 @@ void Processor::ThreadFunction() {
         }
         const PhiMatrix& p_wt = *phi_matrix;
 
-        if (batch.token_size() == 0) {
-          if (!fillTokensInBatch(p_wt, &batch)) {
+        // Batch prepared ahead of time is only valid for the same p_wt
+        if (prepared == nullptr || prepared->p_wt() != phi_matrix) {
+          CuckooWatch cuckoo2("PrepareBatch", &cuckoo, kTimeLoggingThreshold);
+          prepared = PreparedBatch::Prepare(*part, phi_matrix, instance_);
+          if (prepared == nullptr)
             continue;
-          }
         }
 
+        const PreparedBatch& batch = *prepared;
+        const std::vector<int>& token_id = prepared->token_id();
+        const CsrMatrix<float>& sparse_ndw = prepared->sparse_ndw();
+
         int topic_size = p_wt.topic_size();
         std::shared_ptr<const PhiMatrix> nwt_target;
         if (part->has_nwt_target_name()) {
@@ -741,17 +983,12 @@ void Processor::ThreadFunction() {
           model_description << part->nwt_target_name();
         else
           model_description << &p_wt;
-        VLOG(0) << "Processor: start processing batch " << batch.id() << " into model " << model_description.str();
-
-        std::shared_ptr<CsrMatrix<float>> sparse_ndw;
-        {
-          CuckooWatch cuckoo2("InitializeSparseNdw", &cuckoo, kTimeLoggingThreshold);
-          sparse_ndw = InitializeSparseNdw(batch, args);
-        }
+        VLOG(0) << "Processor: start processing batch " << batch.batch_id()
+                << " into model " << model_description.str();
 
-        std::shared_ptr<ThetaMatrix> cache;
+        std::shared_ptr<const ThetaCacheEntry> cache;
         if (part->has_reuse_theta_cache_manager())
-          cache = part->reuse_theta_cache_manager()->FindCacheEntry(batch.id());
+          cache = part->reuse_theta_cache_manager()->FindCompactCacheEntry(batch.batch_id());
         std::shared_ptr<LocalThetaMatrix<float>> theta_matrix =
           InitializeTheta(p_wt.topic_size(), batch, args, cache.get());
 
@@ -762,8 +999,24 @@ void Processor::ThreadFunction() {
         }
 
         std::shared_ptr<NwtWriteAdapter> nwt_writer;
-        if (nwt_target != nullptr)
-          nwt_writer = std::make_shared<PhiMatrixWriter>(const_cast<PhiMatrix*>(nwt_target.get()));
+        std::shared_ptr<NwtBuffer> nwt_buffer;  // private buffer for NwtAccumulationMode_PerBatch
+        if (nwt_target != nullptr) {
+          switch (args.nwt_accumulation_mode()) {
+            case NwtAccumulationMode_PerBatch:
+              nwt_buffer = std::make_shared<NwtBuffer>(topic_size);
+              nwt_writer = std::make_shared<NwtBufferWriter>(nwt_buffer.get());
+              break;
+            case NwtAccumulationMode_PerTaskGroup:
+              if (part->nwt_accumulator() != nullptr) {
+                nwt_writer = std::make_shared<NwtBufferWriter>(
+                  part->nwt_accumulator()->buffer(part->task_index()).get());
+                break;
+              }
+              // fall through to direct mode if there is no accumulator
+            default:
+              nwt_writer = std::make_shared<PhiMatrixWriter>(const_cast<PhiMatrix*>(nwt_target.get()));
+          }
+        }
 
         std::shared_ptr<ThetaMatrix> new_cache_entry_ptr(nullptr);
         if (part->has_cache_manager())
@@ -781,6 +1034,16 @@ void Processor::ThreadFunction() {
           new_ptdw_cache_entry_ptr->mutable_topic_name()->CopyFrom(p_wt.topic_name());
         }
 
+        // Fused scores consume p(w|d) computed during inference, if the E-step can provide it
+        bool need_p_dw = false;
+        for (int score_index = 0; score_index < master_config->score_config_size(); ++score_index) {
+          auto score_calc = instance_->scores_calculators()->get(master_config->score_config(score_index).name());
+          if (score_calc != nullptr && score_calc->is_cumulative() && score_calc->is_fused())
+            need_p_dw = true;
+        }
+
+        int64_t document_passes = 0;  // total number of inner iterations over all items of the batch
+        std::vector<float> p_dw;
         {
           RegularizeThetaAgentCollection theta_agents;
           RegularizePtdwAgentCollection ptdw_agents;
@@ -788,24 +1051,41 @@ void Processor::ThreadFunction() {
 
           if (ptdw_agents.empty() && !part->has_ptdw_cache_manager()) {
             CuckooWatch cuckoo2("InferThetaAndUpdateNwtSparse", &cuckoo, kTimeLoggingThreshold);
-            InferThetaAndUpdateNwtSparse(args, batch, part->batch_weight(), *sparse_ndw,
+            InferThetaAndUpdateNwtSparse(args, batch, part->batch_weight(), sparse_ndw, token_id,
                                          p_wt, theta_agents, theta_matrix.get(), nwt_writer.get(),
-                                         blas, new_cache_entry_ptr.get());
+                                         blas, instance_, &document_passes, need_p_dw ? &p_dw : nullptr,
+                                         new_cache_entry_ptr.get());
           } else {
             CuckooWatch cuckoo2("InferPtdwAndUpdateNwtSparse", &cuckoo, kTimeLoggingThreshold);
-            InferPtdwAndUpdateNwtSparse(args, batch, part->batch_weight(), *sparse_ndw,
+            InferPtdwAndUpdateNwtSparse(args, batch, part->batch_weight(), sparse_ndw, token_id,
                                         p_wt, theta_agents, ptdw_agents, theta_matrix.get(), nwt_writer.get(),
                                         blas, new_cache_entry_ptr.get(),
                                         new_ptdw_cache_entry_ptr.get());
+            document_passes += static_cast<int64_t>(batch.item_size()) * args.num_document_passes();
           }
         }
 
+        if (nwt_buffer != nullptr) {
+          CuckooWatch cuckoo2("FlushNwtBuffer", &cuckoo, kTimeLoggingThreshold);
+          nwt_buffer->FlushTo(const_cast<PhiMatrix*>(nwt_target.get()));
+        }
+
         if (new_cache_entry_ptr != nullptr)
-          part->cache_manager()->UpdateCacheEntry(batch.id(), *new_cache_entry_ptr);
+          part->cache_manager()->UpdateCacheEntry(batch.batch_id(), *new_cache_entry_ptr);
 
         if (new_ptdw_cache_entry_ptr != nullptr)
-          part->ptdw_cache_manager()->UpdateCacheEntry(batch.id(), *new_ptdw_cache_entry_ptr);
+          part->ptdw_cache_manager()->UpdateCacheEntry(batch.batch_id(), *new_ptdw_cache_entry_ptr);
+
+        // Tokens are only decoded for scores (tokens of flat batches are stored in the string table)
+        std::vector<Token> token_dict;
+        if (master_config->score_config_size() != 0) {
+          token_dict.reserve(batch.token_size());
+          for (int token_index = 0; token_index < batch.token_size(); ++token_index)
+            token_dict.push_back(batch.token(token_index));
+        }
 
+        assert(theta_matrix->num_topics() == p_wt.topic_size());
+        ProcessedBatch processed_batch(batch.n_dw(), p_wt, args, token_dict, token_id, theta_matrix->get_data(), &p_dw);
         for (int score_index = 0; score_index < master_config->score_config_size(); ++score_index) {
           const ScoreName& score_name = master_config->score_config(score_index).name();
 
@@ -821,7 +1101,11 @@ void Processor::ThreadFunction() {
 
           CuckooWatch cuckoo2("CalculateScore(" + score_name + ")", &cuckoo, kTimeLoggingThreshold);
 
-          auto score_value = CalcScores(score_calc.get(), batch, p_wt, args, *theta_matrix);
+          auto score_value = CalcScores(score_calc.get(), processed_batch, batch);
+          ItemsProcessedScore* items_processed = dynamic_cast<ItemsProcessedScore*>(score_value.get());
+          if (items_processed != nullptr)
+            items_processed->set_total_document_passes(document_passes);
+
           if (score_value != nullptr) {
             instance_->score_manager()->Append(score_name, score_value->SerializeAsString());
             if (part->score_manager() != nullptr)
@@ -829,7 +1113,8 @@ void Processor::ThreadFunction() {
           }
         }
 
-        VLOG(0) << "Processor: complete processing batch " << batch.id() << " into model " << model_description.str();
+        VLOG(0) << "Processor: complete processing batch " << batch.batch_id()
+                << " into model " << model_description.str();
       }
     }
   }
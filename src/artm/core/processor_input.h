@@ -3,6 +3,7 @@
 #ifndef SRC_ARTM_CORE_PROCESSOR_INPUT_H_
 #define SRC_ARTM_CORE_PROCESSOR_INPUT_H_
 
+#include <memory>
 #include <string>
 
 #include "boost/uuid/uuid.hpp"
@@ -15,6 +16,9 @@ namespace core {
 class BatchManager;
 class ScoreManager;
 class CacheManager;
+class NwtAccumulator;
+class DocumentChunkTask;
+class PreparedBatchSlot;
 
 // This class describes one task for the processor component.
 // It has all the input data needed to execute ProcessBatch routine.
@@ -25,7 +29,9 @@ class ProcessorInput {
                      batch_filename_(), batch_weight_(1.0f), task_id_(), batch_manager_(nullptr),
                      score_manager_(nullptr), cache_manager_(nullptr),
                      ptdw_cache_manager_(nullptr),
-                     reuse_theta_cache_manager_(nullptr) {}
+                     reuse_theta_cache_manager_(nullptr),
+                     nwt_accumulator_(), task_index_(0), document_chunk_task_(),
+                     prepared_batch_slot_() {}
 
   Batch* mutable_batch() { return &batch_; }
   const Batch& batch() const { return batch_; }
@@ -51,6 +57,21 @@ class ProcessorInput {
   void set_reuse_theta_cache_manager(CacheManager* cache_manager) { reuse_theta_cache_manager_ = cache_manager; }
   bool has_reuse_theta_cache_manager() const { return reuse_theta_cache_manager_ != nullptr; }
 
+  const std::shared_ptr<NwtAccumulator>& nwt_accumulator() const { return nwt_accumulator_; }
+  void set_nwt_accumulator(std::shared_ptr<NwtAccumulator> nwt_accumulator) { nwt_accumulator_ = nwt_accumulator; }
+
+  // When set, this input does not carry a batch; the processor should help to execute chunks of this task.
+  const std::shared_ptr<DocumentChunkTask>& document_chunk_task() const { return document_chunk_task_; }
+  void set_document_chunk_task(std::shared_ptr<DocumentChunkTask> task) { document_chunk_task_ = task; }
+
+  // When set, the batch may be already loaded and decoded by the batch loader (see BatchLoader).
+  const std::shared_ptr<PreparedBatchSlot>& prepared_batch_slot() const { return prepared_batch_slot_; }
+  void set_prepared_batch_slot(std::shared_ptr<PreparedBatchSlot> slot) { prepared_batch_slot_ = slot; }
+
+  // Index of the task within its group (e.g. position of the batch in ProcessBatchesArgs)
+  int task_index() const { return task_index_; }
+  void set_task_index(int task_index) { task_index_ = task_index; }
+
   const ModelName& model_name() const { return model_name_; }
   void set_model_name(const ModelName& model_name) { model_name_ = model_name; }
 
@@ -81,6 +102,10 @@ class ProcessorInput {
   CacheManager* cache_manager_;
   CacheManager* ptdw_cache_manager_;
   CacheManager* reuse_theta_cache_manager_;
+  std::shared_ptr<NwtAccumulator> nwt_accumulator_;
+  int task_index_;
+  std::shared_ptr<DocumentChunkTask> document_chunk_task_;
+  std::shared_ptr<PreparedBatchSlot> prepared_batch_slot_;
 };
 
 }  // namespace core
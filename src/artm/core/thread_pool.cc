@@ -0,0 +1,120 @@
+// Copyright 2016, Additive Regularization of Topic Models.
+
+#include "artm/core/thread_pool.h"
+
+#include <algorithm>
+#include <exception>
+
+#include "boost/exception/diagnostic_information.hpp"
+
+#include "glog/logging.h"
+
+#include "artm/core/helpers.h"
+
+namespace artm {
+namespace core {
+
+struct ThreadPool::Job {
+  Job(int size, const std::function<void(int)>& function)
+      : function(function), size(size), next(0), remaining(size), done(), exception() {}
+
+  const std::function<void(int)>& function;
+  int size;
+  int next;       // the next index to run
+  int remaining;  // the number of indices that are not complete yet
+  boost::condition_variable done;
+  std::exception_ptr exception;
+};
+
+ThreadPool::ThreadPool(int num_threads)
+    : lock_(), has_job_(), jobs_(), is_stopping_(false), threads_() {
+  for (int i = 1; i < num_threads; ++i)
+    threads_.push_back(std::make_shared<boost::thread>(&ThreadPool::ThreadFunction, this));
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    boost::lock_guard<boost::mutex> guard(lock_);
+    is_stopping_ = true;
+  }
+
+  has_job_.notify_all();
+  for (auto& thread : threads_) {
+    if (thread->joinable())
+      thread->join();
+  }
+}
+
+void ThreadPool::ParallelFor(int size, const std::function<void(int)>& function) {
+  if (size <= 0)
+    return;
+
+  if (size == 1 || threads_.empty()) {
+    for (int index = 0; index < size; ++index)
+      function(index);
+    return;
+  }
+
+  auto job = std::make_shared<Job>(size, function);
+  boost::unique_lock<boost::mutex> lock(lock_);
+  jobs_.push_back(job);
+  has_job_.notify_all();
+
+  while (RunNext(job.get(), &lock)) {}
+  while (job->remaining > 0)
+    job->done.wait(lock);
+
+  if (job->exception)
+    std::rethrow_exception(job->exception);
+}
+
+bool ThreadPool::RunNext(Job* job, boost::unique_lock<boost::mutex>* lock) {
+  if (job->next >= job->size)
+    return false;
+
+  const int index = job->next++;
+  if (job->next == job->size)
+    jobs_.erase(std::remove_if(jobs_.begin(), jobs_.end(),
+                               [job](const std::shared_ptr<Job>& rhs) { return rhs.get() == job; }),
+                jobs_.end());
+
+  std::exception_ptr exception;
+  lock->unlock();
+  try {
+    job->function(index);
+  } catch (...) {
+    exception = std::current_exception();
+  }
+  lock->lock();
+
+  if (exception && !job->exception)
+    job->exception = exception;
+  if (--job->remaining == 0)
+    job->done.notify_all();
+  return true;
+}
+
+void ThreadPool::ThreadFunction() {
+  try {
+    Helpers::SetThreadName(-1, "ThreadPool thread");
+
+    boost::unique_lock<boost::mutex> lock(lock_);
+    for (;;) {
+      while (jobs_.empty() && !is_stopping_)
+        has_job_.wait(lock);
+
+      if (is_stopping_)
+        break;
+
+      // Keeps the job alive after its last index is taken, so that the caller can be notified
+      std::shared_ptr<Job> job = jobs_.front();
+      RunNext(job.get(), &lock);
+    }
+  }
+  catch (...) {
+    LOG(FATAL) << boost::current_exception_diagnostic_information();
+  }
+}
+
+}  // namespace core
+}  // namespace artm
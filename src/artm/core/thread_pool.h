@@ -0,0 +1,53 @@
+// Copyright 2016, Additive Regularization of Topic Models.
+
+#ifndef SRC_ARTM_CORE_THREAD_POOL_H_
+#define SRC_ARTM_CORE_THREAD_POOL_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "boost/thread.hpp"
+#include "boost/thread/condition_variable.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/utility.hpp"
+
+namespace artm {
+namespace core {
+
+// ThreadPool keeps a fixed set of worker threads for data-parallel loops (e.g. over tokens of phi matrices,
+// see PhiMatrixOperations), so that such loops do not start new threads on every call.
+// The pool is owned by Instance and sized by MasterModelConfig.num_processors.
+class ThreadPool : boost::noncopyable {
+ public:
+  // Loops run on num_threads - 1 worker threads and on the calling thread.
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  int num_threads() const { return static_cast<int>(threads_.size()) + 1; }
+
+  // Calls function(index) for each index in [0, size) and returns when all calls are complete.
+  // The calling thread takes part in the loop, so ParallelFor may be called from several threads at once,
+  // including worker threads of the pool. The first exception is re-thrown on the calling thread.
+  void ParallelFor(int size, const std::function<void(int)>& function);
+
+ private:
+  struct Job;
+
+  boost::mutex lock_;
+  boost::condition_variable has_job_;
+  std::deque<std::shared_ptr<Job>> jobs_;  // jobs with indices that are not taken yet
+  bool is_stopping_;
+  std::vector<std::shared_ptr<boost::thread>> threads_;
+
+  // Runs the next index of the job; must be called under lock, which is released while the index runs.
+  // Returns false if all indices of the job are taken.
+  bool RunNext(Job* job, boost::unique_lock<boost::mutex>* lock);
+  void ThreadFunction();
+};
+
+}  // namespace core
+}  // namespace artm
+
+#endif  // SRC_ARTM_CORE_THREAD_POOL_H_
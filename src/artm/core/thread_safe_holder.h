@@ -3,12 +3,14 @@
 #ifndef SRC_ARTM_CORE_THREAD_SAFE_HOLDER_H_
 #define SRC_ARTM_CORE_THREAD_SAFE_HOLDER_H_
 
+#include <atomic>
 #include <queue>
 #include <map>
 #include <memory>
 #include <vector>
 #include <utility>
 
+#include "boost/thread/condition_variable.hpp"
 #include "boost/thread/locks.hpp"
 #include "boost/thread/mutex.hpp"
 #include "boost/utility.hpp"
@@ -144,7 +146,7 @@ class ThreadSafeCollectionHolder : boost::noncopyable {
 template<typename T>
 class ThreadSafeQueue : boost::noncopyable {
  public:
-  ThreadSafeQueue() : lock_(), queue_(), reserved_(0) {}
+  ThreadSafeQueue() : lock_(), condition_(), queue_(), reserved_(0) {}
 
   bool try_pop(T* elem) {
     boost::lock_guard<boost::mutex> guard(lock_);
@@ -157,9 +159,36 @@ class ThreadSafeQueue : boost::noncopyable {
     return true;
   }
 
+  // Blocks until an element is available or *is_stopping becomes true.
+  // Returns false (and leaves elem untouched) when the wait was ended by is_stopping.
+  // Whoever sets is_stopping must call notify_all() afterwards to wake up the waiting threads.
+  bool wait_and_pop(T* elem, const std::atomic<bool>* is_stopping) {
+    boost::unique_lock<boost::mutex> lock(lock_);
+    while (queue_.empty() && !*is_stopping)
+      condition_.wait(lock);
+
+    if (queue_.empty())
+      return false;
+
+    T tmp_elem = queue_.front();
+    queue_.pop();
+    *elem = tmp_elem;
+    return true;
+  }
+
   void push(const T& elem) {
-    boost::lock_guard<boost::mutex> guard(lock_);
-    queue_.push(elem);
+    {
+      boost::lock_guard<boost::mutex> guard(lock_);
+      queue_.push(elem);
+    }
+    condition_.notify_one();
+  }
+
+  void notify_all() {
+    // Taking the lock guarantees that a thread that has just checked its stop flag
+    // is already waiting on the condition, so the notification is not lost.
+    { boost::lock_guard<boost::mutex> guard(lock_); }
+    condition_.notify_all();
   }
 
   void reserve() {
@@ -185,6 +214,7 @@ class ThreadSafeQueue : boost::noncopyable {
 
  private:
   mutable boost::mutex lock_;
+  boost::condition_variable condition_;
   std::queue<T> queue_;
   size_t reserved_;
 };
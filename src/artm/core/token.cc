@@ -5,5 +5,52 @@
 namespace artm {
 namespace core {
 
+// Index is grown to keep at least this many slots per token
+static const int kSlotsPerToken = 2;
+
+void TokenIndex::insert(const Token& token, int position) {
+  if (static_cast<int64_t>(size_ + 1) * kSlotsPerToken > static_cast<int64_t>(slots_.size()))
+    reserve(size_ + 1);
+
+  Slot slot = { position, static_cast<uint32_t>(TokenHasher()(token)) };
+  InsertSlot(slot);
+  size_++;
+}
+
+void TokenIndex::reserve(int size) {
+  int num_slots = slots_.empty() ? 16 : static_cast<int>(slots_.size());
+  while (num_slots < size * kSlotsPerToken)
+    num_slots *= 2;
+
+  if (num_slots != static_cast<int>(slots_.size()))
+    Rehash(num_slots);
+}
+
+void TokenIndex::clear() {
+  slots_.clear();
+  size_ = 0;
+}
+
+int64_t TokenIndex::ByteSize() const {
+  return static_cast<int64_t>(slots_.capacity()) * sizeof(Slot);
+}
+
+void TokenIndex::Rehash(int num_slots) {
+  std::vector<Slot> old_slots(num_slots, Slot { -1, 0 });
+  slots_.swap(old_slots);
+  for (const Slot& slot : old_slots) {
+    if (slot.position != -1)
+      InsertSlot(slot);
+  }
+}
+
+void TokenIndex::InsertSlot(const Slot& slot) {
+  const uint32_t mask = static_cast<uint32_t>(slots_.size() - 1);
+  uint32_t index = slot.hash & mask;
+  while (slots_[index].position != -1)
+    index = (index + 1) & mask;
+  slots_[index] = slot;
+}
+
 }  // namespace core
 }  // namespace artm
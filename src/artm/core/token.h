@@ -3,7 +3,10 @@
 #ifndef SRC_ARTM_CORE_TOKEN_H_
 #define SRC_ARTM_CORE_TOKEN_H_
 
+#include <stdint.h>
+
 #include <string>
+#include <vector>
 
 #include "boost/functional/hash.hpp"
 
@@ -68,6 +71,53 @@ struct TokenHasher {
   }
 };
 
+// TokenIndex is an open-addressing lookup from a token to its position in an external sequence of tokens
+// (e.g. the tokens of a TokenCollection, or the entries of a Dictionary).
+// Unlike std::unordered_map<Token, int> it does not keep a copy of the tokens:
+// each slot only stores the position and the hash of the token (8 bytes), and slots are kept at most half full.
+class TokenIndex {
+ public:
+  TokenIndex() : slots_(), size_(0) {}
+
+  // Returns the position of the token, or -1 if it is not in the index.
+  // token_at(position) must return the token stored at given position.
+  template<typename TokenAt>
+  int find(const Token& token, const TokenAt& token_at) const {
+    if (slots_.empty())
+      return -1;
+
+    const uint32_t hash = static_cast<uint32_t>(TokenHasher()(token));
+    const uint32_t mask = static_cast<uint32_t>(slots_.size() - 1);
+    for (uint32_t slot = hash & mask; ; slot = (slot + 1) & mask) {
+      const Slot& current = slots_[slot];
+      if (current.position == -1)
+        return -1;
+      if (current.hash == hash && token_at(current.position) == token)
+        return current.position;
+    }
+  }
+
+  // Adds the token at given position. The token must not be in the index yet.
+  void insert(const Token& token, int position);
+  void reserve(int size);
+  void clear();
+
+  int size() const { return size_; }
+  int64_t ByteSize() const;
+
+ private:
+  struct Slot {
+    int position;
+    uint32_t hash;
+  };
+
+  void Rehash(int num_slots);
+  void InsertSlot(const Slot& slot);
+
+  std::vector<Slot> slots_;
+  int size_;
+};
+
 }  // namespace core
 }  // namespace artm
 
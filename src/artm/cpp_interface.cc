@@ -133,6 +133,12 @@ Batch LoadBatch(std::string filename) {
   return ArtmCopyResult<Batch>(length);
 }
 
+void SaveFlatBatch(const Batch& batch, std::string filename) {
+  std::string blob;
+  SerializeMessageToString(batch, &blob);
+  HandleErrorCode(ArtmSaveFlatBatch(filename.c_str(), blob.size(), StringAsArray(&blob)));
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 // MasterModel implementation
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -62,6 +62,7 @@ int64_t HandleErrorCode(int64_t artm_error_code);
 CollectionParserInfo ParseCollection(const CollectionParserConfig& config);
 void ConfigureLogging(const ConfigureLoggingArgs& args);
 Batch LoadBatch(std::string filename);
+void SaveFlatBatch(const Batch& batch, std::string filename);
 
 class Matrix {
  public:
@@ -42,6 +42,35 @@ void ItemsProcessed::AppendScore(
   AppendScore(items_processed_score, score);
 }
 
+void ItemsProcessed::AppendScore(const ProcessedBatch& processed_batch, Score* score) {
+  const ::artm::utility::CsrMatrix<float>& n_dw = processed_batch.n_dw();
+  const std::vector<artm::core::Token>& token_dict = processed_batch.token_dict();
+  const ProcessBatchesArgs& args = processed_batch.args();
+
+  // Check once per batch token whether it is in effect (present in the model, and belongs to relevant modality)
+  std::vector<bool> in_effect(token_dict.size(), false);
+  for (int token_index = 0; token_index < static_cast<int>(token_dict.size()); ++token_index) {
+    in_effect[token_index] = processed_batch.token_id(token_index) != ::artm::core::PhiMatrix::kUndefIndex &&
+      (args.class_id_size() == 0 || ::artm::core::is_member(token_dict[token_index].class_id, args.class_id()));
+  }
+
+  double token_weight = 0.0;
+  double token_weight_in_effect = 0.0;
+  for (int i = 0; i < n_dw.nnz(); ++i) {
+    token_weight += n_dw.val()[i];
+    if (in_effect[n_dw.col_ind()[i]])
+      token_weight_in_effect += n_dw.val()[i];
+  }
+
+  ItemsProcessedScore items_processed_score;
+  items_processed_score.set_num_batches(1);
+  items_processed_score.set_value(processed_batch.item_size());
+  items_processed_score.set_token_weight(token_weight);
+  items_processed_score.set_token_weight_in_effect(token_weight_in_effect);
+
+  AppendScore(items_processed_score, score);
+}
+
 std::shared_ptr<Score> ItemsProcessed::CreateScore() {
   return std::make_shared<ItemsProcessedScore>();
 }
@@ -66,6 +95,8 @@ void ItemsProcessed::AppendScore(const Score& score, Score* target) {
     items_processed_target->token_weight() + items_processed_score->token_weight());
   items_processed_target->set_token_weight_in_effect(
     items_processed_target->token_weight_in_effect() + items_processed_score->token_weight_in_effect());
+  items_processed_target->set_total_document_passes(
+    items_processed_target->total_document_passes() + items_processed_score->total_document_passes());
 }
 
 }  // namespace score
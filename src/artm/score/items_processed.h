@@ -37,6 +37,9 @@ class ItemsProcessed : public ScoreCalculatorInterface {
       const artm::ProcessBatchesArgs& args,
       Score* score);
 
+  virtual bool is_fused() const { return true; }
+  virtual void AppendScore(const ProcessedBatch& processed_batch, Score* score);
+
   virtual ScoreType score_type() const { return ::artm::ScoreType_ItemsProcessed; }
 
  private:
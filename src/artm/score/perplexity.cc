@@ -24,16 +24,7 @@ Perplexity::Perplexity(const ScoreConfig& config) : ScoreCalculatorInterface(con
   LOG(INFO) << "Perplexity score calculator created" << ss.str();
 }
 
-void Perplexity::AppendScore(
-    const Item& item,
-    const std::vector<artm::core::Token>& token_dict,
-    const artm::core::PhiMatrix& p_wt,
-    const artm::ProcessBatchesArgs& args,
-    const std::vector<float>& theta,
-    Score* score) {
-  int topic_size = p_wt.topic_size();
-
-  // the following code counts perplexity
+std::map< ::artm::core::ClassId, float> Perplexity::GetClassWeights(const ProcessBatchesArgs& args) const {
   bool use_classes_from_model = false;
   if (config_.class_id_size() == 0) use_classes_from_model = true;
 
@@ -50,6 +41,62 @@ void Perplexity::AppendScore(
         }
     }
   }
+
+  return class_weights;
+}
+
+bool Perplexity::GetDictionary(std::shared_ptr<core::Dictionary>* dictionary_ptr,
+                               bool* use_document_unigram_model) {
+  *dictionary_ptr = nullptr;
+  if (config_.has_dictionary_name())
+    *dictionary_ptr = dictionary(config_.dictionary_name());
+  bool has_dictionary = *dictionary_ptr != nullptr;
+
+  *use_document_unigram_model = true;
+  if (config_.has_model_type()) {
+    if (config_.model_type() == PerplexityScoreConfig_Type_UnigramCollectionModel) {
+      if (has_dictionary) {
+        *use_document_unigram_model = false;
+      } else {
+        LOG(ERROR) << "Perplexity was configured to use UnigramCollectionModel with dictionary " <<
+           config_.dictionary_name() << ". This dictionary can't be found.";
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+double Perplexity::GetZeroWordProbability(const artm::core::Token& token, float token_weight, float n_d,
+                                          const core::Dictionary* dictionary_ptr) {
+  if (dictionary_ptr != nullptr) {
+    auto entry_ptr = dictionary_ptr->entry(token);
+    if (entry_ptr != nullptr && entry_ptr->token_value())
+      return entry_ptr->token_value();
+
+    LOG_FIRST_N(WARNING, 1)
+              << "Error in perplexity dictionary for token " << token.keyword << ", class " << token.class_id
+              << " (and potentially for other tokens)"
+              << ". Verify that the token exists in the dictionary and it's value > 0. "
+              << "Document unigram model will be used for this token "
+              << "(and for all other tokens under the same conditions).";
+  }
+
+  return token_weight / n_d;
+}
+
+void Perplexity::AppendScore(
+    const Item& item,
+    const std::vector<artm::core::Token>& token_dict,
+    const artm::core::PhiMatrix& p_wt,
+    const artm::ProcessBatchesArgs& args,
+    const std::vector<float>& theta,
+    Score* score) {
+  int topic_size = p_wt.topic_size();
+
+  // the following code counts perplexity
+  std::map< ::artm::core::ClassId, float> class_weights = GetClassWeights(args);
   bool use_class_id = !class_weights.empty();
 
   float n_d = 0;
@@ -70,23 +117,10 @@ void Perplexity::AppendScore(
   double normalizer = 0;
   double raw = 0;
 
-  std::shared_ptr<core::Dictionary> dictionary_ptr = nullptr;
-  if (config_.has_dictionary_name())
-    dictionary_ptr = dictionary(config_.dictionary_name());
-  bool has_dictionary = dictionary_ptr != nullptr;
-
-  bool use_document_unigram_model = true;
-  if (config_.has_model_type()) {
-    if (config_.model_type() == PerplexityScoreConfig_Type_UnigramCollectionModel) {
-      if (has_dictionary) {
-        use_document_unigram_model = false;
-      } else {
-        LOG(ERROR) << "Perplexity was configured to use UnigramCollectionModel with dictionary " <<
-           config_.dictionary_name() << ". This dictionary can't be found.";
-        return;
-      }
-    }
-  }
+  std::shared_ptr<core::Dictionary> dictionary_ptr;
+  bool use_document_unigram_model;
+  if (!GetDictionary(&dictionary_ptr, &use_document_unigram_model))
+    return;
 
   std::vector<float> helper_vector(topic_size, 0.0f);
   for (int token_index = 0; token_index < item.token_weight_size(); ++token_index) {
@@ -112,25 +146,8 @@ void Perplexity::AppendScore(
       }
     }
     if (sum == 0.0) {
-      if (use_document_unigram_model) {
-        sum = token_weight / n_d;
-      } else {
-        auto entry_ptr = dictionary_ptr->entry(token);
-        bool failed = true;
-        if (entry_ptr != nullptr && entry_ptr->token_value()) {
-          sum = entry_ptr->token_value();
-          failed = false;
-        }
-        if (failed) {
-          LOG_FIRST_N(WARNING, 1)
-                    << "Error in perplexity dictionary for token " << token.keyword << ", class " << token.class_id
-                    << " (and potentially for other tokens)"
-                    << ". Verify that the token exists in the dictionary and it's value > 0. "
-                    << "Document unigram model will be used for this token "
-                    << "(and for all other tokens under the same conditions).";
-          sum = token_weight / n_d;
-        }
-      }
+      sum = GetZeroWordProbability(token, token_weight, n_d,
+                                   use_document_unigram_model ? nullptr : dictionary_ptr.get());
       zero_words++;
     }
 
@@ -146,6 +163,66 @@ void Perplexity::AppendScore(
   AppendScore(perplexity_score, score);
 }
 
+void Perplexity::AppendScore(const ProcessedBatch& processed_batch, Score* score) {
+  const ::artm::utility::CsrMatrix<float>& n_dw = processed_batch.n_dw();
+  const std::vector<artm::core::Token>& token_dict = processed_batch.token_dict();
+
+  std::shared_ptr<core::Dictionary> dictionary_ptr;
+  bool use_document_unigram_model;
+  if (!GetDictionary(&dictionary_ptr, &use_document_unigram_model))
+    return;
+
+  // Resolve class weights once per batch token (instead of once per token occurrence)
+  std::map< ::artm::core::ClassId, float> class_weights = GetClassWeights(processed_batch.args());
+  std::vector<float> token_class_weight(token_dict.size(), 1.0f);
+  if (!class_weights.empty()) {
+    for (int token_index = 0; token_index < static_cast<int>(token_dict.size()); ++token_index) {
+      auto iter = class_weights.find(token_dict[token_index].class_id);
+      token_class_weight[token_index] = (iter == class_weights.end()) ? -1.0f : iter->second;
+    }
+  }
+
+  const std::vector<float>& p_dw = processed_batch.p_dw();
+  PerplexityScore perplexity_score;
+  ::google::protobuf::int64 zero_words = 0;
+  double normalizer = 0;
+  double raw = 0;
+  for (int item_index = 0; item_index < n_dw.m(); ++item_index) {
+    const int begin_index = n_dw.row_ptr()[item_index];
+    const int end_index = n_dw.row_ptr()[item_index + 1];
+
+    float n_d = 0;
+    for (int i = begin_index; i < end_index; ++i) {
+      const float class_weight = token_class_weight[n_dw.col_ind()[i]];
+      if (class_weight >= 0.0f)
+        n_d += class_weight * n_dw.val()[i];
+    }
+
+    for (int i = begin_index; i < end_index; ++i) {
+      const float class_weight = token_class_weight[n_dw.col_ind()[i]];
+      if (class_weight < 0.0f) continue;
+
+      float token_weight = class_weight * n_dw.val()[i];
+      if (token_weight == 0.0f) continue;
+
+      double sum = p_dw[i];
+      if (sum == 0.0) {
+        sum = GetZeroWordProbability(token_dict[n_dw.col_ind()[i]], token_weight, n_d,
+                                     use_document_unigram_model ? nullptr : dictionary_ptr.get());
+        zero_words++;
+      }
+
+      normalizer += token_weight;
+      raw        += token_weight * log(sum);
+    }
+  }
+
+  perplexity_score.set_normalizer(normalizer);
+  perplexity_score.set_raw(raw);
+  perplexity_score.set_zero_words(zero_words);
+  AppendScore(perplexity_score, score);
+}
+
 std::shared_ptr<Score> Perplexity::CreateScore() {
   VLOG(1) << "Perplexity::CreateScore()";
   return std::make_shared<PerplexityScore>();
@@ -16,6 +16,8 @@
 #ifndef SRC_ARTM_SCORE_PERPLEXITY_H_
 #define SRC_ARTM_SCORE_PERPLEXITY_H_
 
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -42,10 +44,23 @@ class Perplexity : public ScoreCalculatorInterface {
       const std::vector<float>& theta,
       Score* score);
 
+  virtual bool is_fused() const { return true; }
+  virtual void AppendScore(const ProcessedBatch& processed_batch, Score* score);
+
   virtual ScoreType score_type() const { return ::artm::ScoreType_Perplexity; }
 
  private:
   PerplexityScoreConfig config_;
+
+  std::map< ::artm::core::ClassId, float> GetClassWeights(const ProcessBatchesArgs& args) const;
+
+  // Returns false if perplexity can't be calculated with the configured dictionary.
+  bool GetDictionary(std::shared_ptr<core::Dictionary>* dictionary_ptr, bool* use_document_unigram_model);
+
+  // Replacement for p(w|d) of a token with zero probability in the model.
+  // Uses unigram collection model if dictionary_ptr is set, and unigram document model otherwise.
+  static double GetZeroWordProbability(const artm::core::Token& token, float token_weight, float n_d,
+                                       const core::Dictionary* dictionary_ptr);
 };
 
 }  // namespace score
@@ -44,6 +44,37 @@ void SparsityTheta::AppendScore(
   AppendScore(sparsity_theta_score, score);
 }
 
+void SparsityTheta::AppendScore(const ProcessedBatch& processed_batch, Score* score) {
+  const artm::core::PhiMatrix& p_wt = processed_batch.p_wt();
+  int topic_size = p_wt.topic_size();
+
+  std::vector<bool> topics_to_score;
+  ::google::protobuf::int64 topics_to_score_size = topic_size;
+  if (config_.topic_name_size() == 0) {
+    topics_to_score.assign(topic_size, true);
+  } else {
+    topics_to_score = core::is_member(p_wt.topic_name(), config_.topic_name());
+    topics_to_score_size = config_.topic_name_size();
+  }
+
+  ::google::protobuf::int64 zero_topics_count = 0;
+  const int item_size = processed_batch.item_size();
+  for (int item_index = 0; item_index < item_size; ++item_index) {
+    const float* theta = processed_batch.theta(item_index);
+    for (int topic_index = 0; topic_index < topic_size; ++topic_index) {
+      if ((fabs(theta[topic_index]) < config_.eps()) &&
+          topics_to_score[topic_index]) {
+        ++zero_topics_count;
+      }
+    }
+  }
+
+  SparsityThetaScore sparsity_theta_score;
+  sparsity_theta_score.set_zero_topics(zero_topics_count);
+  sparsity_theta_score.set_total_topics(topics_to_score_size * item_size);
+  AppendScore(sparsity_theta_score, score);
+}
+
 std::shared_ptr<Score> SparsityTheta::CreateScore() {
   return std::make_shared<SparsityThetaScore>();
 }
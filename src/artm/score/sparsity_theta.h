@@ -41,6 +41,9 @@ class SparsityTheta : public ScoreCalculatorInterface {
       const std::vector<float>& theta,
       Score* score);
 
+  virtual bool is_fused() const { return true; }
+  virtual void AppendScore(const ProcessedBatch& processed_batch, Score* score);
+
   virtual ScoreType score_type() const { return ::artm::ScoreType_SparsityTheta; }
 
  private:
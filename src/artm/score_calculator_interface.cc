@@ -5,9 +5,43 @@
 #include "artm/core/dictionary.h"
 #include "artm/core/phi_matrix.h"
 #include "artm/core/instance.h"
+#include "artm/utility/blas.h"
 
 namespace artm {
 
+ProcessedBatch::ProcessedBatch(const artm::utility::CsrMatrix<float>& n_dw, const artm::core::PhiMatrix& p_wt,
+                               const ProcessBatchesArgs& args, const std::vector<artm::core::Token>& token_dict,
+                               const std::vector<int>& token_id, const float* theta, std::vector<float>* p_dw)
+    : n_dw_(n_dw), p_wt_(p_wt), args_(args), token_dict_(token_dict), token_id_(token_id), theta_(theta),
+      p_dw_() {
+  if (p_dw != nullptr)
+    p_dw_.swap(*p_dw);
+}
+
+const std::vector<float>& ProcessedBatch::p_dw() const {
+  if (!p_dw_.empty() || n_dw_.nnz() == 0)
+    return p_dw_;
+
+  const int topic_size = p_wt_.topic_size();
+  ::artm::utility::Blas* blas = ::artm::utility::Blas::builtin();
+  std::vector<float> buffer;
+  p_dw_.reserve(n_dw_.nnz());
+  for (int item_index = 0; item_index < n_dw_.m(); ++item_index) {
+    for (int i = n_dw_.row_ptr()[item_index]; i < n_dw_.row_ptr()[item_index + 1]; ++i) {
+      const int pwt_token_id = token_id_[n_dw_.col_ind()[i]];
+      float value = 0.0f;
+      if (pwt_token_id != ::artm::core::PhiMatrix::kUndefIndex) {
+        const float* phi_row = p_wt_.get_row(pwt_token_id, &buffer);
+        value = blas->sdot(topic_size, phi_row, 1, theta(item_index), 1);
+      }
+
+      p_dw_.push_back(value);
+    }
+  }
+
+  return p_dw_;
+}
+
 std::shared_ptr< ::artm::core::Dictionary> ScoreCalculatorInterface::dictionary(const std::string& dictionary_name) {
   return ::artm::core::ThreadSafeDictionaryCollection::singleton().get(dictionary_name);
 }
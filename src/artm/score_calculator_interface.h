@@ -14,6 +14,7 @@
 #include "artm/core/exceptions.h"
 #include "artm/core/token.h"
 #include "artm/messages.pb.h"
+#include "artm/utility/blas.h"
 
 namespace artm {
 
@@ -23,6 +24,44 @@ namespace core {
 class Instance;
 }  // namespace core
 
+// ProcessedBatch exposes the results of inference for one batch to cumulative scores
+// that support fused calculation (see ScoreCalculatorInterface::is_fused()).
+// Scores can read theta columns and p(w|d) values directly, without copying them
+// and without looking up tokens in p_wt. All data is owned by the processor.
+class ProcessedBatch {
+ public:
+  // n_dw holds token weights of items (rows) by batch tokens (columns), without class weights.
+  // theta must contain n_dw.m() columns of p_wt.topic_size() values each.
+  // token_id holds index in p_wt for each token of the batch (or PhiMatrix::kUndefIndex).
+  // p_dw (if not empty) must be filled as described in p_dw() below; it is swapped into ProcessedBatch.
+  ProcessedBatch(const artm::utility::CsrMatrix<float>& n_dw, const artm::core::PhiMatrix& p_wt,
+                 const ProcessBatchesArgs& args, const std::vector<artm::core::Token>& token_dict,
+                 const std::vector<int>& token_id, const float* theta, std::vector<float>* p_dw);
+
+  const artm::utility::CsrMatrix<float>& n_dw() const { return n_dw_; }
+  int item_size() const { return n_dw_.m(); }
+  const artm::core::PhiMatrix& p_wt() const { return p_wt_; }
+  const ProcessBatchesArgs& args() const { return args_; }
+  const std::vector<artm::core::Token>& token_dict() const { return token_dict_; }
+  int token_id(int token_index) const { return token_id_[token_index]; }
+  const float* theta(int item_index) const { return theta_ + static_cast<size_t>(item_index) * p_wt_.topic_size(); }
+
+  // p(w|d) = sum_t p_wt(w, t) * theta(t, d) for all non-zero elements of n_dw:
+  // p_dw()[i] corresponds to n_dw().val()[i], and the values of item d start at item_offset(d).
+  // Computed on first request if the processor did not provide it.
+  const std::vector<float>& p_dw() const;
+  int item_offset(int item_index) const { return n_dw_.row_ptr()[item_index]; }
+
+ private:
+  const artm::utility::CsrMatrix<float>& n_dw_;
+  const artm::core::PhiMatrix& p_wt_;
+  const ProcessBatchesArgs& args_;
+  const std::vector<artm::core::Token>& token_dict_;
+  const std::vector<int>& token_id_;
+  const float* theta_;
+  mutable std::vector<float> p_dw_;
+};
+
 // ScoreCalculatorInterface is the base class for all score calculators in BigARTM.
 // See any class in 'src/score' folder for an example of how to implement new score.
 // Keep in mind that scres can be either cumulative (theta-scores) or non-cumulative (phi-scores).
@@ -46,6 +85,10 @@ class ScoreCalculatorInterface {
   // Cumulative calculation (such as perplexity, or sparsity of Theta matrix)
   virtual bool is_cumulative() const { return false; }
 
+  // Fused cumulative calculation: the processor calls AppendScore(ProcessedBatch, ...) once per batch
+  // instead of the per-item and per-batch AppendScore methods.
+  virtual bool is_fused() const { return false; }
+
   virtual std::shared_ptr<Score> CreateScore() { return nullptr; }
 
   virtual void AppendScore(const Score& score, Score* target) { return; }
@@ -64,6 +107,8 @@ class ScoreCalculatorInterface {
       const artm::ProcessBatchesArgs& args,
       Score* score) {}
 
+  virtual void AppendScore(const ProcessedBatch& processed_batch, Score* score) {}
+
   std::shared_ptr< ::artm::core::Dictionary> dictionary(const std::string& dictionary_name);
   std::shared_ptr<const ::artm::core::PhiMatrix> GetPhiMatrix(const std::string& model_name);
 
@@ -12,6 +12,11 @@
 #include <vector>
 #include <utility>
 
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ARTM_BLAS_X86_KERNELS
+#include <immintrin.h>
+#endif
+
 namespace artm {
 namespace utility {
 
@@ -45,6 +50,304 @@ void builtin_saxpy(const int size, const float alpha,
   }
 }
 
+float builtin_sdotaxpy(int size, float numerator, const float *x, const float *y, float *z) {
+  float p = 0.0f;
+  for (int i = 0; i < size; ++i) p += x[i] * y[i];
+  if (p == 0.0f) return p;
+  const float alpha = numerator / p;
+  for (int i = 0; i < size; ++i) z[i] += alpha * x[i];
+  return p;
+}
+
+void builtin_svmul(int size, const float *x, float *y) {
+  for (int i = 0; i < size; ++i) y[i] *= x[i];
+}
+
+float builtin_svprod(int size, const float *x, const float *y, float *z) {
+  float sum = 0.0f;
+  for (int i = 0; i < size; ++i) {
+    z[i] = x[i] * y[i];
+    sum += z[i];
+  }
+  return sum;
+}
+
+void builtin_sscal(int size, float alpha, float *x) {
+  for (int i = 0; i < size; ++i) x[i] *= alpha;
+}
+
+#if defined(ARTM_BLAS_X86_KERNELS)
+// Hand-written kernels for x86. Each function is compiled for its own target via
+// __attribute__((target)), so the binary stays portable and the kernels are only
+// selected at runtime when the CPU supports the corresponding instruction set.
+// Non-unit strides are rare (only sgemm with transposed operands) and fall back to builtin versions.
+
+#define ARTM_TARGET(isa) __attribute__((target(isa)))
+
+// SSE4 kernels
+
+ARTM_TARGET("sse4.1") static inline float sse4_hsum(__m128 v) {
+  __m128 shuf = _mm_movehdup_ps(v);
+  __m128 sums = _mm_add_ps(v, shuf);
+  shuf = _mm_movehl_ps(shuf, sums);
+  sums = _mm_add_ss(sums, shuf);
+  return _mm_cvtss_f32(sums);
+}
+
+ARTM_TARGET("sse4.1") static inline float sse4_dot(int size, const float *x, const float *y) {
+  __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= size; i += 8) {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(y + i + 4)));
+  }
+  for (; i + 4 <= size; i += 4)
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+  float result = sse4_hsum(_mm_add_ps(acc0, acc1));
+  for (; i < size; ++i) result += x[i] * y[i];
+  return result;
+}
+
+ARTM_TARGET("sse4.1") static inline void sse4_axpy(int size, float alpha, const float *x, float *y) {
+  const __m128 a = _mm_set1_ps(alpha);
+  int i = 0;
+  for (; i + 4 <= size; i += 4)
+    _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(a, _mm_loadu_ps(x + i))));
+  for (; i < size; ++i) y[i] += alpha * x[i];
+}
+
+ARTM_TARGET("sse4.1") float sse4_sdot(int size, const float *x, int xstride, const float *y, int ystride) {
+  if (xstride != 1 || ystride != 1) return builtin_sdot(size, x, xstride, y, ystride);
+  return sse4_dot(size, x, y);
+}
+
+ARTM_TARGET("sse4.1") void sse4_saxpy(const int size, const float alpha,
+                                      const float *x, const int xstride, float *y, const int ystride) {
+  if (xstride != 1 || ystride != 1) return builtin_saxpy(size, alpha, x, xstride, y, ystride);
+  sse4_axpy(size, alpha, x, y);
+}
+
+ARTM_TARGET("sse4.1") float sse4_sdotaxpy(int size, float numerator, const float *x, const float *y, float *z) {
+  const float p = sse4_dot(size, x, y);
+  if (p != 0.0f) sse4_axpy(size, numerator / p, x, z);
+  return p;
+}
+
+ARTM_TARGET("sse4.1") void sse4_svmul(int size, const float *x, float *y) {
+  int i = 0;
+  for (; i + 4 <= size; i += 4)
+    _mm_storeu_ps(y + i, _mm_mul_ps(_mm_loadu_ps(y + i), _mm_loadu_ps(x + i)));
+  for (; i < size; ++i) y[i] *= x[i];
+}
+
+ARTM_TARGET("sse4.1") float sse4_svprod(int size, const float *x, const float *y, float *z) {
+  __m128 acc = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 4 <= size; i += 4) {
+    const __m128 v = _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i));
+    _mm_storeu_ps(z + i, v);
+    acc = _mm_add_ps(acc, v);
+  }
+  float result = sse4_hsum(acc);
+  for (; i < size; ++i) {
+    z[i] = x[i] * y[i];
+    result += z[i];
+  }
+  return result;
+}
+
+ARTM_TARGET("sse4.1") void sse4_sscal(int size, float alpha, float *x) {
+  const __m128 a = _mm_set1_ps(alpha);
+  int i = 0;
+  for (; i + 4 <= size; i += 4)
+    _mm_storeu_ps(x + i, _mm_mul_ps(_mm_loadu_ps(x + i), a));
+  for (; i < size; ++i) x[i] *= alpha;
+}
+
+// AVX2 kernels (require FMA, which is present on every AVX2-capable CPU)
+
+ARTM_TARGET("avx2,fma") static inline float avx2_hsum(__m256 v) {
+  __m128 lo = _mm256_castps256_ps128(v);
+  __m128 hi = _mm256_extractf128_ps(v, 1);
+  lo = _mm_add_ps(lo, hi);
+  __m128 shuf = _mm_movehdup_ps(lo);
+  __m128 sums = _mm_add_ps(lo, shuf);
+  shuf = _mm_movehl_ps(shuf, sums);
+  sums = _mm_add_ss(sums, shuf);
+  return _mm_cvtss_f32(sums);
+}
+
+ARTM_TARGET("avx2,fma") static inline float avx2_dot(int size, const float *x, const float *y) {
+  __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= size; i += 16) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8), acc1);
+  }
+  for (; i + 8 <= size; i += 8)
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), acc0);
+  float result = avx2_hsum(_mm256_add_ps(acc0, acc1));
+  for (; i < size; ++i) result += x[i] * y[i];
+  return result;
+}
+
+ARTM_TARGET("avx2,fma") static inline void avx2_axpy(int size, float alpha, const float *x, float *y) {
+  const __m256 a = _mm256_set1_ps(alpha);
+  int i = 0;
+  for (; i + 8 <= size; i += 8)
+    _mm256_storeu_ps(y + i, _mm256_fmadd_ps(a, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+  for (; i < size; ++i) y[i] += alpha * x[i];
+}
+
+ARTM_TARGET("avx2,fma") float avx2_sdot(int size, const float *x, int xstride, const float *y, int ystride) {
+  if (xstride != 1 || ystride != 1) return builtin_sdot(size, x, xstride, y, ystride);
+  return avx2_dot(size, x, y);
+}
+
+ARTM_TARGET("avx2,fma") void avx2_saxpy(const int size, const float alpha,
+                                        const float *x, const int xstride, float *y, const int ystride) {
+  if (xstride != 1 || ystride != 1) return builtin_saxpy(size, alpha, x, xstride, y, ystride);
+  avx2_axpy(size, alpha, x, y);
+}
+
+ARTM_TARGET("avx2,fma") float avx2_sdotaxpy(int size, float numerator, const float *x, const float *y, float *z) {
+  const float p = avx2_dot(size, x, y);
+  if (p != 0.0f) avx2_axpy(size, numerator / p, x, z);
+  return p;
+}
+
+ARTM_TARGET("avx2,fma") void avx2_svmul(int size, const float *x, float *y) {
+  int i = 0;
+  for (; i + 8 <= size; i += 8)
+    _mm256_storeu_ps(y + i, _mm256_mul_ps(_mm256_loadu_ps(y + i), _mm256_loadu_ps(x + i)));
+  for (; i < size; ++i) y[i] *= x[i];
+}
+
+ARTM_TARGET("avx2,fma") float avx2_svprod(int size, const float *x, const float *y, float *z) {
+  __m256 acc = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= size; i += 8) {
+    const __m256 v = _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i));
+    _mm256_storeu_ps(z + i, v);
+    acc = _mm256_add_ps(acc, v);
+  }
+  float result = avx2_hsum(acc);
+  for (; i < size; ++i) {
+    z[i] = x[i] * y[i];
+    result += z[i];
+  }
+  return result;
+}
+
+ARTM_TARGET("avx2,fma") void avx2_sscal(int size, float alpha, float *x) {
+  const __m256 a = _mm256_set1_ps(alpha);
+  int i = 0;
+  for (; i + 8 <= size; i += 8)
+    _mm256_storeu_ps(x + i, _mm256_mul_ps(_mm256_loadu_ps(x + i), a));
+  for (; i < size; ++i) x[i] *= alpha;
+}
+
+// AVX-512 kernels (tails are handled with masked loads and stores)
+
+ARTM_TARGET("avx512f") static inline __mmask16 avx512_tail_mask(int n) {
+  return static_cast<__mmask16>((1u << n) - 1u);
+}
+
+// _mm512_reduce_add_ps and _mm512_castps512_ps256 are not used: GCC expands them through _mm256_undefined_pd,
+// which triggers -Wuninitialized / -Wmaybe-uninitialized. The halves are extracted with a full zero mask instead.
+ARTM_TARGET("avx512f") static inline float avx512_hsum(__m512 v) {
+  const __m256 lo = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xFF, _mm512_castps_pd(v), 0));
+  const __m256 hi = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xFF, _mm512_castps_pd(v), 1));
+  return avx2_hsum(_mm256_add_ps(lo, hi));
+}
+
+ARTM_TARGET("avx512f") static inline float avx512_dot(int size, const float *x, const float *y) {
+  __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+  int i = 0;
+  for (; i + 32 <= size; i += 32) {
+    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i), acc0);
+    acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i + 16), _mm512_loadu_ps(y + i + 16), acc1);
+  }
+  for (; i + 16 <= size; i += 16)
+    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i), acc0);
+  if (i < size) {
+    const __mmask16 m = avx512_tail_mask(size - i);
+    acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, x + i), _mm512_maskz_loadu_ps(m, y + i), acc1);
+  }
+  return avx512_hsum(_mm512_add_ps(acc0, acc1));
+}
+
+ARTM_TARGET("avx512f") static inline void avx512_axpy(int size, float alpha, const float *x, float *y) {
+  const __m512 a = _mm512_set1_ps(alpha);
+  int i = 0;
+  for (; i + 16 <= size; i += 16)
+    _mm512_storeu_ps(y + i, _mm512_fmadd_ps(a, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+  if (i < size) {
+    const __mmask16 m = avx512_tail_mask(size - i);
+    const __m512 v = _mm512_fmadd_ps(a, _mm512_maskz_loadu_ps(m, x + i), _mm512_maskz_loadu_ps(m, y + i));
+    _mm512_mask_storeu_ps(y + i, m, v);
+  }
+}
+
+ARTM_TARGET("avx512f") float avx512_sdot(int size, const float *x, int xstride, const float *y, int ystride) {
+  if (xstride != 1 || ystride != 1) return builtin_sdot(size, x, xstride, y, ystride);
+  return avx512_dot(size, x, y);
+}
+
+ARTM_TARGET("avx512f") void avx512_saxpy(const int size, const float alpha,
+                                         const float *x, const int xstride, float *y, const int ystride) {
+  if (xstride != 1 || ystride != 1) return builtin_saxpy(size, alpha, x, xstride, y, ystride);
+  avx512_axpy(size, alpha, x, y);
+}
+
+ARTM_TARGET("avx512f") float avx512_sdotaxpy(int size, float numerator, const float *x, const float *y, float *z) {
+  const float p = avx512_dot(size, x, y);
+  if (p != 0.0f) avx512_axpy(size, numerator / p, x, z);
+  return p;
+}
+
+ARTM_TARGET("avx512f") void avx512_svmul(int size, const float *x, float *y) {
+  int i = 0;
+  for (; i + 16 <= size; i += 16)
+    _mm512_storeu_ps(y + i, _mm512_mul_ps(_mm512_loadu_ps(y + i), _mm512_loadu_ps(x + i)));
+  if (i < size) {
+    const __mmask16 m = avx512_tail_mask(size - i);
+    const __m512 v = _mm512_mul_ps(_mm512_maskz_loadu_ps(m, y + i), _mm512_maskz_loadu_ps(m, x + i));
+    _mm512_mask_storeu_ps(y + i, m, v);
+  }
+}
+
+ARTM_TARGET("avx512f") float avx512_svprod(int size, const float *x, const float *y, float *z) {
+  __m512 acc = _mm512_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= size; i += 16) {
+    const __m512 v = _mm512_mul_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i));
+    _mm512_storeu_ps(z + i, v);
+    acc = _mm512_add_ps(acc, v);
+  }
+  if (i < size) {
+    const __mmask16 m = avx512_tail_mask(size - i);
+    const __m512 v = _mm512_mul_ps(_mm512_maskz_loadu_ps(m, x + i), _mm512_maskz_loadu_ps(m, y + i));
+    _mm512_mask_storeu_ps(z + i, m, v);
+    acc = _mm512_add_ps(acc, v);
+  }
+  return avx512_hsum(acc);
+}
+
+ARTM_TARGET("avx512f") void avx512_sscal(int size, float alpha, float *x) {
+  const __m512 a = _mm512_set1_ps(alpha);
+  int i = 0;
+  for (; i + 16 <= size; i += 16)
+    _mm512_storeu_ps(x + i, _mm512_mul_ps(_mm512_loadu_ps(x + i), a));
+  if (i < size) {
+    const __mmask16 m = avx512_tail_mask(size - i);
+    _mm512_mask_storeu_ps(x + i, m, _mm512_mul_ps(_mm512_maskz_loadu_ps(m, x + i), a));
+  }
+}
+
+#undef ARTM_TARGET
+#endif  // ARTM_BLAS_X86_KERNELS
+
 // Convert sparse matrix from CSC to CSR format
 // CSC and CSR format described here: http://docs.nvidia.com/cuda/cusparse/#compressed-sparse-row-format-csr
 // Here is short summary for CSR format (Compressed Sparse Row Format):
@@ -113,22 +416,107 @@ void builtin_sgemm(int order, const int transa, const int transb,
 
 class BuiltinBlas : public Blas {
  public:
-  BuiltinBlas() {
+  explicit BuiltinBlas(InstructionSet isa = Generic) {
     sgemm = builtin_sgemm;
     sdot = builtin_sdot;
     saxpy = builtin_saxpy;
+    sdotaxpy = builtin_sdotaxpy;
+    svmul = builtin_svmul;
+    svprod = builtin_svprod;
+    sscal = builtin_sscal;
     scsr2csc = builtin_scsr2csc;
+    instruction_set = Generic;
+
+#if defined(ARTM_BLAS_X86_KERNELS)
+    if (isa == Sse4) {
+      sdot = sse4_sdot;
+      saxpy = sse4_saxpy;
+      sdotaxpy = sse4_sdotaxpy;
+      svmul = sse4_svmul;
+      svprod = sse4_svprod;
+      sscal = sse4_sscal;
+      instruction_set = Sse4;
+    } else if (isa == Avx2) {
+      sdot = avx2_sdot;
+      saxpy = avx2_saxpy;
+      sdotaxpy = avx2_sdotaxpy;
+      svmul = avx2_svmul;
+      svprod = avx2_svprod;
+      sscal = avx2_sscal;
+      instruction_set = Avx2;
+    } else if (isa == Avx512) {
+      sdot = avx512_sdot;
+      saxpy = avx512_saxpy;
+      sdotaxpy = avx512_sdotaxpy;
+      svmul = avx512_svmul;
+      svprod = avx512_svprod;
+      sscal = avx512_sscal;
+      instruction_set = Avx512;
+    }
+#endif
   }
 
   virtual bool is_loaded() { return true; }
 };
 
+Blas::InstructionSet DetectInstructionSet() {
+  if (Blas::is_supported(Blas::Avx512)) return Blas::Avx512;
+  if (Blas::is_supported(Blas::Avx2)) return Blas::Avx2;
+  if (Blas::is_supported(Blas::Sse4)) return Blas::Sse4;
+  return Blas::Generic;
+}
+
 }  // namespace
 
+bool Blas::is_supported(InstructionSet instruction_set) {
+#if defined(ARTM_BLAS_X86_KERNELS)
+  // __builtin_cpu_supports also verifies that the OS saves the extended register state
+  __builtin_cpu_init();
+  switch (instruction_set) {
+    case Generic: return true;
+    case Sse4: return __builtin_cpu_supports("sse4.1") != 0;
+    case Avx2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case Avx512: return __builtin_cpu_supports("avx512f") != 0;
+  }
+  return false;
+#else
+  return instruction_set == Generic;
+#endif
+}
+
+const char* Blas::instruction_set_name(InstructionSet instruction_set) {
+  switch (instruction_set) {
+    case Generic: return "generic";
+    case Sse4: return "sse4";
+    case Avx2: return "avx2";
+    case Avx512: return "avx512";
+  }
+  return "unknown";
+}
 
 Blas* Blas::builtin() {
-  static BuiltinBlas impl;
-  return &impl;
+  static Blas* impl = [] {
+    InstructionSet isa = DetectInstructionSet();
+    LOG(INFO) << "Using " << instruction_set_name(isa) << " kernels for builtin blas";
+    return builtin(isa);
+  }();
+  return impl;
+}
+
+Blas* Blas::builtin(InstructionSet instruction_set) {
+  if (!is_supported(instruction_set))
+    return nullptr;
+
+  static BuiltinBlas generic_impl(Generic);
+  static BuiltinBlas sse4_impl(Sse4);
+  static BuiltinBlas avx2_impl(Avx2);
+  static BuiltinBlas avx512_impl(Avx512);
+  switch (instruction_set) {
+    case Sse4: return &sse4_impl;
+    case Avx2: return &avx2_impl;
+    case Avx512: return &avx512_impl;
+    default: return &generic_impl;
+  }
 }
 
 }  // namespace utility
@@ -28,6 +28,20 @@ typedef void blas_saxpy_type(const int size, const float alpha,
                              const float *x, const int xstride,
                              float *y, const int ystride);
 
+// Fused kernel for the E-step: computes p = <x, y> and, unless p is zero, performs z += (numerator / p) * x.
+// Returns p. All vectors must be contiguous.
+typedef float blas_sdotaxpy_type(int size, float numerator,
+                                 const float *x, const float *y, float *z);
+
+// Element-wise product y[i] *= x[i].
+typedef void blas_svmul_type(int size, const float *x, float *y);
+
+// Element-wise product z[i] = x[i] * y[i]; returns the sum of z.
+typedef float blas_svprod_type(int size, const float *x, const float *y, float *z);
+
+// Scaling x[i] *= alpha.
+typedef void blas_sscal_type(int size, float alpha, float *x);
+
 typedef void blas_scsr2csc_type(int m, int n, int nnz,
                             const float *csr_val, const int* csr_row_ptr, const int *csr_col_ind,
                                   float *csc_val,       int* csc_row_ind,       int* csc_col_ptr);
@@ -44,12 +58,26 @@ namespace utility {
 
 class Blas {
  public:
+  // Instruction sets for which hand-written kernels exist.
+  // Generic is always available; others depend on the host CPU.
+  enum InstructionSet {
+    Generic = 0,
+    Sse4 = 1,
+    Avx2 = 2,
+    Avx512 = 3,
+  };
+
   virtual ~Blas() {}
   virtual bool is_loaded() = 0;
   blas_sgemm_type* sgemm;
   blas_saxpy_type* saxpy;
   blas_sdot_type*  sdot;
+  blas_sdotaxpy_type* sdotaxpy;
+  blas_svmul_type* svmul;
+  blas_svprod_type* svprod;
+  blas_sscal_type* sscal;
   blas_scsr2csc_type* scsr2csc;
+  InstructionSet instruction_set;
 
   static const int RowMajor = 101;
   static const int ColMajor = 102;
@@ -57,8 +85,15 @@ class Blas {
   static const int Trans = 112;
   static const int ConfTrans = 113;
 
+  // Returns kernels for the best instruction set supported by the host CPU.
+  // The choice is made once, on the first call.
   static Blas* builtin();
 
+  // Returns kernels for a specific instruction set, or nullptr if the host CPU does not support it.
+  static Blas* builtin(InstructionSet instruction_set);
+  static bool is_supported(InstructionSet instruction_set);
+  static const char* instruction_set_name(InstructionSet instruction_set);
+
  protected:
   Blas() { }  // Singleton (make constructor private)
 };
@@ -188,14 +223,16 @@ class LocalPhiMatrix : public DenseMatrix<T> {
 template<typename T>
 class CsrMatrix {
  public:
-  explicit CsrMatrix(int m, int n, int nnz) : m_(m), n_(n), nnz_(nnz) {
+  explicit CsrMatrix(int m, int n, int nnz) : m_(m), n_(n), nnz_(nnz), holder_() {
     assert(m > 0 && n > 0 && nnz > 0);
     val_.resize(nnz);
     col_ind_.resize(nnz);
     row_ptr_.resize(m + 1);
+    Attach();
   }
 
-  explicit CsrMatrix(int n, std::vector<T>* val, std::vector<int>* row_ptr, std::vector<int>* col_ind) {
+  explicit CsrMatrix(int n, std::vector<T>* val, std::vector<int>* row_ptr, std::vector<int>* col_ind)
+      : holder_() {
     assert(val != nullptr && row_ptr != nullptr && col_ind != nullptr);
     m_ = static_cast<int>(row_ptr->size()) - 1;
     n_ = n;  // this parameter can't be deduced automatically
@@ -203,23 +240,42 @@ class CsrMatrix {
     val_.swap(*val);
     row_ptr_.swap(*row_ptr);
     col_ind_.swap(*col_ind);
+    Attach();
+  }
+
+  // Creates a read-only matrix over the arrays owned by 'holder' (e.g. a memory-mapped file) without copying them.
+  // Only const accessors may be used; a copy of the matrix owns its arrays and is writable.
+  explicit CsrMatrix(int m, int n, int nnz, const T* val, const int* row_ptr, const int* col_ind,
+                     std::shared_ptr<const void> holder)
+      : m_(m), n_(n), nnz_(nnz), holder_(holder),
+        val_ptr_(val), row_ptr_ptr_(row_ptr), col_ind_ptr_(col_ind) {}
+
+  CsrMatrix(const CsrMatrix& rhs)
+      : m_(rhs.m_), n_(rhs.n_), nnz_(rhs.nnz_), holder_(),
+        val_(rhs.val(), rhs.val() + rhs.nnz_),
+        row_ptr_(rhs.row_ptr(), rhs.row_ptr() + rhs.m_ + 1),
+        col_ind_(rhs.col_ind(), rhs.col_ind() + rhs.nnz_) {
+    Attach();
   }
 
+  CsrMatrix& operator=(const CsrMatrix&) = delete;
+
   void Transpose(artm::utility::Blas* blas) {
     std::vector<int> row_ptr_new_(n_ + 1);
     blas->scsr2csc(m_, n_, nnz_, val(), row_ptr(), col_ind(), val(), col_ind(), &row_ptr_new_[0]);
     int tmp = m_; m_ = n_; n_ = tmp;  // swat(m, n)
     row_ptr_.swap(row_ptr_new_);
+    Attach();
   }
 
-  T* val() { return &val_[0]; }
-  const T* val() const { return &val_[0]; }
+  T* val() { assert(holder_ == nullptr); return &val_[0]; }
+  const T* val() const { return val_ptr_; }
 
-  int* row_ptr() { return &row_ptr_[0]; }
-  const int* row_ptr() const { return &row_ptr_[0]; }
+  int* row_ptr() { assert(holder_ == nullptr); return &row_ptr_[0]; }
+  const int* row_ptr() const { return row_ptr_ptr_; }
 
-  int* col_ind() { return &col_ind_[0]; }
-  const int* col_ind() const { return &col_ind_[0]; }
+  int* col_ind() { assert(holder_ == nullptr); return &col_ind_[0]; }
+  const int* col_ind() const { return col_ind_ptr_; }
 
   int m() const { return m_; }
   int n() const { return n_; }
@@ -229,9 +285,19 @@ class CsrMatrix {
   int m_;
   int n_;
   int nnz_;
+  std::shared_ptr<const void> holder_;  // keeps external arrays alive; empty when the arrays below are used
   std::vector<T> val_;
   std::vector<int> row_ptr_;
   std::vector<int> col_ind_;
+  const T* val_ptr_;
+  const int* row_ptr_ptr_;
+  const int* col_ind_ptr_;
+
+  void Attach() {
+    val_ptr_ = val_.data();
+    row_ptr_ptr_ = row_ptr_.data();
+    col_ind_ptr_ = col_ind_.data();
+  }
 };
 
 template<typename T>
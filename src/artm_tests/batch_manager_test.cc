@@ -3,8 +3,11 @@
 #include "gtest/gtest.h"
 
 #include "artm/core/batch_manager.h"
+#include "artm/core/batch_loader.h"
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "boost/uuid/random_generator.hpp"
 #include "boost/uuid/uuid.hpp"
@@ -36,3 +39,46 @@ TEST(BatchManager, Basic) {
   batch_manager.Callback(u2);
   ASSERT_TRUE(batch_manager.IsEverythingProcessed());
 }
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=TokenIndexCache.*
+TEST(TokenIndexCache, Basic) {
+  typedef ::artm::core::TokenIndexCache TokenIndexCache;
+  const int num_tokens = 100;
+  TokenIndexCache cache(/* max_byte_size =*/ 1024 * 1024);
+  TokenIndexCache::BatchStamp stamp;
+  stamp.file_size = 1000;
+  stamp.last_write_time = 1;
+
+  auto token_id = std::make_shared<const std::vector<int>>(num_tokens, 0);
+  cache.set("batch", 1, stamp, token_id);
+  ASSERT_EQ(cache.get("batch", 1, stamp), token_id);
+
+  // A batch file rewritten under the same name must not reuse the entry
+  TokenIndexCache::BatchStamp rewritten = stamp;
+  rewritten.last_write_time = 2;
+  ASSERT_EQ(cache.get("batch", 1, rewritten), nullptr);
+
+  // Entries with outdated token set version are dropped
+  cache.set("batch", 1, stamp, token_id);
+  ASSERT_EQ(cache.get("batch", 2, stamp), nullptr);
+  ASSERT_EQ(cache.size(), 0);
+  ASSERT_EQ(cache.ByteSize(), 0);
+
+  // Least recently used entries are evicted once the cache exceeds its budget
+  const int64_t entry_size = sizeof(int) * num_tokens + 2;
+  cache.set_max_byte_size(3 * entry_size);
+  for (int i = 0; i < 3; ++i)
+    cache.set("b" + std::to_string(i), 1, stamp, token_id);
+  ASSERT_EQ(cache.get("b0", 1, stamp), token_id);
+  cache.set("b3", 1, stamp, token_id);
+  ASSERT_EQ(cache.size(), 3);
+  ASSERT_EQ(cache.ByteSize(), 3 * entry_size);
+  ASSERT_EQ(cache.get("b1", 1, stamp), nullptr);
+  ASSERT_EQ(cache.get("b0", 1, stamp), token_id);
+
+  cache.erase("b0");
+  ASSERT_EQ(cache.get("b0", 1, stamp), nullptr);
+  cache.set_max_byte_size(0);
+  ASSERT_EQ(cache.size(), 0);
+}
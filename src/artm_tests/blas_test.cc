@@ -1,7 +1,11 @@
 // Copyright 2014, Additive Regularization of Topic Models.
 
+#include <vector>
+
 #include "gtest/gtest.h"
 
+#include "glog/logging.h"
+
 #include "artm/utility/blas.h"
 
 using namespace artm::utility;  // NOLINT
@@ -57,3 +61,57 @@ TEST(Blas, scsr2csc) {
   for (int i = 0; i < nnz; ++i) EXPECT_EQ(csr_col_ind2[i], csr_col_ind[i]);
   for (int i = 0; i < (m + 1); ++i) EXPECT_EQ(csr_row_ptr2[i], csr_row_ptr[i]);
 }
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=Blas.InstructionSets
+TEST(Blas, InstructionSets) {
+  ASSERT_NE(Blas::builtin(Blas::Generic), nullptr);
+  ASSERT_NE(Blas::builtin(), nullptr);
+  ASSERT_TRUE(Blas::is_supported(Blas::builtin()->instruction_set));
+
+  // Sizes cover empty vectors, partial SIMD registers and unrolled loops
+  const int sizes[] = { 0, 1, 3, 4, 7, 8, 15, 16, 17, 31, 33, 200 };
+  const float tol = 1e-4f;
+
+  Blas* generic = Blas::builtin(Blas::Generic);
+  for (Blas::InstructionSet isa : { Blas::Sse4, Blas::Avx2, Blas::Avx512 }) {
+    Blas* blas = Blas::builtin(isa);
+    if (blas == nullptr) {
+      LOG(INFO) << "Skipping " << Blas::instruction_set_name(isa) << " kernels (not supported by the host CPU)";
+      continue;
+    }
+
+    ASSERT_EQ(blas->instruction_set, isa);
+    for (int size : sizes) {
+      std::vector<float> x(size + 1), y(size + 1), z1(size + 1), z2(size + 1);
+      for (int i = 0; i <= size; ++i) {
+        x[i] = static_cast<float>((i * 7) % 11) / 11.0f;
+        y[i] = static_cast<float>((i * 5) % 13) / 13.0f;
+        z1[i] = z2[i] = static_cast<float>(i % 3);
+      }
+
+      EXPECT_NEAR(blas->sdot(size, &x[0], 1, &y[0], 1), generic->sdot(size, &x[0], 1, &y[0], 1), tol);
+      EXPECT_NEAR(blas->sdot(size / 2, &x[0], 2, &y[0], 1), generic->sdot(size / 2, &x[0], 2, &y[0], 1), tol);
+
+      blas->saxpy(size, 0.5f, &x[0], 1, &z1[0], 1);
+      generic->saxpy(size, 0.5f, &x[0], 1, &z2[0], 1);
+      for (int i = 0; i <= size; ++i) EXPECT_NEAR(z1[i], z2[i], tol);
+
+      float p1 = blas->sdotaxpy(size, 2.0f, &x[0], &y[0], &z1[0]);
+      float p2 = generic->sdotaxpy(size, 2.0f, &x[0], &y[0], &z2[0]);
+      EXPECT_NEAR(p1, p2, tol);
+      for (int i = 0; i <= size; ++i) EXPECT_NEAR(z1[i], z2[i], tol);
+
+      blas->svmul(size, &x[0], &z1[0]);
+      generic->svmul(size, &x[0], &z2[0]);
+      for (int i = 0; i <= size; ++i) EXPECT_NEAR(z1[i], z2[i], tol);
+
+      EXPECT_NEAR(blas->svprod(size, &x[0], &y[0], &z1[0]), generic->svprod(size, &x[0], &y[0], &z2[0]), tol);
+      for (int i = 0; i <= size; ++i) EXPECT_NEAR(z1[i], z2[i], tol);
+
+      blas->sscal(size, 3.0f, &z1[0]);
+      generic->sscal(size, 3.0f, &z2[0]);
+      for (int i = 0; i <= size; ++i) EXPECT_NEAR(z1[i], z2[i], tol);
+    }
+  }
+}
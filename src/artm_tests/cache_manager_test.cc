@@ -1,6 +1,9 @@
 // Copyright 2014, Additive Regularization of Topic Models.
 
+#include <fstream>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -9,6 +12,7 @@
 #include "boost/filesystem.hpp"
 
 #include "artm/cpp_interface.h"
+#include "artm/core/cache_manager.h"
 #include "artm/core/common.h"
 #include "artm_tests/test_mother.h"
 #include "artm_tests/api.h"
@@ -73,3 +77,130 @@ TEST(CacheManager, Basic) {
 TEST(CacheManager, DiskCache) {
   RunTest(true);
 }
+
+namespace {
+::artm::ThetaMatrix GenerateCacheEntry(int batch_index, int num_items, int num_topics, bool sparse) {
+  ::artm::ThetaMatrix theta;
+  for (int topic_index = 0; topic_index < num_topics; ++topic_index)
+    theta.add_topic_name("topic" + std::to_string(topic_index));
+
+  for (int item_index = 0; item_index < num_items; ++item_index) {
+    theta.add_item_id(batch_index * num_items + item_index);
+    theta.add_item_title(item_index % 2 == 0 ? std::string() : "title" + std::to_string(item_index));
+    ::artm::FloatArray* weights = theta.add_item_weights();
+    ::artm::IntArray* indices = sparse ? theta.add_topic_indices() : nullptr;
+    for (int topic_index = 0; topic_index < num_topics; ++topic_index) {
+      if (sparse && (item_index + topic_index) % 3 == 0)
+        continue;
+      weights->add_value(static_cast<float>(batch_index + 1) / (item_index + topic_index + 2));
+      if (sparse)
+        indices->add_value(topic_index);
+    }
+  }
+
+  return theta;
+}
+
+void CompareCacheEntries(const ::artm::ThetaMatrix& expected, const ::artm::ThetaMatrix& actual, float relative_tolerance) {
+  ASSERT_EQ(expected.item_id_size(), actual.item_id_size());
+  ASSERT_EQ(expected.item_weights_size(), actual.item_weights_size());
+  ASSERT_EQ(expected.topic_indices_size(), actual.topic_indices_size());
+  for (int i = 0; i < expected.topic_name_size(); ++i)
+    EXPECT_EQ(expected.topic_name(i), actual.topic_name(i));
+  for (int item_index = 0; item_index < expected.item_id_size(); ++item_index) {
+    EXPECT_EQ(expected.item_id(item_index), actual.item_id(item_index));
+    EXPECT_EQ(expected.item_title(item_index), actual.item_title(item_index));
+    const ::artm::FloatArray& expected_weights = expected.item_weights(item_index);
+    ASSERT_EQ(expected_weights.value_size(), actual.item_weights(item_index).value_size());
+    for (int i = 0; i < expected_weights.value_size(); ++i)
+      EXPECT_NEAR(expected_weights.value(i), actual.item_weights(item_index).value(i),
+                  relative_tolerance * expected_weights.value(i));
+    if (expected.topic_indices_size() > 0) {
+      EXPECT_EQ(expected.topic_indices(item_index).SerializeAsString(),
+                actual.topic_indices(item_index).SerializeAsString());
+    }
+  }
+}
+}  // namespace
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=CacheManager.MemoryLimit
+TEST(CacheManager, MemoryLimit) {
+  const int num_batches = 8, num_items = 20, num_topics = 10;
+  std::string target_path = artm::test::Helpers::getUniqueString();
+
+  for (bool use_float16 : { false, true }) {
+    for (bool sparse : { false, true }) {
+      // The budget fits about two batches, so the rest is spilled to disk
+      ::artm::core::CacheManager cache_manager(target_path, 2 * num_items * num_topics * sizeof(float), use_float16);
+      for (int batch_index = 0; batch_index < num_batches; ++batch_index)
+        cache_manager.UpdateCacheEntry(std::to_string(batch_index),
+                                       GenerateCacheEntry(batch_index, num_items, num_topics, sparse));
+
+      // Replaced entries must be returned with the latest content
+      cache_manager.UpdateCacheEntry("0", GenerateCacheEntry(100, num_items, num_topics, sparse));
+
+      // Spilling is asynchronous, so wait until the writer thread is done
+      cache_manager.WaitForSpill();
+      EXPECT_TRUE(boost::filesystem::exists(target_path) && !boost::filesystem::is_empty(target_path));
+
+      const float relative_tolerance = use_float16 ? 1e-3f : 0.0f;
+      for (int batch_index = 0; batch_index < num_batches; ++batch_index) {
+        auto entry = cache_manager.FindCacheEntry(std::to_string(batch_index));
+        ASSERT_NE(entry, nullptr);
+        CompareCacheEntries(GenerateCacheEntry(batch_index == 0 ? 100 : batch_index, num_items, num_topics, sparse),
+                            *entry, relative_tolerance);
+      }
+
+      // Direct copy of item weights is only available for dense entries
+      auto compact_entry = cache_manager.FindCompactCacheEntry("1");
+      ASSERT_NE(compact_entry, nullptr);
+      ASSERT_EQ(compact_entry->item_size(), num_items);
+      EXPECT_EQ(compact_entry->item_id(3), num_items + 3);
+      std::vector<float> weights(num_topics, -1.0f);
+      EXPECT_EQ(compact_entry->CopyItemWeights(3, num_topics, &weights[0]), !sparse);
+      EXPECT_FALSE(compact_entry->CopyItemWeights(3, num_topics + 1, &weights[0]));
+      if (!sparse) {
+        EXPECT_NEAR(weights[2], 2.0f / 7, relative_tolerance);
+      }
+
+      EXPECT_EQ(cache_manager.FindCacheEntry("missing"), nullptr);
+      ::artm::MasterComponentInfo info;
+      cache_manager.RequestMasterComponentInfo(&info);
+      EXPECT_EQ(info.cache_entry_size(), num_batches);
+    }
+  }
+
+  try { boost::filesystem::remove_all(target_path); }
+  catch (...) {}
+}
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=CacheManager.SpillFailure
+TEST(CacheManager, SpillFailure) {
+  const int num_batches = 4, num_items = 20, num_topics = 10;
+
+  // Spill files can not be created, because disk path is a regular file
+  std::string target_path = artm::test::Helpers::getUniqueString();
+  std::ofstream(target_path.c_str()) << "not a folder";
+
+  {
+    ::artm::core::CacheManager cache_manager(target_path, num_items * num_topics * sizeof(float));
+    for (int pass = 0; pass < 2; ++pass) {
+      for (int batch_index = 0; batch_index < num_batches; ++batch_index)
+        cache_manager.UpdateCacheEntry(std::to_string(batch_index),
+                                       GenerateCacheEntry(batch_index, num_items, num_topics, false));
+      cache_manager.WaitForSpill();
+    }
+
+    // All entries are kept in memory
+    for (int batch_index = 0; batch_index < num_batches; ++batch_index) {
+      auto entry = cache_manager.FindCacheEntry(std::to_string(batch_index));
+      ASSERT_NE(entry, nullptr);
+      CompareCacheEntries(GenerateCacheEntry(batch_index, num_items, num_topics, false), *entry, 0.0f);
+    }
+  }
+
+  try { boost::filesystem::remove(target_path); }
+  catch (...) {}
+}
@@ -1,5 +1,9 @@
 // Copyright 2014, Additive Regularization of Topic Models.
 
+#include <cmath>
+#include <map>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "boost/filesystem.hpp"
@@ -184,3 +188,265 @@ TEST(MasterModel, TestEmptyMasterModel) {
   auto info = model.info();
   EXPECT_EQ(info.num_processors(), 0);
 }
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=MasterModel.ThetaConvergenceTolerance
+TEST(MasterModel, ThetaConvergenceTolerance) {
+  const int nTopics = 5, nBatches = 20, nTokens = 30, nPasses = 10;
+  auto batches = ::artm::test::TestMother::GenerateBatches(nBatches, nTokens);
+
+  ::artm::GetScoreValueArgs get_score_args;
+  get_score_args.set_score_name("ItemsProcessed");
+
+  std::vector<int64_t> total_passes;
+  for (float tolerance : { 0.0f, 1e-3f, 10.0f }) {
+    ::artm::MasterModelConfig config = ::artm::test::TestMother::GenerateMasterModelConfig(nTopics);
+    config.set_num_document_passes(nPasses);
+    config.set_theta_convergence_tolerance(tolerance);
+    ::artm::ScoreConfig* score_config = config.add_score_config();
+    score_config->set_type(::artm::ScoreType_ItemsProcessed);
+    score_config->set_name("ItemsProcessed");
+    score_config->set_config(::artm::ItemsProcessedScoreConfig().SerializeAsString());
+
+    ::artm::MasterModel master_model(config);
+    ::artm::test::Api api(master_model);
+    master_model.FitOfflineModel(api.Initialize(batches));
+
+    auto items_processed = master_model.GetScoreAs< ::artm::ItemsProcessedScore>(get_score_args);
+    ASSERT_EQ(items_processed.value(), nBatches);
+    total_passes.push_back(items_processed.total_document_passes());
+  }
+
+  EXPECT_EQ(total_passes[0], nBatches * nPasses);  // zero tolerance always runs all passes
+  EXPECT_LE(total_passes[1], total_passes[0]);
+  EXPECT_EQ(total_passes[2], nBatches);  // L1 distance between two distributions never exceeds 2
+}
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=MasterModel.ActiveTopics
+TEST(MasterModel, ActiveTopics) {
+  const int nTopics = 10, nBatches = 20, nTokens = 30, nActiveTopics = 3;
+  auto batches = ::artm::test::TestMother::GenerateBatches(nBatches, nTokens);
+
+  ::artm::MasterModelConfig config = ::artm::test::TestMother::GenerateMasterModelConfig(nTopics);
+  config.set_num_document_passes(5);
+  config.set_num_active_topics(nActiveTopics);
+  ::artm::MasterModel master_model(config);
+  ::artm::test::Api api(master_model);
+
+  auto offline_args = api.Initialize(batches);
+  for (int iter = 0; iter < 3; ++iter)
+    master_model.FitOfflineModel(offline_args);
+
+  ::artm::TransformMasterModelArgs transform_args;
+  transform_args.mutable_batch_filename()->CopyFrom(offline_args.batch_filename());
+  transform_args.set_theta_matrix_type(::artm::ThetaMatrixType_Dense);
+  ::artm::ThetaMatrix theta = master_model.Transform(transform_args);
+
+  ASSERT_EQ(theta.item_id_size(), nBatches);
+  for (int item_index = 0; item_index < theta.item_id_size(); ++item_index) {
+    int num_nonzeros = 0;
+    float sum = 0.0f;
+    for (float value : theta.item_weights(item_index).value()) {
+      if (value > 0.0f) num_nonzeros++;
+      sum += value;
+    }
+
+    EXPECT_LE(num_nonzeros, nActiveTopics);
+    EXPECT_NEAR(sum, 1.0f, 1e-4);
+  }
+}
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=MasterModel.IncrementalNormalization
+TEST(MasterModel, IncrementalNormalization) {
+  const int nTopics = 5, nBatches = 20, nTokens = 60, nPasses = 3;
+  auto batches = ::artm::test::TestMother::GenerateBatches(nBatches, nTokens);
+
+  ::artm::GetScoreValueArgs get_score_args;
+  get_score_args.set_score_name("Perplexity");
+
+  std::vector<float> perplexity;
+  for (float tolerance : { 0.0f, 0.5f }) {
+    ::artm::MasterModelConfig config = ::artm::test::TestMother::GenerateMasterModelConfig(nTopics);
+    config.set_incremental_normalization_tolerance(tolerance);
+    ::artm::ScoreConfig* score_config = config.add_score_config();
+    score_config->set_type(::artm::ScoreType_Perplexity);
+    score_config->set_name("Perplexity");
+    score_config->set_config(::artm::PerplexityScoreConfig().SerializeAsString());
+
+    ::artm::MasterModel master_model(config);
+    ::artm::test::Api api(master_model);
+    auto offline_args = api.Initialize(batches);
+
+    ::artm::FitOnlineMasterModelArgs online_args;
+    online_args.mutable_batch_filename()->CopyFrom(offline_args.batch_filename());
+    for (int update = 1; update <= nBatches; ++update) {
+      online_args.add_update_after(update);
+      online_args.add_apply_weight(update == 1 ? 1.0f : 0.1f);
+    }
+
+    for (int pass = 0; pass < nPasses; ++pass)
+      master_model.FitOnlineModel(online_args);
+    perplexity.push_back(master_model.GetScoreAs< ::artm::PerplexityScore>(get_score_args).value());
+
+    // Each pass ends with a full normalization
+    ::artm::TopicModel topic_model = master_model.GetTopicModel();
+    std::vector<float> sum(nTopics, 0.0f);
+    for (int token_index = 0; token_index < topic_model.token_size(); ++token_index) {
+      for (int topic_index = 0; topic_index < nTopics; ++topic_index)
+        sum[topic_index] += topic_model.token_weights(token_index).value(topic_index);
+    }
+
+    for (int topic_index = 0; topic_index < nTopics; ++topic_index)
+      EXPECT_NEAR(sum[topic_index], 1.0f, 1e-4);
+  }
+
+  EXPECT_NEAR(perplexity[1], perplexity[0], 0.05 * perplexity[0]);
+}
+
+// Runs one online pass, where the first batch covers the whole vocabulary and every next batch covers only
+// a small window of it, and returns p_wt after each update as (topic_index, token) -> weight from TopTokens score.
+// All batches have equal total weight, so n_t stays steady while normalizers of the lazily decayed n_wt grow.
+static std::vector<std::map<std::pair<int, std::string>, float>>
+runIncrementalNormalization(float tolerance, int nTopics, int nTokens) {
+  const int nBatches = 20, nWindowTokens = 10, nItems = 2;
+  std::vector<std::shared_ptr< ::artm::Batch>> batches;
+  for (int iBatch = 0; iBatch < nBatches; ++iBatch) {
+    const int nBatchTokens = (iBatch == 0) ? nTokens : nWindowTokens;
+    auto batch = std::make_shared< ::artm::Batch>();
+    batch->set_id(::artm::test::Helpers::getUniqueString());
+    for (int i = 0; i < nBatchTokens; ++i)
+      batch->add_token("token" + std::to_string((iBatch * nWindowTokens + i) % nTokens));
+    for (int iItem = 0; iItem < nItems; ++iItem) {
+      ::artm::Item* item = batch->add_item();
+      item->set_id(iBatch * nItems + iItem);
+      for (int i = iItem; i < nBatchTokens; i += nItems) {
+        item->add_token_id(i);
+        item->add_token_weight(static_cast<float>(nTokens / nBatchTokens));
+      }
+    }
+    batches.push_back(batch);
+  }
+
+  ::artm::MasterModelConfig config = ::artm::test::TestMother::GenerateMasterModelConfig(nTopics);
+  config.set_num_processors(1);
+  config.set_incremental_normalization_tolerance(tolerance);
+  ::artm::TopTokensScoreConfig top_tokens_config;
+  top_tokens_config.set_num_tokens(nTokens);
+  ::artm::ScoreConfig* score_config = config.add_score_config();
+  score_config->set_type(::artm::ScoreType_TopTokens);
+  score_config->set_name("TopTokens");
+  score_config->set_config(top_tokens_config.SerializeAsString());
+
+  ::artm::MasterModel master_model(config);
+  ::artm::test::Api api(master_model);
+  auto offline_args = api.Initialize(batches);
+
+  // Steady n_t with a slow decay, so that normalizers of n_wt storage grow on every update
+  ::artm::FitOnlineMasterModelArgs online_args;
+  online_args.mutable_batch_filename()->CopyFrom(offline_args.batch_filename());
+  for (int update = 1; update <= nBatches; ++update) {
+    online_args.add_update_after(update);
+    online_args.add_apply_weight(update == 1 ? 1.0f : 0.05f);
+    online_args.add_decay_weight(update == 1 ? 0.0f : 0.95f);
+  }
+  master_model.FitOnlineModel(online_args);
+
+  ::artm::GetScoreArrayArgs get_score_array_args;
+  get_score_array_args.set_score_name("TopTokens");
+  std::vector<std::map<std::pair<int, std::string>, float>> retval;
+  for (const auto& top_tokens : master_model.GetScoreArrayAs< ::artm::TopTokensScore>(get_score_array_args)) {
+    retval.push_back(std::map<std::pair<int, std::string>, float>());
+    for (int i = 0; i < top_tokens.num_entries(); ++i)
+      retval.back()[std::make_pair(top_tokens.topic_index(i), top_tokens.token(i))] = top_tokens.weight(i);
+  }
+  return retval;
+}
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=MasterModel.IncrementalNormalizationUntouchedRows
+TEST(MasterModel, IncrementalNormalizationUntouchedRows) {
+  const int nTopics = 5, nTokens = 100;
+  const float tolerance = 0.1f;
+  auto full = runIncrementalNormalization(0.0f, nTopics, nTokens);
+  auto incremental = runIncrementalNormalization(tolerance, nTopics, nTokens);
+  ASSERT_EQ(full.size(), incremental.size());
+  ASSERT_GE(full.size(), 2);
+
+  // Both runs see the same n_wt until the second update, because p_wt is fully normalized after the first one.
+  // Each row of incrementally normalized p_wt may only be off by a factor within the tolerance.
+  for (int update = 0; update < 2; ++update) {
+    for (const auto& entry : full[update]) {
+      auto iter = incremental[update].find(entry.first);
+      const float value = (iter == incremental[update].end()) ? 0.0f : iter->second;
+      EXPECT_NEAR(value, entry.second, tolerance * entry.second + 1e-6);
+    }
+  }
+
+  // Afterwards the runs diverge, but p_wt of the incremental run must remain normalized within the tolerance
+  bool has_incremental_updates = false;
+  for (const auto& pwt : incremental) {
+    std::vector<float> sum(nTopics, 0.0f);
+    for (const auto& entry : pwt)
+      sum[entry.first.first] += entry.second;
+    for (int topic_index = 0; topic_index < nTopics; ++topic_index) {
+      EXPECT_NEAR(sum[topic_index], 1.0f, tolerance + 1e-3);
+      if (std::fabs(sum[topic_index] - 1.0f) > 1e-4)
+        has_incremental_updates = true;
+    }
+  }
+
+  EXPECT_TRUE(has_incremental_updates);
+}
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=MasterModel.SparsePhiKernel
+TEST(MasterModel, SparsePhiKernel) {
+  const int nTopics = 20, nBatches = 20, nTokens = 60;
+  auto batches = ::artm::test::TestMother::GenerateBatches(nBatches, nTokens);
+
+  ::artm::GetScoreValueArgs get_score_args;
+  get_score_args.set_score_name("Perplexity");
+
+  // Zero density keeps all rows dense, while density 1.0 processes all rows by sparse kernels
+  std::vector<float> perplexity;
+  std::vector< ::artm::TopicModel> topic_models;
+  for (float density : { 0.0f, 1.0f }) {
+    ::artm::MasterModelConfig config = ::artm::test::TestMother::GenerateMasterModelConfig(nTopics);
+    config.set_sparse_phi_max_density(density);
+    ::artm::ScoreConfig* score_config = config.add_score_config();
+    score_config->set_type(::artm::ScoreType_Perplexity);
+    score_config->set_name("Perplexity");
+    score_config->set_config(::artm::PerplexityScoreConfig().SerializeAsString());
+
+    ::artm::RegularizerConfig* reg_phi = config.add_regularizer_config();
+    reg_phi->set_type(::artm::RegularizerType_SmoothSparsePhi);
+    reg_phi->set_tau(-0.5);
+    reg_phi->set_name("SparsePhi");
+    reg_phi->set_config(::artm::SmoothSparsePhiConfig().SerializeAsString());
+
+    ::artm::MasterModel master_model(config);
+    ::artm::test::Api api(master_model);
+    auto offline_args = api.Initialize(batches);
+    for (int iter = 0; iter < 3; ++iter)
+      master_model.FitOfflineModel(offline_args);
+
+    perplexity.push_back(master_model.GetScoreAs< ::artm::PerplexityScore>(get_score_args).value());
+    topic_models.push_back(master_model.GetTopicModel());
+    EXPECT_EQ(master_model.info().phi_matrix_pool_byte_size(), 0);  // r_wt is only pooled within FitOfflineModel
+  }
+
+  EXPECT_NEAR(perplexity[1], perplexity[0], 1e-3 * perplexity[0]);
+  ASSERT_EQ(topic_models[0].token_size(), topic_models[1].token_size());
+  int num_zeros = 0;
+  for (int token_index = 0; token_index < topic_models[0].token_size(); ++token_index) {
+    for (int topic_index = 0; topic_index < nTopics; ++topic_index) {
+      const float value = topic_models[0].token_weights(token_index).value(topic_index);
+      EXPECT_NEAR(topic_models[1].token_weights(token_index).value(topic_index), value, 1e-4);
+      if (value == 0.0f) num_zeros++;
+    }
+  }
+
+  EXPECT_GT(num_zeros, 0);  // the regularizer has to make p_wt sparse, otherwise sparse kernels are not tested
+}
@@ -0,0 +1,549 @@
+// Copyright 2016, Additive Regularization of Topic Models.
+
+#include "gtest/gtest.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "boost/lexical_cast.hpp"
+
+#include "glog/logging.h"
+
+#include "artm/core/common.h"
+#include "artm/core/cuckoo_watch.h"
+#include "artm/core/dense_phi_matrix.h"
+#include "artm/core/exceptions.h"
+#include "artm/core/phi_matrix_operations.h"
+#include "artm/core/phi_matrix_pool.h"
+#include "artm/core/thread_pool.h"
+
+using ::artm::core::ContiguousPhiMatrix;
+using ::artm::core::DensePhiMatrix;
+using ::artm::core::PhiMatrix;
+using ::artm::core::PhiMatrixFrame;
+using ::artm::core::Token;
+
+namespace {
+google::protobuf::RepeatedPtrField<std::string> GenerateTopicNames(int num_topics) {
+  google::protobuf::RepeatedPtrField<std::string> topic_names;
+  for (int i = 0; i < num_topics; ++i)
+    topic_names.Add()->assign("topic" + boost::lexical_cast<std::string>(i));
+  return topic_names;
+}
+
+void FillPhiMatrix(int num_tokens, PhiMatrix* phi_matrix) {
+  for (int i = 0; i < num_tokens; ++i) {
+    int token_id = phi_matrix->AddToken(Token(::artm::core::DefaultClass, "token" + boost::lexical_cast<std::string>(i)));
+    for (int topic_id = 0; topic_id < phi_matrix->topic_size(); ++topic_id) {
+      // Make about half of all values zero, so that DensePhiMatrix packs some of its rows
+      float value = ((i + topic_id) % 3 == 0) ? 0.0f : static_cast<float>(i * 100 + topic_id);
+      phi_matrix->set(token_id, topic_id, value);
+    }
+  }
+}
+}  // namespace
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=PhiMatrix.Contiguous
+TEST(PhiMatrix, Contiguous) {
+  const int num_topics = 7;
+  const int num_tokens = 100;  // enough to trigger several reallocations
+
+  std::shared_ptr<PhiMatrixFrame> contiguous = ::artm::core::CreatePhiMatrix(
+    ::artm::PhiMatrixStorage_Contiguous, "contiguous", GenerateTopicNames(num_topics));
+  std::shared_ptr<PhiMatrixFrame> packed = ::artm::core::CreatePhiMatrix(
+    ::artm::PhiMatrixStorage_Packed, "packed", GenerateTopicNames(num_topics));
+  ASSERT_TRUE(dynamic_cast<ContiguousPhiMatrix*>(contiguous.get()) != nullptr);
+  ASSERT_TRUE(dynamic_cast<DensePhiMatrix*>(packed.get()) != nullptr);
+
+  FillPhiMatrix(num_tokens, contiguous.get());
+  FillPhiMatrix(num_tokens, packed.get());
+  ASSERT_EQ(contiguous->token_size(), num_tokens);
+  ASSERT_TRUE(::artm::core::PhiMatrixOperations::HasEqualShape(*contiguous, *packed));
+
+  std::vector<float> increment(num_topics, 0.5f);
+  contiguous->increase(3, increment);
+  packed->increase(3, increment);
+  contiguous->increase(5, 2, 1.5f);
+  packed->increase(5, 2, 1.5f);
+
+  std::shared_ptr<PhiMatrix> duplicate = contiguous->Duplicate();
+  ASSERT_TRUE(dynamic_cast<ContiguousPhiMatrix*>(duplicate.get()) != nullptr);
+
+  const ContiguousPhiMatrix& matrix = dynamic_cast<const ContiguousPhiMatrix&>(*contiguous);
+  std::vector<float> buffer(num_topics, 0.0f);
+  for (int token_id = 0; token_id < num_tokens; ++token_id) {
+    // every row starts at a cache line boundary
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(matrix.row(token_id)) % ContiguousPhiMatrix::kAlignment, 0);
+
+    contiguous->get(token_id, &buffer);
+    for (int topic_id = 0; topic_id < num_topics; ++topic_id) {
+      EXPECT_EQ(contiguous->get(token_id, topic_id), packed->get(token_id, topic_id));
+      EXPECT_EQ(duplicate->get(token_id, topic_id), packed->get(token_id, topic_id));
+      EXPECT_EQ(buffer[topic_id], packed->get(token_id, topic_id));
+      EXPECT_EQ(matrix.row(token_id)[topic_id], packed->get(token_id, topic_id));
+    }
+  }
+
+  contiguous->Reshape(*packed);
+  ASSERT_EQ(contiguous->token_size(), num_tokens);
+  for (int token_id = 0; token_id < num_tokens; ++token_id)
+    for (int topic_id = 0; topic_id < num_topics; ++topic_id)
+      EXPECT_EQ(contiguous->get(token_id, topic_id), 0.0f);
+
+  contiguous->Clear();
+  ASSERT_EQ(contiguous->token_size(), 0);
+}
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=PhiMatrix.GetRow
+TEST(PhiMatrix, GetRow) {
+  const int num_topics = 5;
+  const int num_tokens = 20;
+
+  for (auto storage : { ::artm::PhiMatrixStorage_Packed, ::artm::PhiMatrixStorage_Contiguous }) {
+    std::shared_ptr<PhiMatrixFrame> phi_matrix = ::artm::core::CreatePhiMatrix(
+      storage, "phi", GenerateTopicNames(num_topics));
+    FillPhiMatrix(num_tokens, phi_matrix.get());
+    phi_matrix->AddToken(Token(::artm::core::DefaultClass, "zero_token"));  // a row with only zeros
+
+    std::vector<float> buffer;
+    for (int token_id = 0; token_id < phi_matrix->token_size(); ++token_id) {
+      const float* row = phi_matrix->get_row(token_id, &buffer);
+      for (int topic_id = 0; topic_id < num_topics; ++topic_id)
+        EXPECT_EQ(row[topic_id], phi_matrix->get(token_id, topic_id));
+    }
+
+    if (storage == ::artm::PhiMatrixStorage_Contiguous) {
+      // contiguous rows are always exposed in place
+      EXPECT_EQ(phi_matrix->get_row(1, &buffer),
+                dynamic_cast<const ContiguousPhiMatrix&>(*phi_matrix).row(1));
+    }
+  }
+}
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=PhiMatrix.TokenSetVersion
+TEST(PhiMatrix, TokenSetVersion) {
+  const int num_topics = 3;
+  DensePhiMatrix first("first", GenerateTopicNames(num_topics));
+  DensePhiMatrix second("second", GenerateTopicNames(num_topics));
+  EXPECT_NE(first.token_set_version(), 0);
+  EXPECT_NE(first.token_set_version(), second.token_set_version());
+
+  FillPhiMatrix(10, &first);
+  int64_t version = first.token_set_version();
+  first.AddToken(first.token(3));  // existing token does not change the token set
+  EXPECT_EQ(first.token_set_version(), version);
+
+  std::shared_ptr<PhiMatrix> duplicate = first.Duplicate();
+  EXPECT_EQ(duplicate->token_set_version(), version);
+
+  second.Reshape(first);
+  EXPECT_EQ(second.token_set_version(), version);
+  EXPECT_TRUE(::artm::core::PhiMatrixOperations::HasEqualShape(first, second));
+
+  second.AddToken(Token(::artm::core::DefaultClass, "new_token"));
+  EXPECT_NE(second.token_set_version(), version);
+  EXPECT_EQ(first.token_set_version(), version);
+  EXPECT_FALSE(::artm::core::PhiMatrixOperations::HasEqualShape(first, second));
+
+  first.Clear();
+  EXPECT_NE(first.token_set_version(), version);
+}
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=PhiMatrix.ParallelNormalization
+TEST(PhiMatrix, ParallelNormalization) {
+  // Large enough to be split into several token ranges
+  const int num_tokens = 100000, num_topics = 4;
+  ::artm::core::ThreadPool thread_pool(4);
+  DensePhiMatrix n_wt("nwt", GenerateTopicNames(num_topics));
+  DensePhiMatrix r_wt("rwt", GenerateTopicNames(num_topics));
+  for (int i = 0; i < num_tokens; ++i) {
+    Token token((i / 1000) % 2 == 0 ? "class_one" : "class_two", "token" + boost::lexical_cast<std::string>(i));
+    n_wt.AddToken(token);
+    r_wt.AddToken(token);
+    for (int topic_id = 0; topic_id < num_topics; ++topic_id) {
+      n_wt.set(i, topic_id, static_cast<float>((i + topic_id) % 7));
+      r_wt.set(i, topic_id, (i % 5 == 0) ? -3.0f : 0.5f);
+    }
+  }
+
+  std::map<std::string, std::vector<double> > expected_n_t;
+  for (int i = 0; i < num_tokens; ++i) {
+    std::vector<double>& n_t = expected_n_t[n_wt.token(i).class_id];
+    n_t.resize(num_topics, 0.0);
+    for (int topic_id = 0; topic_id < num_topics; ++topic_id)
+      n_t[topic_id] += std::max(n_wt.get(i, topic_id) + r_wt.get(i, topic_id), 0.0f);
+  }
+
+  auto n_t = ::artm::core::PhiMatrixOperations::FindNormalizers(n_wt, r_wt, &thread_pool);
+  ASSERT_EQ(n_t.size(), expected_n_t.size());
+  for (auto& class_n_t : expected_n_t) {
+    for (int topic_id = 0; topic_id < num_topics; ++topic_id)
+      EXPECT_NEAR(n_t[class_n_t.first][topic_id], class_n_t.second[topic_id], 1e-5 * class_n_t.second[topic_id]);
+  }
+
+  DensePhiMatrix p_wt("pwt", GenerateTopicNames(num_topics));
+  p_wt.Reshape(n_wt);
+  ::artm::core::PhiMatrixOperations::FindPwt(n_wt, r_wt, &p_wt, &thread_pool);
+  for (int i = 0; i < num_tokens; i += 7) {
+    const std::vector<double>& class_n_t = expected_n_t[n_wt.token(i).class_id];
+    for (int topic_id = 0; topic_id < num_topics; ++topic_id) {
+      double expected = std::max(n_wt.get(i, topic_id) + r_wt.get(i, topic_id), 0.0f) / class_n_t[topic_id];
+      EXPECT_NEAR(p_wt.get(i, topic_id), expected, 1e-5 * expected + 1e-12);
+    }
+  }
+
+  ::artm::core::PhiMatrixOperations::AssignValue(1.0f, &r_wt, &thread_pool);
+  for (int i = 0; i < num_tokens; i += 7)
+    EXPECT_EQ(r_wt.get(i, num_topics - 1), 1.0f);
+}
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=PhiMatrix.ThreadPool
+TEST(PhiMatrix, ThreadPool) {
+  ::artm::core::ThreadPool thread_pool(3);
+  EXPECT_EQ(thread_pool.num_threads(), 3);
+
+  // Loops may be nested, because the calling thread takes part in the loop
+  std::vector<int> counts(8 * 8, 0);
+  thread_pool.ParallelFor(8, [&](int i) {
+    thread_pool.ParallelFor(8, [&](int j) { counts[i * 8 + j]++; });
+  });
+  EXPECT_EQ(counts, std::vector<int>(8 * 8, 1));
+
+  EXPECT_THROW(thread_pool.ParallelFor(8, [](int i) {
+    if (i == 5)
+      BOOST_THROW_EXCEPTION(::artm::core::InternalError("error in the loop"));
+  }), ::artm::core::InternalError);
+}
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=PhiMatrix.ApplyPhiMatrix
+TEST(PhiMatrix, ApplyPhiMatrix) {
+  const int num_topics = 4;
+  DensePhiMatrix source("source", GenerateTopicNames(num_topics));
+  FillPhiMatrix(20, &source);
+
+  // Target with reversed topics and only part of the tokens, in a different order
+  auto reversed_topic_names = GenerateTopicNames(num_topics);
+  std::reverse(reversed_topic_names.begin(), reversed_topic_names.end());
+  DensePhiMatrix shuffled("shuffled", reversed_topic_names);
+  for (int token_id = 15; token_id >= 0; token_id -= 3)
+    shuffled.AddToken(source.token(token_id));
+
+  for (bool add_missing_tokens : { false, true }) {
+    for (bool same_shape : { false, true }) {
+      std::shared_ptr<PhiMatrix> expected = same_shape ? source.Duplicate() : shuffled.Duplicate();
+      std::shared_ptr<PhiMatrix> actual = same_shape ? source.Duplicate() : shuffled.Duplicate();
+
+      ::artm::TopicModel topic_model;
+      ::artm::core::PhiMatrixOperations::RetrieveExternalTopicModel(source, ::artm::GetTopicModelArgs(),
+                                                                    &topic_model);
+      ::artm::core::PhiMatrixOperations::ApplyTopicModelOperation(topic_model, 0.5f, add_missing_tokens,
+                                                                  expected.get());
+      ::artm::core::PhiMatrixOperations::ApplyPhiMatrix(source, 0.5f, add_missing_tokens, actual.get());
+
+      ASSERT_EQ(actual->token_size(), expected->token_size());
+      ASSERT_EQ(actual->token_size(), (same_shape || add_missing_tokens) ? source.token_size() : 6);
+      for (int token_id = 0; token_id < expected->token_size(); ++token_id) {
+        EXPECT_EQ(actual->token(token_id), expected->token(token_id));
+        for (int topic_id = 0; topic_id < num_topics; ++topic_id)
+          EXPECT_EQ(actual->get(token_id, topic_id), expected->get(token_id, topic_id));
+      }
+    }
+  }
+}
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=PhiMatrix.Scaled
+TEST(PhiMatrix, Scaled) {
+  const int num_topics = 3;
+  auto storage = std::make_shared<DensePhiMatrix>("nwt", GenerateTopicNames(num_topics));
+  FillPhiMatrix(5, storage.get());
+  ::artm::core::ScaledPhiMatrix scaled(storage, 0.25);
+  EXPECT_EQ(scaled.token_size(), storage->token_size());
+  EXPECT_EQ(scaled.token_set_version(), storage->token_set_version());
+
+  std::vector<float> buffer;
+  const float* row = scaled.get_row(2, &buffer);
+  for (int topic_id = 0; topic_id < num_topics; ++topic_id) {
+    EXPECT_EQ(scaled.get(2, topic_id), 0.25f * storage->get(2, topic_id));
+    EXPECT_EQ(row[topic_id], scaled.get(2, topic_id));
+  }
+
+  // Writes go into the storage divided by the scale
+  scaled.set(1, 0, 2.0f);
+  EXPECT_EQ(storage->get(1, 0), 8.0f);
+  scaled.increase(1, std::vector<float>(num_topics, 1.0f));
+  EXPECT_EQ(scaled.get(1, 0), 3.0f);
+  EXPECT_EQ(storage->get(1, 0), 12.0f);
+
+  std::shared_ptr<PhiMatrix> duplicate = scaled.Duplicate();
+  scaled.set(1, 0, 0.0f);
+  EXPECT_EQ(duplicate->get(1, 0), 3.0f);
+
+  ::artm::core::PhiMatrixOperations::MultiplyValue(0.5f, storage.get());
+  EXPECT_EQ(scaled.get(1, 1), 0.125f * (101.0f + 4.0f));
+}
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=PhiMatrix.Sparse
+TEST(PhiMatrix, Sparse) {
+  const int num_topics = 3;
+  auto p_wt = std::make_shared<DensePhiMatrix>("pwt", GenerateTopicNames(num_topics));
+  FillPhiMatrix(1000, p_wt.get());
+
+  ::artm::core::SparsePhiMatrix n_wt_hat("nwt_hat", *p_wt);
+  ASSERT_TRUE(::artm::core::PhiMatrixOperations::HasEqualShape(n_wt_hat, *p_wt));
+  EXPECT_EQ(n_wt_hat.allocated_row_size(), 0);
+
+  n_wt_hat.increase(7, std::vector<float>(num_topics, 2.0f));
+  n_wt_hat.increase(7, 1, 1.0f);
+  n_wt_hat.set(500, 2, 4.0f);
+  EXPECT_EQ(n_wt_hat.allocated_row_size(), 2);
+  EXPECT_EQ(n_wt_hat.allocated_tokens(), std::vector<int>({ 7, 500 }));
+  EXPECT_EQ(n_wt_hat.row(8), nullptr);
+  EXPECT_EQ(n_wt_hat.get(8, 0), 0.0f);
+  EXPECT_EQ(n_wt_hat.get(7, 1), 3.0f);
+  EXPECT_EQ(n_wt_hat.token_index(p_wt->token(500)), 500);
+
+  // Only written rows are merged into the dense target
+  auto n_wt = p_wt->Duplicate();
+  ::artm::core::PhiMatrixOperations::ApplyPhiMatrix(n_wt_hat, 0.5f, /* add_missing_tokens = */ false, n_wt.get());
+  for (int token_id = 0; token_id < p_wt->token_size(); ++token_id) {
+    for (int topic_id = 0; topic_id < num_topics; ++topic_id)
+      EXPECT_EQ(n_wt->get(token_id, topic_id), p_wt->get(token_id, topic_id) + 0.5f * n_wt_hat.get(token_id, topic_id));
+  }
+}
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=PhiMatrix.Pool
+TEST(PhiMatrix, Pool) {
+  const int num_topics = 4;
+  auto n_wt = std::make_shared<DensePhiMatrix>("nwt", GenerateTopicNames(num_topics));
+  FillPhiMatrix(100, n_wt.get());
+
+  ::artm::core::PhiMatrixPool pool;
+  pool.set_max_size(2);
+
+  std::shared_ptr<PhiMatrixFrame> r_wt = pool.Create(::artm::PhiMatrixStorage_Packed, "rwt", n_wt->topic_name(), *n_wt);
+  ASSERT_TRUE(::artm::core::PhiMatrixOperations::HasEqualShape(*r_wt, *n_wt));
+  EXPECT_EQ(r_wt->token_set_version(), n_wt->token_set_version());
+  r_wt->set(5, 1, 3.0f);
+
+  const PhiMatrixFrame* r_wt_address = r_wt.get();
+  const int64_t r_wt_byte_size = r_wt->ByteSize();
+  pool.Release(std::move(r_wt));
+  EXPECT_EQ(pool.size(), 1);
+  EXPECT_EQ(pool.ByteSize(), r_wt_byte_size);
+
+  // Matrix of a different storage is allocated anew
+  std::shared_ptr<PhiMatrixFrame> p_wt = pool.Create(::artm::PhiMatrixStorage_Contiguous, "pwt",
+                                                     n_wt->topic_name(), *n_wt);
+  EXPECT_EQ(pool.size(), 1);
+
+  // Pooled matrix is reused and comes back zeroed under the new name
+  std::shared_ptr<PhiMatrixFrame> n_wt_hat = pool.Create(::artm::PhiMatrixStorage_Packed, "nwt_hat",
+                                                         n_wt->topic_name(), *p_wt);
+  EXPECT_EQ(pool.size(), 0);
+  EXPECT_EQ(n_wt_hat.get(), r_wt_address);
+  EXPECT_EQ(n_wt_hat->model_name(), "nwt_hat");
+  ASSERT_TRUE(::artm::core::PhiMatrixOperations::HasEqualShape(*n_wt_hat, *n_wt));
+  EXPECT_EQ(n_wt_hat->get(5, 1), 0.0f);
+
+  // Adding a token to one matrix does not affect matrices that share its token index
+  n_wt_hat->AddToken(Token("@default_class", "new_token"));
+  EXPECT_EQ(n_wt_hat->token_size(), n_wt->token_size() + 1);
+  EXPECT_FALSE(n_wt->has_token(Token("@default_class", "new_token")));
+
+  pool.Release(std::move(p_wt));
+  pool.Release(std::move(n_wt_hat));
+  EXPECT_EQ(pool.size(), 2);
+  pool.Clear();
+  EXPECT_EQ(pool.size(), 0);
+  EXPECT_EQ(pool.ByteSize(), 0);
+
+  // Disabled pool drops released matrices
+  pool.set_max_size(0);
+  pool.Release(pool.Create(::artm::PhiMatrixStorage_Packed, "rwt", n_wt->topic_name(), *n_wt));
+  EXPECT_EQ(pool.size(), 0);
+}
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=PhiMatrix.TokenIndex
+TEST(PhiMatrix, TokenIndex) {
+  std::vector<Token> tokens;
+  ::artm::core::TokenIndex token_index;
+  auto token_at = [&tokens](int position) -> const Token& { return tokens[position]; };
+
+  const int num_tokens = 10000;
+  for (int i = 0; i < num_tokens; ++i) {
+    const std::string class_id = (i % 3 == 0) ? "@default_class" : "@other_class";
+    tokens.push_back(Token(class_id, "token" + boost::lexical_cast<std::string>(i)));
+    token_index.insert(tokens.back(), i);
+  }
+
+  EXPECT_EQ(token_index.size(), num_tokens);
+  for (int i = 0; i < num_tokens; ++i)
+    EXPECT_EQ(token_index.find(tokens[i], token_at), i);
+  EXPECT_EQ(token_index.find(Token("@default_class", "token1"), token_at), -1);
+  EXPECT_EQ(token_index.find(Token("@default_class", "unknown"), token_at), -1);
+
+  token_index.clear();
+  EXPECT_EQ(token_index.find(tokens[0], token_at), -1);
+}
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=PhiMatrix.Locking
+TEST(PhiMatrix, Locking) {
+  const int num_topics = 5;
+  const int num_tokens = 1000;
+  const int num_threads = 4;
+  const int num_passes = 50;
+
+  ::artm::PhiMatrixStorage storages[] = { ::artm::PhiMatrixStorage_Packed, ::artm::PhiMatrixStorage_Contiguous };
+  ::artm::PhiMatrixLocking lockings[] = { ::artm::PhiMatrixLocking_Striped, ::artm::PhiMatrixLocking_Atomic };
+  for (auto storage : storages) {
+    for (auto locking : lockings) {
+      std::shared_ptr<PhiMatrixFrame> n_wt = ::artm::core::CreatePhiMatrix(storage, "nwt",
+                                                                          GenerateTopicNames(num_topics));
+      for (int i = 0; i < num_tokens; ++i)
+        n_wt->AddToken(Token(::artm::core::DefaultClass, "token" + boost::lexical_cast<std::string>(i)));
+      n_wt->set_locking(locking);
+
+      // All threads increase all rows concurrently
+      std::vector<std::thread> threads;
+      for (int thread_index = 0; thread_index < num_threads; ++thread_index) {
+        threads.push_back(std::thread([&n_wt, thread_index]() {
+          std::vector<float> increment(num_topics, 0.0f);
+          increment[thread_index % num_topics] = 1.0f;
+          for (int pass = 0; pass < num_passes; ++pass) {
+            for (int token_id = 0; token_id < num_tokens; ++token_id)
+              n_wt->increase(token_id, increment);
+          }
+        }));
+      }
+
+      for (auto& thread : threads)
+        thread.join();
+
+      for (int token_id = 0; token_id < num_tokens; ++token_id) {
+        for (int topic_id = 0; topic_id < num_topics; ++topic_id) {
+          const float expected = (topic_id < num_threads) ? static_cast<float>(num_passes) : 0.0f;
+          ASSERT_EQ(n_wt->get(token_id, topic_id), expected);
+        }
+      }
+    }
+  }
+}
+
+// Compares memory and speed of n_wt updates for all storages and locking modes; timings are written to the log.
+// The benchmark takes a while, so it is disabled by default. To run it:
+// artm_tests.exe --gtest_also_run_disabled_tests --gtest_filter=PhiMatrix.DISABLED_LockingBenchmark
+TEST(PhiMatrix, DISABLED_LockingBenchmark) {
+  const int num_topics = 50;
+  const int num_tokens = 1000000;
+  const int num_hot_tokens = 2000;
+  const int num_threads = 8;
+  const int num_increases = 4000000;
+
+  ::artm::PhiMatrixStorage storages[] = { ::artm::PhiMatrixStorage_Packed, ::artm::PhiMatrixStorage_Contiguous };
+  ::artm::PhiMatrixLocking lockings[] = { ::artm::PhiMatrixLocking_Striped, ::artm::PhiMatrixLocking_Atomic,
+                                          ::artm::PhiMatrixLocking_None };
+  for (auto storage : storages) {
+    for (auto locking : lockings) {
+      const std::string name = ::artm::PhiMatrixStorage_Name(storage) + ", " + ::artm::PhiMatrixLocking_Name(locking);
+      std::shared_ptr<PhiMatrixFrame> n_wt = ::artm::core::CreatePhiMatrix(storage, "nwt",
+                                                                          GenerateTopicNames(num_topics));
+      {
+        ::artm::core::CuckooWatch cuckoo(name + ": AddToken");
+        for (int i = 0; i < num_tokens; ++i)
+          n_wt->AddToken(Token(::artm::core::DefaultClass, "token" + boost::lexical_cast<std::string>(i)));
+      }
+
+      {
+        ::artm::core::CuckooWatch cuckoo(name + ": Duplicate");
+        n_wt->Duplicate();
+      }
+
+      // Without locking only a single writer is allowed
+      const int num_writers = (locking == ::artm::PhiMatrixLocking_None) ? 1 : num_threads;
+      n_wt->set_locking(locking);
+      {
+        ::artm::core::CuckooWatch cuckoo(name + ": increase() of hot rows in " +
+                                         boost::lexical_cast<std::string>(num_writers) + " threads");
+        std::vector<std::thread> threads;
+        for (int thread_index = 0; thread_index < num_writers; ++thread_index) {
+          threads.push_back(std::thread([&n_wt, num_writers, thread_index]() {
+            std::vector<float> increment(num_topics, 1.0f);
+            for (int i = thread_index; i < num_increases; i += num_writers)
+              n_wt->increase(i % num_hot_tokens, increment);
+          }));
+        }
+
+        for (auto& thread : threads)
+          thread.join();
+      }
+
+      LOG(INFO) << name << ": " << n_wt->ByteSize() / (1024 * 1024) << " MB";
+      ASSERT_EQ(n_wt->get(0, 0), static_cast<float>(num_increases / num_hot_tokens));
+    }
+  }
+}
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=PhiMatrix.PackedValues
+TEST(PhiMatrix, PackedValues) {
+  const int size = 150;  // spans several bitmask words
+  std::vector<float> values(size, 0.0f);
+  for (int i = 0; i < size; i += 7)
+    values[i] = static_cast<float>(i + 1);
+  values[63] = 1.0f;
+  values[64] = 2.0f;
+
+  ::artm::core::PackedValues packed(&values[0], size);
+  ASSERT_TRUE(packed.is_packed());
+  EXPECT_EQ(packed.data(), nullptr);
+  EXPECT_EQ(packed.nonzero_size(), static_cast<int>(std::count_if(values.begin(), values.end(),
+                                                                  [](float value) { return value != 0.0f; })));
+
+  std::vector<float> buffer(size, -1.0f);
+  packed.get(&buffer);
+  for (int i = 0; i < size; ++i) {
+    EXPECT_EQ(packed.get(i), values[i]);
+    EXPECT_EQ(buffer[i], values[i]);
+  }
+
+  std::vector<int> nonzero_index;
+  std::vector<float> nonzero_value;
+  ASSERT_EQ(packed.get_nonzeros(&nonzero_index, &nonzero_value), packed.nonzero_size());
+  ASSERT_EQ(nonzero_index.size(), nonzero_value.size());
+  for (int j = 0; j < static_cast<int>(nonzero_index.size()); ++j)
+    EXPECT_EQ(nonzero_value[j], values[nonzero_index[j]]);
+
+  // Dense rows stay unpacked, and rows are repacked once they become sparse again
+  std::vector<float> dense(size, 1.0f);
+  packed.assign(&dense[0], size);
+  EXPECT_FALSE(packed.is_packed());
+  EXPECT_EQ(packed.get(100), 1.0f);
+
+  float* unpacked = packed.unpack();
+  std::copy(values.begin(), values.end(), unpacked);
+  packed.pack();
+  ASSERT_TRUE(packed.is_packed());
+  for (int i = 0; i < size; ++i)
+    EXPECT_EQ(packed.get(i), values[i]);
+
+  packed.reset(size);
+  EXPECT_EQ(packed.nonzero_size(), 0);
+  EXPECT_EQ(packed.get(64), 0.0f);
+}
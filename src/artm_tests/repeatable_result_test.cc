@@ -1,14 +1,24 @@
 // Copyright 2014, Additive Regularization of Topic Models.
 
+#include <algorithm>
+#include <fstream>  // NOLINT
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "boost/thread.hpp"
 #include "gtest/gtest.h"
 
 #include "boost/filesystem.hpp"
 
 #include "artm/cpp_interface.h"
+#include "artm/core/binary_format.h"
 #include "artm/core/common.h"
 #include "artm/core/exceptions.h"
+#include "artm/core/flat_batch.h"
 #include "artm/core/helpers.h"
+#include "artm/core/mapped_phi_matrix.h"
 #include "artm/core/token.h"
 
 #include "artm/core/call_on_destruction.h"
@@ -19,39 +29,91 @@
 using artm::core::Helpers;
 using artm::core::Token;
 
-std::string runOfflineTest() {
+// Reverses the byte order mark of a flat batch or a mapped model,
+// as if the file was saved on a machine with different byte order.
+void FlipByteOrderMark(const std::string& file_name) {
+  std::fstream file(file_name.c_str(), std::fstream::in | std::fstream::out | std::fstream::binary);
+  char byte_order_mark[sizeof(int)];
+  file.seekg(::artm::core::BinaryFormat::kMagicSize);
+  file.read(byte_order_mark, sizeof(byte_order_mark));
+  std::reverse(byte_order_mark, byte_order_mark + sizeof(byte_order_mark));
+  file.seekp(::artm::core::BinaryFormat::kMagicSize);
+  file.write(byte_order_mark, sizeof(byte_order_mark));
+  ASSERT_TRUE(file.good());
+}
+
+typedef std::function<void(::artm::MasterModelConfig*)> ConfigMutator;
+
+// Fits a model with 5 topics in 3 offline passes and describes its topic model and theta matrix of each batch.
+// configure adjusts the default config. The batches are imported into the master model;
+// if there are no batches, then all batches from batch_folder are used.
+std::string runOfflineTest(const ConfigMutator& configure,
+                           const std::vector<std::shared_ptr< ::artm::Batch>>& batches,
+                           const std::string& batch_folder = std::string()) {
   const int nTopics = 5;
 
   ::artm::MasterModelConfig master_config = ::artm::test::TestMother::GenerateMasterModelConfig(nTopics);
-  master_config.set_cache_theta(true);
   master_config.set_num_processors(1);
   master_config.set_pwt_name(artm::test::Helpers::getUniqueString());
+  configure(&master_config);
   ::artm::MasterModel master_component(master_config);
-  ::artm::test::Api api(master_component);
 
-  int batches_size = 2;
-  int nTokens = 10;
-  auto batches = ::artm::test::TestMother::GenerateBatches(batches_size, nTokens);
-  auto offline_args = api.Initialize(batches);
+  ::artm::FitOfflineMasterModelArgs offline_args;
+  std::vector<std::string> batch_filenames;
+  if (!batches.empty()) {
+    ::artm::test::Api api(master_component);
+    offline_args = api.Initialize(batches);
+    for (auto& batch : batches)
+      batch_filenames.push_back(batch->id());
+  } else {
+    ::artm::GatherDictionaryArgs gather_args;
+    gather_args.set_data_path(batch_folder);
+    gather_args.set_dictionary_target_name("dictionary");
+    master_component.GatherDictionary(gather_args);
+
+    ::artm::InitializeModelArgs init_model_args;
+    init_model_args.set_dictionary_name("dictionary");
+    init_model_args.set_model_name(master_config.pwt_name());
+    init_model_args.mutable_topic_name()->CopyFrom(master_config.topic_name());
+    master_component.InitializeModel(init_model_args);
+
+    offline_args.set_batch_folder(batch_folder);
+    for (auto& path : Helpers::ListAllBatches(batch_folder))
+      batch_filenames.push_back(path.string());
+    std::sort(batch_filenames.begin(), batch_filenames.end());
+  }
 
   for (int iter = 0; iter < 3; ++iter)
     master_component.FitOfflineModel(offline_args);
 
-  ::artm::TopicModel topic_model = master_component.GetTopicModel();
   std::stringstream ss;
-  ss << "Topic model:\n" << ::artm::test::Helpers::DescribeTopicModel(topic_model);
+  ss << "Topic model:\n" << ::artm::test::Helpers::DescribeTopicModel(master_component.GetTopicModel());
   ss << "Theta matrix:\n";
-  for (unsigned i = 0; i < batches.size(); ++i) {
+  for (auto& batch_filename : batch_filenames) {
     ::artm::TransformMasterModelArgs args;
-    args.add_batch_filename(batches[i]->id());
+    args.add_batch_filename(batch_filename);
     args.set_theta_matrix_type(::artm::ThetaMatrixType_Dense);
-    auto theta_matrix = master_component.Transform(args);
-    ss << ::artm::test::Helpers::DescribeThetaMatrix(theta_matrix);
+    ss << ::artm::test::Helpers::DescribeThetaMatrix(master_component.Transform(args));
   }
 
   return ss.str();
 }
 
+std::string runOfflineTest(::artm::NwtAccumulationMode mode = ::artm::NwtAccumulationMode_Direct,
+                           bool deterministic_nwt_reduction = false, int num_processors = 1,
+                           ::artm::PhiMatrixStorage storage = ::artm::PhiMatrixStorage_Packed) {
+  auto configure = [=](::artm::MasterModelConfig* master_config) {
+    master_config->set_cache_theta(true);
+    master_config->set_num_processors(num_processors);
+    master_config->set_nwt_accumulation_mode(mode);
+    master_config->set_deterministic_nwt_reduction(deterministic_nwt_reduction);
+    master_config->set_phi_matrix_storage(storage);
+  };
+
+  return runOfflineTest(configure, ::artm::test::TestMother::GenerateBatches(/* batches_size =*/ 2,
+                                                                             /* nTokens =*/ 10));
+}
+
 // artm_tests.exe --gtest_filter=RepeatableResult.Offline
 TEST(RepeatableResult, Offline) {
   std::string first_result = runOfflineTest();
@@ -61,6 +123,168 @@ TEST(RepeatableResult, Offline) {
   ASSERT_EQ(first_result, second_result);
 }
 
+// artm_tests.exe --gtest_filter=RepeatableResult.NwtAccumulationModes
+TEST(RepeatableResult, NwtAccumulationModes) {
+  std::string direct_result = runOfflineTest();
+  ASSERT_EQ(direct_result, runOfflineTest(::artm::NwtAccumulationMode_PerBatch));
+  ASSERT_EQ(direct_result, runOfflineTest(::artm::NwtAccumulationMode_PerTaskGroup));
+
+  // Deterministic reduction sums up batches in their original order, regardless of the number of processors
+  ASSERT_EQ(direct_result, runOfflineTest(::artm::NwtAccumulationMode_PerTaskGroup, true, 4));
+  ASSERT_FALSE(runOfflineTest(::artm::NwtAccumulationMode_PerBatch, false, 4).empty());
+}
+
+// artm_tests.exe --gtest_filter=RepeatableResult.ContiguousPhiMatrix
+TEST(RepeatableResult, ContiguousPhiMatrix) {
+  std::string packed_result = runOfflineTest();
+  std::string contiguous_result = runOfflineTest(::artm::NwtAccumulationMode_Direct, false, 1,
+                                                 ::artm::PhiMatrixStorage_Contiguous);
+  ASSERT_EQ(packed_result, contiguous_result);
+}
+
+// artm_tests.exe --gtest_filter=RepeatableResult.DocumentChunks
+TEST(RepeatableResult, DocumentChunks) {
+  // Merge all generated items into one batch, so that there is a single task for all processors
+  auto batches = ::artm::test::TestMother::GenerateBatches(/* batches_size =*/ 40, /* nTokens =*/ 30);
+  for (unsigned i = 1; i < batches.size(); ++i)
+    batches[0]->add_item()->CopyFrom(batches[i]->item(0));
+  batches.resize(1);
+
+  auto run = [&batches](int num_processors, int document_chunk_size) {
+    return runOfflineTest([=](::artm::MasterModelConfig* master_config) {
+      master_config->set_num_processors(num_processors);
+      master_config->set_document_chunk_size(document_chunk_size);
+    }, batches);
+  };
+
+  // Each document and each token is processed exactly once regardless of how chunks are scheduled,
+  // so splitting a batch across processors gives exactly the same result.
+  std::string sequential_result = run(1, 0);
+  ASSERT_EQ(sequential_result, run(4, 3));
+  ASSERT_EQ(sequential_result, run(4, 1));
+}
+
+// artm_tests.exe --gtest_filter=RepeatableResult.BatchPrefetch
+TEST(RepeatableResult, BatchPrefetch) {
+  auto batches = ::artm::test::TestMother::GenerateBatches(/* batches_size =*/ 20, /* nTokens =*/ 30);
+  auto run = [&batches](int num_prefetched_batches) {
+    return runOfflineTest([=](::artm::MasterModelConfig* master_config) {
+      master_config->set_num_prefetched_batches(num_prefetched_batches);
+    }, batches);
+  };
+
+  // Batches prepared by the loader thread must give exactly the same result as batches loaded by processors
+  std::string result = run(0);
+  ASSERT_EQ(result, run(1));
+  ASSERT_EQ(result, run(8));
+}
+
+// artm_tests.exe --gtest_filter=RepeatableResult.FlatBatches
+TEST(RepeatableResult, FlatBatches) {
+  std::string protobuf_folder = ::artm::test::Helpers::getUniqueString();
+  std::string flat_folder = ::artm::test::Helpers::getUniqueString();
+  artm::core::call_on_destruction c([&]() {  // NOLINT
+    try { boost::filesystem::remove_all(protobuf_folder); } catch (...) {}
+    try { boost::filesystem::remove_all(flat_folder); } catch (...) {}
+  });
+
+  boost::filesystem::create_directory(flat_folder);
+  auto batches = ::artm::test::TestMother::GenerateBatches(/* batches_size =*/ 10, /* nTokens =*/ 30);
+  for (auto& batch : batches) {
+    batch->set_description("description");
+    batch->mutable_item(0)->set_title("title");
+    ::artm::core::Helpers::SaveBatch(*batch, protobuf_folder, batch->id());
+
+    std::string flat_filename = (boost::filesystem::path(flat_folder) / (batch->id() + ".batch")).string();
+    ::artm::SaveFlatBatch(*batch, flat_filename);
+    ASSERT_TRUE(::artm::core::FlatBatch::IsFlatBatch(flat_filename));
+
+    // Flat format keeps everything, so that a batch can be converted back to protobuf without losses
+    ::artm::Batch protobuf_batch;
+    ::artm::core::Helpers::LoadMessage(batch->id() + ".batch", protobuf_folder, &protobuf_batch);
+    ASSERT_EQ(::artm::LoadBatch(flat_filename).SerializeAsString(), protobuf_batch.SerializeAsString());
+
+    ::artm::core::FlatBatch flat_batch(flat_filename);
+    ASSERT_EQ(flat_batch.num_tokens(), batch->token_size());
+    for (int token_index = 0; token_index < batch->token_size(); ++token_index)
+      EXPECT_EQ(flat_batch.token(token_index).keyword, batch->token(token_index));
+    EXPECT_EQ(flat_batch.id(), batch->id());
+    EXPECT_EQ(flat_batch.item_title(0), "title");
+  }
+
+  auto configure = [](::artm::MasterModelConfig*) {};  // NOLINT
+  ASSERT_EQ(runOfflineTest(configure, {}, protobuf_folder), runOfflineTest(configure, {}, flat_folder));
+
+  // A batch saved on a machine with different byte order is rejected instead of being misread
+  std::string flat_filename = (boost::filesystem::path(flat_folder) / (batches[0]->id() + ".batch")).string();
+  FlipByteOrderMark(flat_filename);
+  EXPECT_THROW(::artm::core::FlatBatch flat_batch(flat_filename), ::artm::core::DiskReadException);
+
+  // Token ids of a batch without tokens refer to p_wt, so such batch can not be saved in flat format
+  ::artm::Batch tokenless_batch(*batches[0]);
+  tokenless_batch.clear_token();
+  tokenless_batch.clear_class_id();
+  EXPECT_THROW(::artm::SaveFlatBatch(tokenless_batch, flat_filename), ::artm::InvalidOperationException);
+}
+
+// artm_tests.exe --gtest_filter=RepeatableResult.MappedModel
+TEST(RepeatableResult, MappedModel) {
+  auto master_config = ::artm::test::TestMother::GenerateMasterModelConfig(/* nTopics =*/ 8);
+  master_config.set_num_processors(1);
+  ::artm::MasterModel master_component(master_config);
+  ::artm::test::Api api(master_component);
+
+  auto batches = ::artm::test::TestMother::GenerateBatches(/* batches_size =*/ 5, /* nTokens =*/ 30);
+  ::artm::ImportBatchesArgs import_args;
+  auto offline_args = api.Initialize(batches, &import_args);
+  for (int iter = 0; iter < 3; ++iter)
+    master_component.FitOfflineModel(offline_args);
+
+  std::string file_name = ::artm::test::Helpers::getUniqueString();
+  artm::core::call_on_destruction c([&]() { try { boost::filesystem::remove(file_name); } catch (...) {} });  // NOLINT
+  ::artm::ExportModelArgs export_args;
+  export_args.set_file_name(file_name);
+  export_args.set_file_format(::artm::ModelFileFormat_Mapped);
+  master_component.ExportModel(export_args);
+  ASSERT_TRUE(::artm::core::MappedPhiMatrix::IsMappedPhiMatrix(file_name));
+
+  // master2 uses the file in place, master3 loads a copy of it into the heap
+  ::artm::MasterModel master2(master_config);
+  master2.ImportBatches(import_args);
+  ::artm::ImportModelArgs import_model_args;
+  import_model_args.set_file_name(file_name);
+  master2.ImportModel(import_model_args);
+
+  ::artm::MasterModel master3(master_config);
+  master3.ImportBatches(import_args);
+  import_model_args.set_phi_matrix_storage(::artm::PhiMatrixStorage_Packed);
+  master3.ImportModel(import_model_args);
+
+  bool ok = false, ok2 = false;
+  ::artm::test::Helpers::CompareTopicModels(master2.GetTopicModel(), master_component.GetTopicModel(), &ok);
+  ::artm::test::Helpers::CompareTopicModels(master3.GetTopicModel(), master_component.GetTopicModel(), &ok2);
+  ASSERT_TRUE(ok && ok2);
+
+  for (unsigned iBatch = 0; iBatch < batches.size(); ++iBatch) {
+    ::artm::TransformMasterModelArgs transform_args;
+    transform_args.set_theta_matrix_type(::artm::ThetaMatrixType_Dense);
+    transform_args.add_batch_filename(batches[iBatch]->id());
+    ::artm::test::Helpers::CompareThetaMatrices(master2.Transform(transform_args),
+                                                master_component.Transform(transform_args), &ok);
+    ASSERT_TRUE(ok);
+  }
+
+  // Mapped model is read-only, but training replaces it with a new model in the heap
+  master_component.FitOfflineModel(offline_args);
+  master2.FitOfflineModel(offline_args);
+  ::artm::test::Helpers::CompareTopicModels(master2.GetTopicModel(), master_component.GetTopicModel(), &ok);
+  ASSERT_TRUE(ok);
+
+  // A model saved on a machine with different byte order is rejected instead of being misread
+  FlipByteOrderMark(file_name);
+  EXPECT_THROW(::artm::core::MappedPhiMatrix mapped("pwt", file_name), ::artm::core::DiskReadException);
+}
+
 // artm_tests.exe --gtest_filter=RepeatableResult.RandomGenerator
 TEST(RepeatableResult, RandomGenerator) {
   int num = 10;
@@ -0,0 +1,122 @@
+// Copyright 2016, Additive Regularization of Topic Models.
+
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "boost/lexical_cast.hpp"
+
+#include "artm/core/common.h"
+#include "artm/core/dense_phi_matrix.h"
+#include "artm/score/items_processed.h"
+#include "artm/score/perplexity.h"
+#include "artm/score/sparsity_theta.h"
+
+using ::artm::core::DensePhiMatrix;
+using ::artm::core::Token;
+
+namespace {
+// Calculates score through per-item AppendScore (as for scores that are not fused)
+std::shared_ptr< ::artm::Score> CalcItemByItem(::artm::ScoreCalculatorInterface* score_calc,
+                                               const ::artm::Batch& batch,
+                                               const ::artm::ProcessedBatch& processed_batch) {
+  const int topic_size = processed_batch.p_wt().topic_size();
+  std::shared_ptr< ::artm::Score> score = score_calc->CreateScore();
+  for (int item_index = 0; item_index < batch.item_size(); ++item_index) {
+    const float* theta = processed_batch.theta(item_index);
+    std::vector<float> theta_vec(theta, theta + topic_size);
+    score_calc->AppendScore(batch.item(item_index), processed_batch.token_dict(), processed_batch.p_wt(),
+                            processed_batch.args(), theta_vec, score.get());
+  }
+
+  score_calc->AppendScore(batch, processed_batch.p_wt(), processed_batch.args(), score.get());
+  return score;
+}
+
+std::shared_ptr< ::artm::Score> CalcFused(::artm::ScoreCalculatorInterface* score_calc,
+                                          const ::artm::ProcessedBatch& processed_batch) {
+  EXPECT_TRUE(score_calc->is_fused());
+  std::shared_ptr< ::artm::Score> score = score_calc->CreateScore();
+  score_calc->AppendScore(processed_batch, score.get());
+  return score;
+}
+}  // namespace
+
+// To run this particular test:
+// artm_tests.exe --gtest_filter=Scores.Fused
+TEST(Scores, Fused) {
+  const int num_topics = 4, num_tokens = 12, num_items = 6;
+
+  google::protobuf::RepeatedPtrField<std::string> topic_names;
+  for (int i = 0; i < num_topics; ++i)
+    topic_names.Add()->assign("topic" + boost::lexical_cast<std::string>(i));
+
+  // Tokens with odd index are missing from the model, and class_two is excluded by class weights
+  ::artm::Batch batch;
+  DensePhiMatrix p_wt("pwt", topic_names);
+  for (int i = 0; i < num_tokens; ++i) {
+    batch.add_token("token" + boost::lexical_cast<std::string>(i));
+    batch.add_class_id(i % 3 == 0 ? "class_two" : "class_one");
+    if (i % 2 == 0) {
+      int token_id = p_wt.AddToken(Token(batch.class_id(i), batch.token(i)));
+      for (int topic_id = 0; topic_id < num_topics; ++topic_id)
+        p_wt.set(token_id, topic_id, (i + topic_id) % 4 == 0 ? 0.0f : 0.01f * (i + topic_id + 1));
+    }
+  }
+
+  std::vector<float> theta;
+  for (int item_index = 0; item_index < num_items; ++item_index) {
+    ::artm::Item* item = batch.add_item();
+    for (int i = item_index; i < num_tokens; i += 2) {
+      item->add_token_id(i);
+      item->add_token_weight(static_cast<float>(1 + i % 3));
+    }
+
+    for (int topic_id = 0; topic_id < num_topics; ++topic_id)
+      theta.push_back((item_index + topic_id) % 3 == 0 ? 0.0f : 0.25f);
+  }
+
+  ::artm::ProcessBatchesArgs args;
+  args.add_class_id("class_one"); args.add_class_weight(2.0f);
+
+  std::vector<Token> token_dict;
+  std::vector<int> token_id;
+  for (int i = 0; i < num_tokens; ++i) {
+    token_dict.push_back(Token(batch.class_id(i), batch.token(i)));
+    token_id.push_back(p_wt.token_index(token_dict.back()));
+  }
+
+  std::vector<float> n_dw_val;
+  std::vector<int> n_dw_row_ptr(1, 0);
+  std::vector<int> n_dw_col_ind;
+  for (const ::artm::Item& item : batch.item()) {
+    n_dw_val.insert(n_dw_val.end(), item.token_weight().begin(), item.token_weight().end());
+    n_dw_col_ind.insert(n_dw_col_ind.end(), item.token_id().begin(), item.token_id().end());
+    n_dw_row_ptr.push_back(static_cast<int>(n_dw_val.size()));
+  }
+
+  ::artm::utility::CsrMatrix<float> n_dw(num_tokens, &n_dw_val, &n_dw_row_ptr, &n_dw_col_ind);
+  ::artm::ProcessedBatch processed_batch(n_dw, p_wt, args, token_dict, token_id, &theta[0], nullptr);
+
+  ::artm::ScoreConfig score_config;
+  score_config.set_config(::artm::PerplexityScoreConfig().SerializeAsString());
+  ::artm::score::Perplexity perplexity(score_config);
+  auto expected_perplexity = CalcItemByItem(&perplexity, batch, processed_batch);
+  auto actual_perplexity = CalcFused(&perplexity, processed_batch);
+  EXPECT_NEAR(dynamic_cast< ::artm::PerplexityScore&>(*actual_perplexity).value(),
+              dynamic_cast< ::artm::PerplexityScore&>(*expected_perplexity).value(), 1e-4);
+  EXPECT_EQ(dynamic_cast< ::artm::PerplexityScore&>(*actual_perplexity).zero_words(),
+            dynamic_cast< ::artm::PerplexityScore&>(*expected_perplexity).zero_words());
+
+  score_config.set_config(::artm::SparsityThetaScoreConfig().SerializeAsString());
+  ::artm::score::SparsityTheta sparsity_theta(score_config);
+  EXPECT_EQ(CalcFused(&sparsity_theta, processed_batch)->SerializeAsString(),
+            CalcItemByItem(&sparsity_theta, batch, processed_batch)->SerializeAsString());
+
+  score_config.set_config(::artm::ItemsProcessedScoreConfig().SerializeAsString());
+  ::artm::score::ItemsProcessed items_processed(score_config);
+  EXPECT_EQ(CalcFused(&items_processed, processed_batch)->SerializeAsString(),
+            CalcItemByItem(&items_processed, batch, processed_batch)->SerializeAsString());
+}
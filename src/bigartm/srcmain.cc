@@ -285,6 +285,8 @@ struct artm_options {
   std::string write_class_predictions;
   std::string write_scores;
   std::string write_vw_corpus;
+  std::string write_flat_batches;
+  std::string write_protobuf_batches;
   std::string csv_separator;
   int score_level;
   std::vector<std::string> score;
@@ -1097,6 +1099,36 @@ void WriteVwCorpus(const artm_options& options, const std::string& batch_folder)
   }
 }
 
+void WriteBatches(const artm_options& options, const std::string& batch_folder,
+                  const std::string& target_folder, bool flat_format) {
+  ProgressScope scope(std::string("Saving batches in ") + (flat_format ? "flat" : "protobuf") +
+                      " format into " + target_folder);
+  auto batch_file_names = findFilesInDirectory(batch_folder, ".batch");
+  if (batch_file_names.empty())
+    throw std::runtime_error(std::string("No batches found in ") + batch_folder + ", unable to convert batches");
+
+  boost::system::error_code error;
+  fs::create_directories(target_folder, error);
+  if (error)
+    throw std::runtime_error(std::string("Unable to create batch folder: ") + target_folder);
+
+  for (auto& batch_file_name : batch_file_names) {
+    const std::string target = (fs::path(target_folder) / batch_file_name.filename()).string();
+    if (fs::exists(target) && !options.force)
+      throw std::runtime_error(std::string("File already exists: ") + target + ", use --force to overwrite");
+
+    // LoadBatch detects the format of the source batch automatically
+    Batch batch = artm::LoadBatch(batch_file_name.string());
+    if (flat_format) {
+      artm::SaveFlatBatch(batch, target);
+    } else {
+      std::ofstream output(target, std::ofstream::binary);
+      if (!output.is_open() || !batch.SerializeToOstream(&output))
+        throw std::runtime_error(std::string("Unable to write batch to ") + target);
+    }
+  }
+}
+
 int get_dictionary_size(const MasterModel& master, std::string dictionary_name) {
   auto info = master.info();
   for (int i = 0; i < info.dictionary_size(); ++i)
@@ -1455,6 +1487,12 @@ int execute(const artm_options& options, int argc, char* argv[]) {
   if (!options.write_vw_corpus.empty())
     WriteVwCorpus(options, batch_vectorizer.batch_folder());
 
+  if (!options.write_flat_batches.empty())
+    WriteBatches(options, batch_vectorizer.batch_folder(), options.write_flat_batches, /* flat_format =*/ true);
+
+  if (!options.write_protobuf_batches.empty())
+    WriteBatches(options, batch_vectorizer.batch_folder(), options.write_protobuf_batches, /* flat_format =*/ false);
+
   return 0;
 }
 
@@ -1517,6 +1555,8 @@ int main(int argc, char * argv[]) {
       ("write-class-predictions", po::value(&options.write_class_predictions)->default_value(""), "write class prediction in a human-readable format")
       ("write-scores", po::value(&options.write_scores)->default_value(""), "write scores in a human-readable format")
       ("write-vw-corpus", po::value(&options.write_vw_corpus)->default_value(""), "convert batches into plain text file in Vowpal Wabbit format")
+      ("write-flat-batches", po::value(&options.write_flat_batches)->default_value(""), "convert batches into flat binary format (memory-mapped without parsing) and save them into the folder")
+      ("write-protobuf-batches", po::value(&options.write_protobuf_batches)->default_value(""), "convert batches (e.g. in flat format) into protobuf format and save them into the folder")
       ("force", po::bool_switch(&options.force)->default_value(false), "force overwrite existing output files")
       ("csv-separator", po::value(&options.csv_separator)->default_value(";"), "columns separator for --write-model-readable and --write-predictions. Use \\t or TAB to indicate tab.")
       ("score-level", po::value< int >(&options.score_level)->default_value(2), "score level (0, 1, 2, or 3")
@@ -1698,6 +1738,9 @@ int main(int argc, char * argv[]) {
       std::cerr << "* Upgrade batches in the old format (from folder 'old_folder' into 'new_folder'):\n";
       std::cerr << "  bigartm --use-batches old_folder --save-batches new_folder\n";
       std::cerr << std::endl;
+      std::cerr << "* Convert batches into flat binary format, which is faster to load on every collection pass:\n";
+      std::cerr << "  bigartm --use-batches mmro_batches --write-flat-batches mmro_flat_batches\n";
+      std::cerr << std::endl;
       std::cerr << "* Configure logger to output into stderr:\n";
       std::cerr << "  tset GLOG_logtostderr=1 & bigartm -d docword.kos.txt -v vocab.kos.txt -t 20 --num-collection-passes 10\n";
       return 0;